@@ -17,13 +17,176 @@ Compilation:
 gcc `pkg-config --cflags gtk+-3.0` -o fractal7 fractal7.c \
 `pkg-config --libs gtk+-3.0` -lm
 
+Kernels:
+Mandelbrot, Julia and JuliaSine are built from one kernel template for
+each precision (Precision menu) and SIMD level. The AVX-512 or AVX2 build
+is used when the CPU has it; FRACTAL_SIMD=scalar, vector, avx2 or avx512
+overrides that. Double-double (about 106 bits, 8 pixels at a time with
+AVX-512) and the fixed-point precisions reach zooms past double and long
+double; fixed point keeps --fixed-bits=N fraction bits (default: as many
+as fit).
+
+Antialiasing:
+Pixels that differ from a neighbor are sampled again, up to 16 times on
+a jittered grid where the first samples disagree (Precision menu). Show
+samples tints those pixels green (4 samples) or red (16).
+
+Distance estimation:
+Mandelbrot and Julia at double precision can be drawn from an estimate
+of each point's distance to the set (Precision menu). Points within half
+a pixel of the set are drawn with it, which keeps thin filaments whole,
+and blocks of pixels shown to be far from it are filled without being
+computed.
+
+Inverse iteration:
+With Inverse iteration on (Precision menu), Julia draws only the set
+itself, by walking the preimages of z*z + c back from a repelling fixed
+point (the modified inverse iteration method). That takes milliseconds,
+so shift-dragging over the image sets c to the point under the pointer
+and redraws as it moves.
+
+Julia preview:
+With Julia preview on (Precision menu), moving the pointer over the
+Mandelbrot set shows the Julia set of the c under it in an inset, drawn
+small at double precision on the render threads. Each motion retires
+the preview before it, and the last few dozen are kept, so going back
+over the same points shows them at once.
+
+Iteration deepening:
+Mandelbrot and Julia at double precision keep the last z of the pixels
+still inside after MAX_ITERATIONS. More iterations (Precision menu)
+doubles the limit and continues only those pixels from where they
+stopped; with Auto-deepen on that repeats by itself until a pass decides
+fewer than half a percent of the pixels it continued. Each tile keeps
+its pixels and a side table of only the undecided ones, 18 bytes each
+(a 16-bit index and z), so large images stay affordable; the status bar
+shows the limit reached and the memory kept.
+
+Canvas:
+File > Canvas... opens a window on an image of the escape-time fractal
+shown, 65536 pixels wide by default (--canvas-size=N), moved with the
+scrollbars, the wheel or by dragging. Only the tiles in view and a
+margin around them are rendered, and only the most recently seen few
+hundred are kept, so it takes about as much memory as the main window
+however large the image is.
+
+Saving:
+File > Save writes PNG, PPM or QOI (by the filter chosen, or the
+extension typed). The image is copied as it is when asked for and
+encoded and written on other threads, with the progress in the status
+bar, so drawing goes on meanwhile. PNG is deflated in bands of rows, one
+per thread at a time, that are joined into a single zlib stream; PPM
+and QOI are much faster to write and a good deal larger.
+
+Lorenz 3D:
+The Lorenz trajectory is computed once and kept; dragging over the image
+turns it in three dimensions, and every frame is drawn again from the
+kept points by all the render threads, one band of the image each.
+Points add up their light, the nearer ones more.
+
+Zoom:
+Left click zooms in on the point clicked, right click zooms back out and
+middle click returns to the initial view. Images fill in from the center
+outwards, or from the pointer while it moves over the image.
+
+Benchmark:
+./fractal7 --benchmark
+renders deep zooms of the Mandelbrot set at every precision and prints
+the time and the number of pixels that differ from the most precise one
+
+./fractal7 --self-test
+checks the double-double and fixed 128-bit kernels on the same zooms
+against exact multi-word arithmetic and exits with 1 if they disagree
+
+./fractal7 --check [--baseline=FILE [--max-slowdown=PERCENT]]
+renders every fractal but Formula at fixed parameters with each kernel
+and compares the images with golden data. Given a baseline file, it also
+compares the times with those recorded there the first time; exits with
+1 on a mismatch or when a kernel is more than PERCENT (default 10)
+slower
+
+./fractal7 --zoom-video=DIR [--zoom-depth=ZOOM] [--zoom-frames=N]
+         [--zoom-center=RE,IM]
+writes the frames of a zoom into the Mandelbrot set, by default to 1e4
+in Seahorse Valley in 300 frames, to DIR as PNG files. Only one keyframe is
+rendered per doubling of the zoom, at twice the resolution, and each
+frame is resampled from the last keyframe before it, so the cost grows
+with the depth of the zoom rather than with the number of frames.
+
+xvfb-run -a ./fractal7 --ui-benchmark
+(or GDK_BACKEND=broadway with broadwayd running) keeps the Mandelbrot set
+rendering while it injects pointer motion and zoom clicks, prints the
+percentiles of the time from each event to its handler and to the next
+frame, and exits with 1 if the 99th percentile frame latency is over
+100 ms
+
+xvfb-run -a ./fractal7 --startup-benchmark
+prints the time from the start of the program to the first frame with
+an image in it and exits with 1 if that is over 250 ms
+
+Render jobs:
+A running instance takes render jobs over D-Bus as GApplication actions
+on /io/github/foustja/testprogram_fractal7 (interface org.gtk.Actions):
+  render   a{sv} with "output" (PNG file) and optionally "fractal" (a
+           name from the Fractals menu), "formula", "start" and
+           "julia-style" (a formula instead), "a", "b", "re", "im" (the
+           center), "zoom", "width", "height", "precision" (a name from
+           the Precision menu) and "priority" (higher first)
+  cancel   u, the id of a job
+  jobs     state a(ussd): id, output, state and progress of the jobs
+           waiting or running and of the last 16 that are over
+Jobs run one at a time, highest priority first, on the render threads
+behind whatever the window is drawing, which does not retire them. The
+application stays up until they are over. For example
+gdbus call --session --dest io.github.foustja.testprogram_fractal7 \
+  --object-path /io/github/foustja/testprogram_fractal7 \
+  --method org.gtk.Actions.Activate render \
+  "[<{'output': <'/tmp/m.png'>, 're': <-0.7436>, 'im': <0.1318>,
+      'zoom': <1000.0>}>]" {}
+and --method org.gtk.Actions.Describe jobs for the progress.
+
+Shared-memory output:
+./fractal7 --shm-output=SOCKET
+draws the image straight into a memfd buffer that other programs on the
+machine can map: a ShmOutputHeader (below) followed, at its offset, by
+the pixels as cairo's RGB24. A program connects to the Unix socket
+SOCKET and receives the buffer's fd with the first 8-byte message; after
+that each update of the image sends the header's sequence number, so
+the socket itself is the notification fd. The sequence is odd while the
+pixels are being written; a reader copies them and checks that the
+sequence was even and unchanged across the copy.
+
+Session:
+The fractal, its parameters, the view and the image are kept in
+~/.cache/fractal7 on exit and the image is shown again at the next
+start, before anything is computed. Without it the Mandelbrot set is
+drawn at once.
+
+Tracing:
+FRACTAL_TRACE=trace.json ./fractal7
+records the render pipeline and writes a Chrome trace-event file on exit,
+which can be opened in Perfetto (ui.perfetto.dev) or chrome://tracing
+
 Additional comments describing program and references below following code
 */
 
 //Include files
+#define _GNU_SOURCE
 #include <cairo.h>
 #include <gtk/gtk.h>
+#include <glib/gstdio.h>
+#include <glib-unix.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
 
 //Constant definitions
 #define WINWIDTH 1100
@@ -32,32 +195,1639 @@ Additional comments describing program and references below following code
 #define DAWIDTH 1000
 #define DAHEIGHT 600
 
+//SIMD vectors of four doubles, and 64-bit integers of the same size,
+//for the vectorized kernels (GCC vector extensions)
+#define SIMD_WIDTH 4
+typedef double v4df __attribute__ ((vector_size (SIMD_WIDTH*sizeof(double))));
+typedef long long v4di __attribute__ ((vector_size (SIMD_WIDTH*sizeof(long long))));
+#define VEC4(c) ((v4df){(c), (c), (c), (c)})
+#define VEC_SELECT(mask, a, b)                                              \
+  ((v4df)(((v4di)(a) & (mask)) | ((v4di)(b) & ~(mask))))
+#define VEC_ABS(x)                                                          \
+  ((v4df)((v4di)(x) & ((v4di){G_MAXINT64, G_MAXINT64, G_MAXINT64,           \
+                              G_MAXINT64})))
+#define VEC_INLINE inline __attribute__ ((always_inline))
+
+//Eight doubles for the AVX-512 builds of the Mandelbrot and Julia kernels
+#define SIMD_WIDTH_AVX512 8
+typedef double v8df __attribute__ ((vector_size (SIMD_WIDTH_AVX512*sizeof(double))));
+typedef long long v8di __attribute__ ((vector_size (SIMD_WIDTH_AVX512*sizeof(long long))));
+#define VEC8(c) ((v8df){(c), (c), (c), (c), (c), (c), (c), (c)})
+
+//JuliaSine: orbits with |Im z| above the bailout have escaped for good,
+//and vec_sincos() hands arguments above SINCOS_MAX_ARG to libm
+#define JULIASIN_BAILOUT 50.0
+#define SINCOS_MAX_ARG 1e9
+
+//User formulas: longest program, deepest stack, largest exponent that
+//is unrolled into multiplications, and the escape radius squared. Large
+//enough for the transcendental formulas; polynomial orbits past |z| = 2
+//escape anyway.
+#define FORMULA_MAX_CODE 128
+#define FORMULA_MAX_STACK 16
+#define FORMULA_MAX_POWER 64
+#define FORMULA_BAILOUT 2500.0
+#define FORMULA_EXP_MAX 700.0
+#define FORMULA_ERROR (g_quark_from_static_string("fractal-formula-error"))
+
+//The view center is kept in fixed point with VIEW_BITS fraction bits,
+//enough for zooms far beyond long double. Each click zooms in or out by
+//VIEW_ZOOM_STEP.
+#define VIEW_BITS 120
+#define VIEW_ZOOM_STEP 4.0
+
+//Fixed-point kernels: numbers keep seven integer bits besides the sign,
+//so |z| is held below FIXED_NORM_LIMIT and the bailout at FIXED_BAILOUT
+#define FIXED64_MIN_BITS 16
+#define FIXED64_MAX_BITS 56
+#define FIXED128_MIN_BITS 64
+#define FIXED128_MAX_BITS VIEW_BITS
+#define FIXED128_MAX ((__int128)(~(unsigned __int128)0 >> 1))
+#define FIXED_NORM_LIMIT 8
+#define FIXED_BAILOUT 16.0
+
+//--self-test reference numbers: REFERENCE_LIMBS 64-bit limbs, the top one
+//for the integer part, and a pixel of every SELF_TEST_SPACING in each
+//direction is checked
+#define REFERENCE_LIMBS 4
+#define REFERENCE_FRACTION_BITS (64*(REFERENCE_LIMBS - 1))
+#define SELF_TEST_SPACING 25
+
+//--check: the golden data are the images scaled down CHECK_SCALE times in
+//each direction, each cell the mean brightness of its pixels in steps of
+//1/15 of COLOR_EXTERIOR. A cell differs when it is more than a step off,
+//and CHECK_TOLERANCE of the cells may differ. Times are the best of
+//CHECK_RUNS renders.
+#define CHECK_SCALE 20
+#define CHECK_COLUMNS (DAWIDTH/CHECK_SCALE)
+#define CHECK_ROWS (DAHEIGHT/CHECK_SCALE)
+#define CHECK_TOLERANCE 0.002
+#define CHECK_RUNS 3
+#define CHECK_MAX_SLOWDOWN 10
+
+//--zoom-video: keyframes are rendered every doubling of the zoom at
+//ZOOM_VIDEO_SCALE times the frame size; defaults of the options
+#define ZOOM_VIDEO_SCALE 2
+#define ZOOM_VIDEO_DEPTH 1e4
+#define ZOOM_VIDEO_FRAMES 300
+#define ZOOM_VIDEO_CENTER "-0.743644786,0.1318252536"
+
+//Size of the square tiles the escape-time fractals are split into
+#define TILE_SIZE 64
+
+//Adaptive antialiasing: sample positions are kept in 1/SAMPLE_SCALE
+//pixels. A pixel that differs from a neighbor gets AA_FIRST_SAMPLES
+//samples, and AA_MAX_SAMPLES on a jittered AA_GRID x AA_GRID grid when
+//those disagree.
+#define SAMPLE_SHIFT 6
+#define SAMPLE_SCALE (1 << SAMPLE_SHIFT)
+#define AA_GRID 4
+#define AA_FIRST_SAMPLES 4
+#define AA_MAX_SAMPLES (AA_GRID*AA_GRID)
+
+//Distance estimation: orbits go on to |z| = DISTANCE_RADIUS, pixels less
+//than DISTANCE_BAND pixels from the set are drawn with it, and estimates
+//are taken as DISTANCE_SAFETY times the distance at most when filling
+//blocks. Blocks of DISTANCE_MIN_BLOCK pixels or fewer are not split
+//further. A Julia set counts as connected when the orbit of 0 stays
+//bounded for DISTANCE_CONNECTED_ITERATIONS.
+#define DISTANCE_RADIUS 1000.0
+#define DISTANCE_BAND 0.5
+#define DISTANCE_SAFETY 4.0
+#define DISTANCE_MIN_BLOCK 16
+#define DISTANCE_CONNECTED_ITERATIONS 1000
+
+//Inverse iteration: a point is only taken further back while its pixel,
+//or its cell of an INVERSE_GRID x INVERSE_GRID grid over the disk holding
+//the Julia set when it is outside the image, has been reached fewer than
+//INVERSE_MAX_HITS times, and for INVERSE_MAX_DEPTH preimages at most.
+//The request is checked for being stale every INVERSE_CHECK points.
+#define INVERSE_GRID 1024
+#define INVERSE_MAX_HITS 2
+#define INVERSE_MAX_DEPTH 1000
+#define INVERSE_CHECK 65536
+
+//3D Lorenz view: steps of the kept trajectory, the point it turns
+//around, the size it is drawn at (units per image height), the rotation
+//in radians per pixel dragged, and the light a point adds to its pixel
+//at the back and the front of the attractor
+#define LORENZ_3D_STEPS 400000
+#define LORENZ_3D_CENTER_Z 25.0
+#define LORENZ_3D_SIZE 64.0
+#define LORENZ_3D_DRAG 0.01
+#define LORENZ_3D_FAR 0.05
+#define LORENZ_3D_NEAR 0.25
+
+//Number of attractor points handed to the main thread at once
+#define ORBIT_BATCH 1000
+
+//Iteration limit of the escape-time fractals
+#define MAX_ITERATIONS 100
+
+//Iteration deepening: each pass doubles the limit, and auto-deepening
+//stops after a pass that decides fewer than DEEPEN_THRESHOLD of the
+//pixels it continued, or at DEEPEN_MAX_ITERATIONS
+#define DEEPEN_THRESHOLD 0.005
+#define DEEPEN_MAX_ITERATIONS 12800
+
+//Render statistics: bins of the escape-iteration histogram, and the
+//number of render threads whose busy time is tracked separately
+#define HISTOGRAM_BINS 20
+#define MAX_RENDER_THREADS 64
+
+//Events kept per thread when tracing; older events are overwritten
+#define TRACE_RING_SIZE 65536
+#define MAX_TRACE_THREADS 256
+
+//--ui-benchmark: UI_BENCHMARK_EVENTS synthetic events, one every
+//UI_BENCHMARK_INTERVAL ms at most, every UI_BENCHMARK_CLICK-th of them a
+//click. Fails above UI_BENCHMARK_BUDGET ms of 99th percentile latency.
+#define UI_BENCHMARK_EVENTS 500
+#define UI_BENCHMARK_INTERVAL 10
+#define UI_BENCHMARK_CLICK 20
+#define UI_BENCHMARK_BUDGET 100
+
+//--shm-output: "FSHM" in the header's magic, and where the pixels start
+//in the buffer, a page after it so that they are page aligned
+#define SHM_OUTPUT_MAGIC 0x4d485346
+#define SHM_OUTPUT_VERSION 1
+#define SHM_OUTPUT_OFFSET 4096
+
+//Render jobs that are over stay in the "jobs" list, the last
+//RENDER_JOBS_HISTORY of them
+#define RENDER_JOBS_HISTORY 16
+
+//--startup-benchmark fails above STARTUP_BUDGET ms to the first image
+#define STARTUP_BUDGET 250
+
+//Julia preview inset: its size (5:3, like the image), its distance from
+//the edges of the image, and how many previews are kept
+#define JULIA_PREVIEW_WIDTH 250
+#define JULIA_PREVIEW_HEIGHT 150
+#define JULIA_PREVIEW_MARGIN 10
+#define JULIA_PREVIEW_CACHE 32
+
+//Canvas window: the default width of its image (the height keeps the 5:3
+//view), the widest allowed, the tiles rendered beyond each edge of the
+//part shown, and how many finished tiles are kept at least (about four
+//windows' worth)
+#define CANVAS_SIZE 65536
+#define CANVAS_MAX_SIZE 1048576
+#define CANVAS_PREFETCH 2
+#define CANVAS_CACHE_TILES 640
+
+//Saving: the bands a PNG is deflated in per thread, the fewest rows in a
+//band, the zlib level, and how often the status bar shows the progress
+//(ms)
+#define SAVE_BANDS_PER_THREAD 4
+#define SAVE_BAND_ROWS 16
+#define SAVE_PNG_LEVEL 3
+#define SAVE_PROGRESS_INTERVAL 100
+
+//Pixel colors (CAIRO_FORMAT_RGB24)
+#define COLOR_INTERIOR 0x000000
+#define COLOR_EXTERIOR 0x808080
+
+//Tints of the sample-count overlay for pixels with AA_FIRST_SAMPLES and
+//AA_MAX_SAMPLES samples
+#define COLOR_FIRST_SAMPLES 0x00c000
+#define COLOR_MAX_SAMPLES 0xff0000
+
+//Fractals the render engine knows how to draw
+typedef enum
+{
+  FRACTAL_HENON,
+  FRACTAL_LORENZ_XY,
+  FRACTAL_LORENZ_YZ,
+  FRACTAL_LORENZ_XZ,
+  FRACTAL_LORENZ_3D,
+  FRACTAL_JULIA,
+  FRACTAL_JULIASIN,
+  FRACTAL_MANDEL,
+  FRACTAL_FORMULA,
+  FRACTAL_COUNT
+} FractalType;
+
+//Number types the escape-time kernels are built for
+typedef enum
+{
+  PRECISION_DOUBLE,
+  PRECISION_LONG_DOUBLE,
+  PRECISION_DOUBLE_DOUBLE,
+  PRECISION_FIXED64,
+  PRECISION_FIXED128,
+  PRECISION_COUNT
+} RenderPrecision;
+
+//Kernel builds: one pixel at a time, SIMD_WIDTH pixels in generic vector
+//code, SIMD_WIDTH pixels compiled for AVX2 and FMA, and SIMD_WIDTH_AVX512
+//pixels compiled for AVX-512
+typedef enum
+{
+  SIMD_SCALAR,
+  SIMD_VECTOR,
+  SIMD_AVX2,
+  SIMD_AVX512,
+  SIMD_COUNT
+} RenderSimd;
+
+//Double-double numbers: the unevaluated sum hi + lo with |lo| at most
+//half an ulp of hi, about 106 bits of mantissa. One number, or one per
+//lane of a vector.
+typedef struct
+{
+  double hi;
+  double lo;
+} double_dd;
+
+typedef struct
+{
+  v4df hi;
+  v4df lo;
+} v4df_dd;
+
+typedef struct
+{
+  v8df hi;
+  v8df lo;
+} v8df_dd;
+
+//A number of the --self-test reference in sign and magnitude, with the
+//limbs from least to most significant
+typedef struct
+{
+  gboolean negative;
+  guint64 limb[REFERENCE_LIMBS];
+} ReferenceNumber;
+
+//User formulas: instructions of the compiled iteration, a stack machine
+//working on complex numbers, SIMD_WIDTH pixels at a time
+typedef enum
+{
+  FORMULA_OP_CONST,
+  FORMULA_OP_Z,
+  FORMULA_OP_C,
+  FORMULA_OP_ADD,
+  FORMULA_OP_SUB,
+  FORMULA_OP_MUL,
+  FORMULA_OP_DIV,
+  FORMULA_OP_NEG,
+  FORMULA_OP_RECIP,
+  FORMULA_OP_SQR,
+  FORMULA_OP_POWI,
+  FORMULA_OP_POW,
+  FORMULA_OP_CONJ,
+  FORMULA_OP_EXP,
+  FORMULA_OP_LOG,
+  FORMULA_OP_SIN,
+  FORMULA_OP_COS,
+  FORMULA_OP_SINH,
+  FORMULA_OP_COSH
+} FormulaOp;
+
+typedef struct
+{
+  FormulaOp op;
+  int n;                //exponent of FORMULA_OP_POWI
+  double re;            //value of FORMULA_OP_CONST
+  double im;
+} FormulaInstruction;
+
+typedef struct
+{
+  FormulaInstruction code[FORMULA_MAX_CODE];
+  int length;
+  int depth;            //stack slots the program needs
+} FormulaProgram;
+
+//A user formula: the iteration z -> f(z, c) and the starting value z0(c).
+//Mandelbrot style takes c from the pixel and starts at z0; Julia style
+//starts at the pixel and uses c = a + bi.
+typedef struct
+{
+  gchar *text;
+  gchar *start_text;
+  gboolean julia_style;
+  FormulaProgram iterate;
+  FormulaProgram start;
+} Formula;
+
+//Parser state while compiling one expression
+typedef struct
+{
+  const gchar *text;
+  const gchar *pos;
+  FormulaProgram *program;
+  gboolean allow_z;
+  int depth;
+} FormulaParser;
+
+//A point of the 3D Lorenz view once projected: the index of its pixel in
+//the image and the light it adds there
+typedef struct
+{
+  int pixel;
+  float light;
+} LorenzPoint;
+
+//One render request. Every tile of the request holds a reference to it.
+//The request is retired as soon as render_generation moves past its
+//generation number.
+typedef struct
+{
+  gint ref_count;
+  gint generation;
+  gint tiles_pending;
+  FractalType type;
+  int width;
+  int height;
+  long double parameter_a;
+  long double parameter_b;
+  RenderPrecision precision;
+  RenderSimd simd;
+
+  //Copy of the user formula for FRACTAL_FORMULA, NULL otherwise
+  Formula *formula;
+
+  //View: pixel (x, y) is the point x/x_scale + re_min + i*(im_max - y/y_scale)
+  long double re_min;
+  long double im_max;
+  long double x_scale;
+  long double y_scale;
+
+  //The same view with VIEW_BITS fraction bits for the fixed-point
+  //kernels: view_re_min + x*view_step_x + i*(view_im_max - y*view_step_y)
+  __int128 view_re_min;
+  __int128 view_im_max;
+  __int128 view_step_x;
+  __int128 view_step_y;
+  int fixed_bits;
+
+  //Symmetric views: the pixels in the mirror rectangle are not computed
+  //but copied from (mirror_x - x, mirror_y - y), or from (x, mirror_y - y)
+  //when mirror_x is -1
+  int mirror_x;
+  int mirror_y;
+  GdkRectangle mirror;
+
+  //Adaptive antialiasing, and the overlay that tints each pixel by the
+  //number of samples it took
+  gboolean antialias;
+  gboolean show_samples;
+
+  //Distance estimation, and whether the estimates are lower bounds good
+  //enough to fill blocks with (the Mandelbrot set and connected Julia
+  //sets)
+  gboolean distance;
+  gboolean distance_fill;
+
+  //Julia by inverse iteration, as a single tile covering the image
+  gboolean inverse;
+
+  //Iteration deepening: the iteration limit reached so far, and whether
+  //the tiles keep the last z of their interior pixels, so that raising
+  //the limit only continues those (renders of the window only, of
+  //Mandelbrot and Julia at double precision without distance estimation)
+  int iterations;
+  gboolean keep_orbits;
+
+  //Rotation of the 3D Lorenz view, row by row: image x, image y (up) and
+  //depth (towards the viewer)
+  double rotation[9];
+
+  //The 3D Lorenz view is projected in lorenz_slices slices of the
+  //vertices, lorenz_slice each, which the band tiles claim through
+  //lorenz_next_slice. The points of slice s landing in band b of
+  //lorenz_band rows are lorenz_points from lorenz_band_start[s][b] up to
+  //lorenz_band_start[s][b + 1], lorenz_bands + 1 entries per slice.
+  LorenzPoint *lorenz_points;
+  int *lorenz_band_start;
+  int lorenz_band;
+  int lorenz_bands;
+  int lorenz_slice;
+  int lorenz_slices;
+  gint lorenz_next_slice;
+  gint lorenz_slices_done;
+
+  //Requests of the render job queue deliver their tiles to results rather
+  //than render_results, and are retired by cancelled rather than by
+  //render_generation. NULL for the window's renders. Their generation is
+  //0, which render_tile_compare() puts behind every window render.
+  GAsyncQueue *results;
+  gint cancelled;
+
+  //Point of the image the tiles of those requests are rendered outwards
+  //from, or -1 for its center; the window's renders follow
+  //render_focus_x and render_focus_y instead
+  int focus_x;
+  int focus_y;
+} RenderRequest;
+
+//Counters for one tile or attractor batch. Only the render thread that
+//computes the tile writes them; the GTK thread adds them up once the
+//tile has been handed over, so no locking or atomics are needed.
+typedef struct
+{
+  gint64 iterations;
+  int interior;
+  int escaped;
+  int samples;
+  int histogram[HISTOGRAM_BINS];
+  gint64 wall_time;
+  gint64 cpu_time;
+  int thread;
+} RenderCounters;
+
+//A unit of work for the render threads: a rectangle of pixels for the
+//escape-time fractals, or a batch of points for the attractors. The
+//antialiasing and distance estimation passes also hand the kernels lists
+//of sample points; the distance estimation kernels leave each point's
+//distance to the set, in pixels, in distances (negative if unknown).
+typedef struct
+{
+  RenderRequest *request;
+  int x;
+  int y;
+  int width;
+  int height;
+  guint32 *pixels;
+  int n_points;
+  int *points;
+  double *distances;
+  RenderCounters counters;
+
+  //Iteration deepening: a side table of the pixels still undecided,
+  //as indices into pixels, and of the last z of each, kept as separate
+  //arrays of unresolved entries (NULL when the request keeps none); and
+  //the iterations to add when the tile is queued again (0 the first
+  //time). Tiles that keep orbits are at most TILE_SIZE + 2 on a side, so
+  //the indices fit in 16 bits.
+  guint16 *orbit_pixels;
+  double *orbit_re;
+  double *orbit_im;
+  int unresolved;
+  int deepen;
+} RenderTile;
+
+//A point waiting on the stack of the inverse iteration, and the number of
+//preimages taken to reach it
+typedef struct
+{
+  double re;
+  double im;
+  int depth;
+} InversePoint;
+
+//One instantiation of the escape-time kernel template
+typedef struct
+{
+  void (*run)(RenderTile *tile);
+  const gchar *name;
+} RenderKernel;
+
+//Per-tile record kept for the JSON export
+typedef struct
+{
+  int x;
+  int y;
+  int width;
+  int height;
+  int thread;
+  gint64 wall_time;
+  gint64 cpu_time;
+  gint64 iterations;
+} RenderTileRecord;
+
+//Totals for the current (or last) render, kept on the GTK thread
+typedef struct
+{
+  FractalType type;
+  int width;
+  int height;
+  long double parameter_a;
+  long double parameter_b;
+  gchar *formula;
+  const gchar *kernel;
+  long double zoom;
+  gboolean finished;
+  gboolean stopped;
+  gint64 start_time;
+  gint64 end_time;
+  gint64 cpu_time;
+  int iteration_limit;
+  gint64 state_bytes;
+  gint64 iterations;
+  gint64 pixels;
+  gint64 mirrored_pixels;
+  gint64 points;
+  gint64 samples;
+  gint64 interior;
+  gint64 escaped;
+  gint64 histogram[HISTOGRAM_BINS];
+  gint64 busy_time[MAX_RENDER_THREADS];
+  int threads;
+  int tiles_total;
+  GArray *tiles;
+} RenderStats;
+
+//A view timed by --benchmark: the Mandelbrot set around re + i*im at the
+//given magnification
+typedef struct
+{
+  const gchar *name;
+  long double re;
+  long double im;
+  long double zoom;
+} BenchmarkView;
+
+//A --check case: a fractal at fixed parameters and the initial view, and
+//its golden image, a hex digit per cell, row by row
+typedef struct
+{
+  FractalType type;
+  gdouble parameter_a;
+  gdouble parameter_b;
+  const gchar *cells;
+} CheckCase;
+
+//One begin ('B') or end ('E') event of the trace. arg_x and arg_y are
+//written as the x and y arguments of begin events when not -1.
+typedef struct
+{
+  const gchar *name;
+  gint64 timestamp;
+  gchar phase;
+  int arg_x;
+  int arg_y;
+} TraceEvent;
+
+//Trace events of one thread. Only the owning thread writes to its ring.
+typedef struct
+{
+  TraceEvent events[TRACE_RING_SIZE];
+  guint64 head;
+  int tid;
+  gchar *thread_name;
+} TraceRing;
+
+//State of --ui-benchmark. An event is outstanding from the time it is
+//queued until the first frame painted after it was handled; queued_time
+//and handled_time are 0 otherwise.
+typedef struct
+{
+  GtkWidget *drawing_area;
+  GArray *handled_latency;
+  GArray *frame_latency;
+  gint64 queued_time;
+  gint64 handled_time;
+  int events;
+  int clicks;
+  gboolean failed;
+} UiBenchmark;
+
+//Start of the --shm-output buffer, the layout other programs read. format
+//is a cairo_format_t, and finished is 1 when the render of generation is
+//complete.
+typedef struct
+{
+  guint32 magic;
+  guint32 version;
+  guint32 width;
+  guint32 height;
+  guint32 stride;
+  guint32 format;
+  guint32 offset;
+  guint32 finished;
+  guint64 sequence;
+  guint64 generation;
+} ShmOutputHeader;
+
+//State of --shm-output: the memfd and its mapping, the listening socket
+//and the connected clients' sockets
+typedef struct
+{
+  gchar *path;
+  int memfd;
+  int listen_fd;
+  guint8 *map;
+  gsize size;
+  ShmOutputHeader *header;
+  GArray *clients;
+} ShmOutput;
+
+//Life of a render job
+typedef enum
+{
+  RENDER_JOB_QUEUED,
+  RENDER_JOB_RUNNING,
+  RENDER_JOB_DONE,
+  RENDER_JOB_FAILED,
+  RENDER_JOB_CANCELLED
+} RenderJobState;
+
+//A render job queued through the "render" action. tiles is the number of
+//tiles queued for the request once it runs, and image collects them.
+typedef struct
+{
+  guint id;
+  gint priority;
+  gchar *output;
+  RenderJobState state;
+  RenderRequest *request;
+  guint32 *image;
+  int tiles;
+} RenderJob;
+
+//A Julia preview for c = c_re + c_im*i. request is set while it renders.
+typedef struct
+{
+  double c_re;
+  double c_im;
+  RenderRequest *request;
+  guint32 *pixels;
+} JuliaPreview;
+
+//A tile of the canvas, at (x, y) in its image: its pixels once rendered,
+//NULL while it is on the render threads, and then its link in the
+//canvas's list of finished tiles
+typedef struct
+{
+  gint64 key;
+  int x;
+  int y;
+  int width;
+  int height;
+  guint32 *pixels;
+  GList *link;
+} CanvasTile;
+
+//The canvas window: an image of width x height pixels, of the fractal
+//and view the main window had when it was opened, of which the drawing
+//area shows the part the scrollbars select. Only the tiles near that part
+//are rendered, by request, which is replaced whenever they change.
+//tiles holds the tiles rendered or rendering by canvas_tile_key(), and
+//finished the rendered ones, most recently drawn first; the oldest go
+//when there are too many. wanted is the range of tiles wanted, in
+//tiles, and pending how many of them are still rendering.
+typedef struct
+{
+  GtkWidget *window;
+  GtkWidget *drawing_area;
+  GtkAdjustment *hadjustment;
+  GtkAdjustment *vadjustment;
+  FractalType type;
+  RenderPrecision precision;
+  long double parameter_a;
+  long double parameter_b;
+  Formula *formula;
+  gboolean antialias;
+  gboolean show_samples;
+  gboolean distance;
+  __int128 center_re;
+  __int128 center_im;
+  long double zoom;
+  int width;
+  int height;
+  RenderRequest *request;
+  GAsyncQueue *results;
+  GHashTable *tiles;
+  GQueue finished;
+  GdkRectangle wanted;
+  int pending;
+  guint flush_id;
+  gdouble drag_x;
+  gdouble drag_y;
+} Canvas;
+
+//Formats of File > Save
+typedef enum
+{
+  IMAGE_FORMAT_PNG,
+  IMAGE_FORMAT_PPM,
+  IMAGE_FORMAT_QOI,
+  IMAGE_FORMATS
+} ImageFormat;
+
+//One band of the rows of a PNG being saved, filtered and deflated on its
+//own into a whole IDAT chunk, with the length and Adler-32 of the
+//filtered rows for the zlib trailer
+typedef struct
+{
+  int first_row;
+  int rows;
+  gsize length;
+  guint32 adler;
+  GByteArray *chunk;
+  GError *error;
+} PngBand;
+
+//An image being saved in the background: a copy of the pixels as they
+//were when it was asked for, the PNG bands, and how many bands (rows for
+//PPM and QOI) there are, are taken and are done
+typedef struct
+{
+  gchar *filename;
+  ImageFormat format;
+  guint32 *pixels;
+  int width;
+  int height;
+  PngBand *png_bands;
+  gint bands;
+  gint bands_next;
+  gint bands_done;
+  gsize bytes;
+  gint64 start_time;
+} ImageSave;
+
 //Global variables
 static cairo_surface_t *surface = NULL;
 static gdouble parameter_a = -0.5;
 static gdouble parameter_b = -0.99998;
 
-static gboolean closing = FALSE;
+//Render engine state. render_generation is bumped for every new request
+//and on Stop; it is the cancel token the render threads check.
+static GThreadPool *render_pool = NULL;
+static GAsyncQueue *render_results = NULL;
+static RenderRequest *current_request = NULL;
+static Formula *current_formula = NULL;
+
+//Precision chosen in the menu, the kernel build in use and the widest
+//one this CPU runs
+static RenderPrecision render_precision = PRECISION_DOUBLE;
+static RenderSimd render_simd = SIMD_VECTOR;
+static RenderSimd render_simd_best = SIMD_VECTOR;
+static int fixed_bits = 0;
+
+//--check options
+static gchar *check_baseline = NULL;
+static int check_max_slowdown = CHECK_MAX_SLOWDOWN;
+
+//--zoom-video options
+static gdouble zoom_video_depth = ZOOM_VIDEO_DEPTH;
+static int zoom_video_frames = ZOOM_VIDEO_FRAMES;
+static gchar *zoom_video_center = NULL;
+
+//Antialiasing and its sample-count overlay, distance estimation and
+//inverse iteration, from the same menu
+static gboolean render_antialias = TRUE;
+static gboolean render_show_samples = FALSE;
+static gboolean render_distance = FALSE;
+static gboolean render_inverse = FALSE;
+
+//Julia preview: whether it is on, the previews kept (most recently shown
+//first), those still rendering, the one rendering for the pointer, the
+//one shown and on which side, and the timer collecting tiles
+static gboolean render_julia_preview = FALSE;
+static GQueue julia_preview_cache = G_QUEUE_INIT;
+static GList *julia_previews_pending = NULL;
+static JuliaPreview *julia_preview_wanted = NULL;
+static JuliaPreview *julia_preview_shown = NULL;
+static gboolean julia_preview_left = FALSE;
+static guint julia_preview_flush_id = 0;
+
+//The canvas window while it is open, and the width of its image
+static Canvas *canvas_window = NULL;
+static int canvas_size = CANVAS_SIZE;
+
+//Names and extensions of the formats File > Save writes, the saves still
+//being encoded, oldest first, the timer showing their progress and the
+//CRC-32 table of PNG chunks
+static const gchar *image_format_names[IMAGE_FORMATS] =
+{
+  "PNG (Portable Network Graphics)",
+  "PPM (Portable Pixmap, uncompressed)",
+  "QOI (Quite OK Image)"
+};
+static const gchar *image_format_extensions[IMAGE_FORMATS] =
+{
+  ".png",
+  ".ppm",
+  ".qoi"
+};
+static GList *image_saves = NULL;
+static guint image_save_progress_id = 0;
+static guint32 png_crc_table[256];
+
+//3D Lorenz view: the trajectory as x, y, z triples, computed once on the
+//GTK thread and only read after that, the rotation set by dragging, and
+//where the pointer was at the last motion event of a drag
+static float *lorenz_vertices = NULL;
+static int lorenz_vertex_count = 0;
+static double lorenz_yaw = 0.0;
+static double lorenz_pitch = -1.3;
+static int lorenz_drag_x = 0;
+static int lorenz_drag_y = 0;
+
+//View: the point at the center of the image and the magnification over
+//the initial view. They are reset when another fractal is drawn.
+static __int128 view_center_re = 0;
+static __int128 view_center_im = 0;
+static long double view_zoom = 1.0;
+static FractalType view_type = FRACTAL_COUNT;
+static gboolean view_julia_style = FALSE;
+static gint render_generation = 0;
+static guint render_flush_id = 0;
+
+//Iteration deepening: whether it goes on by itself, the tiles of the
+//current render with orbits still going, and the pixels continued and
+//the escaped count when the pass in flight started
+static gboolean render_auto_deepen = FALSE;
+static GPtrArray *deepen_tiles = NULL;
+static int deepen_unresolved = 0;
+static gint64 deepen_escaped = 0;
+
+//Point of the image the render threads work outwards from: the pointer
+//when it moves over the drawing area during a render, the center of the
+//image otherwise (-1). Read by render_tile_compare() on the render
+//threads.
+static gint render_focus_x = -1;
+static gint render_focus_y = -1;
+
+//Statistics of the current render and the status bar showing them
+static RenderStats render_stats;
+static GtkWidget *status_bar = NULL;
+static GPrivate render_thread_key = G_PRIVATE_INIT(NULL);
+static gint render_threads_seen = 0;
+
+//Tracing state; trace_file is NULL unless FRACTAL_TRACE is set
+static const gchar *trace_file = NULL;
+static gint64 trace_start_time = 0;
+static TraceRing *trace_rings[MAX_TRACE_THREADS];
+static gint trace_ring_count = 0;
+static GPrivate trace_ring_key = G_PRIVATE_INIT(NULL);
+
+//NULL unless --ui-benchmark was given
+static UiBenchmark *ui_benchmark = NULL;
+
+//Render jobs: those listed in order of id, the last id given, those
+//waiting in priority order, the one running, the timer collecting its
+//tiles and the "jobs" action whose state lists them
+static GPtrArray *render_jobs = NULL;
+static guint render_job_last_id = 0;
+static GQueue render_job_queue = G_QUEUE_INIT;
+static RenderJob *render_job_running = NULL;
+static guint render_job_flush_id = 0;
+static GSimpleAction *render_jobs_action = NULL;
+
+static const gchar *render_job_state_names[] =
+{
+  "queued",
+  "running",
+  "done",
+  "failed",
+  "cancelled"
+};
+
+//NULL unless --shm-output was given, and its socket path until then
+static ShmOutput *shm_output = NULL;
+static gchar *shm_output_path = NULL;
+
+//Startup: when main() started, until the first frame with an image in it
+//has been painted (0 after that), whether the surface has an image yet,
+//and the state of --startup-benchmark
+static gint64 startup_time = 0;
+static const gchar *startup_image = NULL;
+static gboolean startup_benchmark = FALSE;
+static gboolean startup_failed = FALSE;
+
+//Session kept from the last run: the fractal whose image is restored
+//(FRACTAL_COUNT for none), and whether the drawing area has been set up
+//from it yet
+static FractalType session_type = FRACTAL_COUNT;
+static gboolean session_started = FALSE;
+
+//Application icon, decoded on first use
+static GdkPixbuf *icon_pixbuf = NULL;
+
+static const gchar *fractal_names[] =
+{
+  "Henon",
+  "lorenz - xy",
+  "lorenz - yz",
+  "lorenz - xz",
+  "lorenz - 3D",
+  "Julia",
+  "JuliaSine",
+  "Mandelbrot",
+  "Formula"
+};
+
+static const gchar *precision_names[] =
+{
+  "double",
+  "long double",
+  "double-double",
+  "fixed 64-bit",
+  "fixed 128-bit"
+};
+
+static const gchar *simd_names[] =
+{
+  "scalar",
+  "vector",
+  "avx2",
+  "avx512"
+};
+
+//Cells of the AA_GRID x AA_GRID grid over a pixel that its antialiasing
+//samples fall in, in the order they are taken. The pixel's own sample at
+//its center stands in for cell (1, 1); the first AA_FIRST_SAMPLES - 1
+//cover the other three quadrants.
+static const int aa_cells[AA_MAX_SAMPLES - 1][2] =
+{
+  {3, 1}, {1, 3}, {3, 3},
+  {0, 0}, {1, 0}, {2, 0}, {3, 0}, {0, 1}, {2, 1},
+  {0, 2}, {1, 2}, {2, 2}, {3, 2}, {0, 3}, {2, 3}
+};
+
+//Views of --benchmark, around two Misiurewicz points of the Mandelbrot
+//set. The boundary there looks alike at every magnification, so each
+//view has detail within MAX_ITERATIONS.
+static const BenchmarkView benchmark_views[] =
+{
+  {"i", 0.0, 1.0, 1e3},
+  {"i", 0.0, 1.0, 1e10},
+  {"i", 0.0, 1.0, 1e14},
+  {"i", 0.0, 1.0, 1e17},
+  {"i", 0.0, 1.0, 1e20},
+  {"i", 0.0, 1.0, 1e25},
+  {"i", 0.0, 1.0, 1e28},
+  {"-2", -2.0, 0.0, 1e16}
+};
+
+//Cases of --check
+static const CheckCase check_cases[] =
+{
+  {FRACTAL_MANDEL, 0, 0,
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffe8cfffffffffffffffffffffffff"
+   "ffffffffffffffffffffffc03fffffffffffffffffffffffff"
+   "fffffffffffffffffffefc814adfffffffffffffffffffffff"
+   "fffffffffffffffffffa30000026cfffffffffffffffffffff"
+   "ffffffffffffffffffc300000001dfffffffffffffffffffff"
+   "ffffffffffffffffff60000000004effffffffffffffffffff"
+   "fffffffffffff976dd00000000002fffffffffffffffffffff"
+   "ffffffffffffd2001800000000003fffffffffffffffffffff"
+   "fffffffffff95000010000000000afffffffffffffffffffff"
+   "fffffeeeeee94000010000000001bfffffffffffffffffffff"
+   "ffffffffffffd1001700000000003fffffffffffffffffffff"
+   "fffffffffffff976cd00000000002fffffffffffffffffffff"
+   "ffffffffffffffffff50000000004effffffffffffffffffff"
+   "ffffffffffffffffffc300000001dfffffffffffffffffffff"
+   "fffffffffffffffffffa20000025cfffffffffffffffffffff"
+   "fffffffffffffffffffefb8149dfffffffffffffffffffffff"
+   "ffffffffffffffffffffffc04fffffffffffffffffffffffff"
+   "ffffffffffffffffffffffe7cfffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"},
+  {FRACTAL_JULIA, -0.122, 0.745,
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "fffffffffffffffffffbffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffd4cfffffffffffffffffffffffffffff"
+   "ffffffffff7efceffa54cfffffffffffffffffffffffffffff"
+   "ffffffffff3b959df400bfffffffffffffffffffffffffffff"
+   "fffffffd82520005e201dfffffffffffffffffffffffffffff"
+   "fffffff983b30000623cffffffffffffffffffffffffffffff"
+   "fffffffffefa0000359deeffffffffffffffffffffffffffff"
+   "fffffffffffd5559d00047facfffffffffffffffffffffffff"
+   "ffffffffffffbfef90000065cfffffffffffffffffffffffff"
+   "ffffffffffffffff600000069fffffffffffffffffffffffff"
+   "fffffffffffffffc30000007ffffffffffffffffffffffffff"
+   "ffffffffffffffff70000003bfffffffffffffffffffffffff"
+   "fffffffffffffffa70000006ffffffffffffffffffffffffff"
+   "fffffffffffffffc55000008fefbffffffffffffffffffffff"
+   "fffffffffffffffc9f74000da555cfffffffffffffffffffff"
+   "ffffffffffffffffffdec95400009fefffffffffffffffffff"
+   "ffffffffffffffffffffd52600003c388fffffffffffffffff"
+   "fffffffffffffffffffe201e50001517cfffffffffffffffff"
+   "fffffffffffffffffffc003fd948b3efffffffffffffffffff"
+   "fffffffffffffffffffd449ffecfe6ffffffffffffffffffff"
+   "fffffffffffffffffffb5dffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffbeffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"},
+  {FRACTAL_JULIASIN, -0.5, -0.99998,
+   "b0000000124000000000007deffffffffffffeff78deffffff"
+   "8000000000000000000006ef8effffffffddbcffdeffffffff"
+   "8000000000000000000004eddddffffffefdddffefffffffff"
+   "b100000000000000000001cfffffffffffff9ff94affefffff"
+   "3000000000000000000000bffffffffffffd2cd77eadefffff"
+   "00000000000000000002aaedeffffffffffedeffdfffffffff"
+   "00000000000000000038dffbeefffffffffeafffefffffffff"
+   "000000000000000003deffeeffffffffffffcfffffffffffff"
+   "000000000000000002cdfffbbeffffffffffedffffffffffff"
+   "0000000000000000009efcb28efffffffffffeefffffffffff"
+   "0000000000000000007efdfed9ffffffffffffffffffffffff"
+   "0000000000000000005dfffffddfffffffffffffffffffffff"
+   "0000000000000000006eefffffcfffffffffffffffffffffff"
+   "0000000000000025268effffffefffffffffffffffffffffee"
+   "000000000000006edefdfffffffefffffffffffffffffffffe"
+   "00000000000011bedffd8dffffffffffffffffffffffefffff"
+   "0000000000007eefefdceeefffffffffffffffffffffdfffff"
+   "000000000001decfffffffffffffffffffffffffffffdeffff"
+   "0000000000002dffefdadefffffffffffffffffffffffcffff"
+   "0000000000000cdfcd32affffffffffffffffffffffffcbeed"
+   "00000000000009efeeeeefffffffffffeeffffffffffffb46d"
+   "00000000000007dfffff9effffffffffffdfffffffffffd9df"
+   "00000000000007efffffedffffffffffffdefffffffffffeef"
+   "00000000003158eefffffeffffffffffffcbffffffffffebff"
+   "0000000002edefdffffffefffffffefdffceffffffffffecee"
+   "0000000038ecffd8dffffffffffdbcc7ae5aefffffffffffe3"
+   "00000004defffdceeeffffffffeefe46cfcbffffffffffffe5"
+   "00000001ddffffefffffffffffffffeffdecffefffffedede9"
+   "00000001cffefdcdefffffffffffffdffdcacefffffffeacfc"
+   "00000002deecc208fffffffffffecd3dffeffffffffffffdb3"},
+  {FRACTAL_HENON, 1.4, 0.3,
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "fffffffffffffffedddddddeefffffffffffffffffffffffff"
+   "fffffffffffffffffffffffeedbaaccdffffffffffffffffff"
+   "fffffffffffffffffffffffffffffddeccefffffffffffffff"
+   "ffffffffffffffffffffffffffffedefedefffffffffffffff"
+   "fffffffffffffffffffffeeeeeecdeeeefffffffffffffffff"
+   "ffffffffffffffffffeeeeeeeeefffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"},
+  {FRACTAL_LORENZ_XY, 0, 0,
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "fffffffffffffffffffffffffffffffffeffffffffffffffff"
+   "fffffffffffffffffffffffffffffffd89dfffffffffffffff"
+   "ffffffffffffffffffffffffffffffb225bfffffffffffffff"
+   "fffffffffffffffffffffffffffffa1004afffffffffffffff"
+   "ffffffffffffffffffffffffefffa00004bfffffffffffffff"
+   "ffffffffffffffffffffedcbbaa9100015cfffffffffffffff"
+   "fffffffffffffffffffda8754320000028efffffffffffffff"
+   "fffffffffffffffffec85321100000015bffffffffffffffff"
+   "fffffffffffffffffc842100000000149effffffffffffffff"
+   "ffffffffffffffffd841000000001248cfffffffffffffffff"
+   "ffffffffffffffffa41000001112369cffffffffffffffffff"
+   "fffffffffffffffd8200000245678bdfffffffffffffffffff"
+   "fffffffffffffffc5100009aabbceeffffffffffffffffffff"
+   "fffffffffffffffb31000affffffffffffffffffffffffffff"
+   "fffffffffffffffa3100afffffffffffffffffffffffffffff"
+   "fffffffffffffffb423bffffffffffffffffffffffffffffff"
+   "fffffffffffffffd99dfffffffffffffffffffffffffffffff"
+   "ffffffffffffffffefffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"},
+  {FRACTAL_LORENZ_YZ, 0, 0,
+   "ffffffffffffffffffffeeeeeefeffffffffffffffffffffff"
+   "fffffffffffffffffeeedddddddddeeeefffffffffffffffff"
+   "fffffffffffffffeedcccbabaaaabbccdeefffffffffffffff"
+   "ffffffffffffffedccaa98877778899bbceeffffffffffffff"
+   "fffffffffffffedcb9876655545556789bcdefffffffffffff"
+   "ffffffffffffeecb986433333322223689bdeeffffffffffff"
+   "ffffffffffffedba875210123221001479acdeffffffffffff"
+   "ffffffffffffedca864200121210001368aceeffffffffffff"
+   "fffffffffffffdca865321121211112568adeeffffffffffff"
+   "fffffffffffffedba86432221222234689ceefffffffffffff"
+   "ffffffffffffffedba87554334344568acdeefffffffffffff"
+   "fffffffffffffffedcb98766667678abdeefffffffffffffff"
+   "fffffffffffffffffedcbaa9a8abbcdeeeffffffffffffffff"
+   "fffffffffffffffffffffeeeebcdeeefffffffffffffffffff"
+   "fffffffffffffffffffffffffeefffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"},
+  {FRACTAL_LORENZ_XZ, 0, 0,
+   "fffffffffffffffedeffffffffffffffeeefffffffffffffff"
+   "fffffffffffffffdbbceffffffffffedbcefffffffffffffff"
+   "fffffffffffffffda88adffffffffda87aefffffffffffffff"
+   "fffffffffffffffea6568beffffec8556aefffffffffffffff"
+   "ffffffffffffffffb633369ceeda63346befffffffffffffff"
+   "ffffffffffffffffc7311247897531137dffffffffffffffff"
+   "ffffffffffffffffe9410133433200149effffffffffffffff"
+   "fffffffffffffffffc62001122100026cfffffffffffffffff"
+   "fffffffffffffffffe9511111110024aefffffffffffffffff"
+   "ffffffffffffffffffd832110111238dffffffffffffffffff"
+   "fffffffffffffffffffc7421121237cfffffffffffffffffff"
+   "ffffffffffffffffffffb85434358cefffffffffffffffffff"
+   "fffffffffffffffffffffc97768aceffffffffffffffffffff"
+   "ffffffffffffffffffffffedd9cdefffffffffffffffffffff"
+   "fffffffffffffffffffffffffeefffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"
+   "ffffffffffffffffffffffffffffffffffffffffffffffffff"}
+};
+
+//Application icon: pixmaps/48x48/apps/henon.png of the release tarball,
+//compiled in (xxd -i) so nothing is read from disk for it
+static const guint8 icon_png[] =
+{
+  0x89, 0x50, 0x4e, 0x47, 0x0d, 0x0a, 0x1a, 0x0a, 0x00, 0x00, 0x00, 0x0d,
+  0x49, 0x48, 0x44, 0x52, 0x00, 0x00, 0x00, 0x30, 0x00, 0x00, 0x00, 0x30,
+  0x08, 0x06, 0x00, 0x00, 0x00, 0x57, 0x02, 0xf9, 0x87, 0x00, 0x00, 0x00,
+  0x06, 0x62, 0x4b, 0x47, 0x44, 0x00, 0xff, 0x00, 0xff, 0x00, 0xff, 0xa0,
+  0xbd, 0xa7, 0x93, 0x00, 0x00, 0x00, 0x09, 0x70, 0x48, 0x59, 0x73, 0x00,
+  0x00, 0x0b, 0x13, 0x00, 0x00, 0x0b, 0x13, 0x01, 0x00, 0x9a, 0x9c, 0x18,
+  0x00, 0x00, 0x00, 0x07, 0x74, 0x49, 0x4d, 0x45, 0x07, 0xe3, 0x04, 0x19,
+  0x03, 0x19, 0x0f, 0x8d, 0x6c, 0x77, 0x89, 0x00, 0x00, 0x06, 0x30, 0x49,
+  0x44, 0x41, 0x54, 0x68, 0xde, 0xed, 0x59, 0xdb, 0x6e, 0xda, 0x4a, 0x14,
+  0x5d, 0x1e, 0x8f, 0x3d, 0xbe, 0x71, 0x09, 0xa1, 0x90, 0xb4, 0x55, 0xce,
+  0x43, 0xa4, 0xaa, 0xfd, 0x8a, 0xf3, 0xff, 0x7f, 0xd0, 0xbe, 0x44, 0x69,
+  0x43, 0xda, 0x86, 0x60, 0x6c, 0x8c, 0x0d, 0x63, 0xcf, 0xc5, 0xe7, 0xe5,
+  0xcc, 0x08, 0xd2, 0x34, 0x4d, 0x80, 0xb6, 0x27, 0x3a, 0x1d, 0x09, 0x19,
+  0x25, 0x88, 0xd9, 0x6b, 0xef, 0xb5, 0xd7, 0xbe, 0x00, 0x3c, 0xf3, 0xe3,
+  0xbc, 0x7f, 0xff, 0xfe, 0xf2, 0x99, 0xda, 0xfe, 0xf1, 0xed, 0xdb, 0xb7,
+  0x7f, 0x53, 0xc7, 0x71, 0xfe, 0x7a, 0x8e, 0xd6, 0xb7, 0x6d, 0x0b, 0x00,
+  0x20, 0xcf, 0x9d, 0x42, 0x7f, 0x00, 0xfc, 0xee, 0x43, 0x0f, 0xc1, 0x45,
+  0xf3, 0xb2, 0xca, 0xe0, 0x38, 0x20, 0x84, 0xfc, 0xb7, 0x01, 0xb4, 0x6d,
+  0x0b, 0x21, 0x04, 0xd6, 0xeb, 0x35, 0x38, 0xe7, 0x10, 0x42, 0x40, 0x6b,
+  0x0d, 0xcf, 0xf3, 0xe0, 0xfb, 0x3e, 0xc2, 0x30, 0x44, 0x10, 0x04, 0x3f,
+  0x1d, 0x08, 0xdd, 0xd5, 0xf0, 0xb2, 0x2c, 0x51, 0x14, 0x05, 0xd6, 0xeb,
+  0x35, 0xb4, 0xd6, 0x70, 0x1c, 0xc7, 0x46, 0x82, 0x10, 0x02, 0xc6, 0x18,
+  0xba, 0xdd, 0x2e, 0x92, 0x24, 0x41, 0x10, 0x04, 0x70, 0x1c, 0xe7, 0xf7,
+  0x03, 0xd0, 0x5a, 0xa3, 0x2c, 0x4b, 0x64, 0x59, 0x86, 0xaa, 0xaa, 0x20,
+  0xa5, 0x84, 0xd6, 0x1a, 0x6d, 0xdb, 0x5a, 0x10, 0x86, 0x3e, 0x5a, 0x6b,
+  0x70, 0xce, 0x51, 0x96, 0x25, 0x46, 0xa3, 0x11, 0xa2, 0x28, 0xfa, 0x29,
+  0x20, 0x1e, 0x0d, 0x40, 0x4a, 0x89, 0xa2, 0x28, 0x30, 0x9f, 0xcf, 0xb1,
+  0x5a, 0xad, 0x6c, 0x24, 0x94, 0x52, 0x5b, 0x79, 0xe0, 0x38, 0x0e, 0x5c,
+  0xd7, 0x05, 0xa5, 0x14, 0x84, 0x10, 0xac, 0x56, 0x2b, 0xdc, 0xdc, 0xdc,
+  0x60, 0x30, 0x18, 0xa0, 0xd3, 0xe9, 0xc0, 0x75, 0xdd, 0x5f, 0x0f, 0x40,
+  0x08, 0x81, 0x34, 0x4d, 0xb1, 0x58, 0x2c, 0x50, 0xd7, 0x35, 0xa4, 0x94,
+  0x5b, 0x2f, 0xe3, 0x7d, 0x43, 0x31, 0x42, 0x08, 0x28, 0xa5, 0xf0, 0x3c,
+  0xcf, 0x82, 0x57, 0x4a, 0x01, 0xc0, 0xc1, 0x41, 0xd0, 0xc7, 0x78, 0x3e,
+  0xcf, 0x73, 0xe4, 0x79, 0x8e, 0xba, 0xae, 0xa1, 0xb5, 0x86, 0x94, 0x12,
+  0x75, 0x5d, 0xa3, 0x69, 0x1a, 0xf8, 0xbe, 0x8f, 0xe3, 0xe3, 0x63, 0x24,
+  0x49, 0x62, 0x29, 0x66, 0x80, 0x2a, 0xa5, 0xa0, 0xb5, 0x86, 0xef, 0xfb,
+  0xe0, 0x9c, 0x63, 0x36, 0x9b, 0x41, 0x6b, 0x8d, 0x5e, 0xaf, 0x77, 0x30,
+  0x10, 0x0f, 0x02, 0x50, 0x4a, 0x21, 0x4d, 0x53, 0xe4, 0x79, 0x8e, 0xa6,
+  0x69, 0x20, 0xa5, 0xb4, 0xcf, 0xba, 0xae, 0x11, 0xc7, 0x31, 0xce, 0xcf,
+  0xcf, 0x31, 0x1c, 0x0e, 0xe1, 0x79, 0x1e, 0xda, 0xb6, 0x45, 0x5d, 0xd7,
+  0xb8, 0xb9, 0xb9, 0xc1, 0x64, 0x32, 0x41, 0x55, 0x55, 0x5b, 0xd2, 0x5a,
+  0x55, 0x15, 0xb4, 0xd6, 0x20, 0x84, 0xa0, 0xdb, 0xed, 0x1e, 0x44, 0xa1,
+  0xe8, 0x43, 0x6a, 0x53, 0x55, 0x15, 0xf2, 0x3c, 0x07, 0xe7, 0x1c, 0x52,
+  0x4a, 0x08, 0x21, 0xd0, 0x34, 0x0d, 0x38, 0xe7, 0x60, 0x8c, 0xe1, 0xfc,
+  0xfc, 0x1c, 0xe3, 0xf1, 0x18, 0x5a, 0x6b, 0x08, 0x21, 0x00, 0x00, 0x9e,
+  0xe7, 0xe1, 0xe5, 0xcb, 0x97, 0x20, 0x84, 0xe0, 0xe2, 0xe2, 0xc2, 0xe6,
+  0x8b, 0xf9, 0x5f, 0x5d, 0xd7, 0x48, 0xd3, 0x14, 0x84, 0x10, 0x74, 0x3a,
+  0x9d, 0xbd, 0x13, 0xfb, 0xbb, 0x00, 0x38, 0xe7, 0x98, 0xcf, 0xe7, 0x96,
+  0xbf, 0x4d, 0xd3, 0xa0, 0xae, 0x6b, 0x4b, 0xa3, 0xc1, 0x60, 0x80, 0x5e,
+  0xaf, 0x07, 0x29, 0xa5, 0xf5, 0xb0, 0x89, 0x9a, 0xe3, 0x38, 0x18, 0x0e,
+  0x87, 0x58, 0x2e, 0x97, 0xb8, 0xbc, 0xbc, 0xc4, 0x6a, 0xb5, 0x82, 0x52,
+  0x0a, 0x61, 0x18, 0x02, 0x00, 0xca, 0xb2, 0xb4, 0xc9, 0x1e, 0xc7, 0xf1,
+  0xe1, 0x01, 0x68, 0xad, 0x91, 0xe7, 0x39, 0x96, 0xcb, 0x25, 0x94, 0x52,
+  0x36, 0x59, 0x9b, 0xa6, 0x01, 0xa5, 0x14, 0x49, 0x92, 0xe0, 0xf5, 0xeb,
+  0xd7, 0x60, 0x8c, 0x59, 0xe5, 0xb9, 0xdb, 0x25, 0xfa, 0xbe, 0x8f, 0xd3,
+  0xd3, 0x53, 0xeb, 0x71, 0xa5, 0x14, 0xea, 0xba, 0x46, 0xdb, 0xb6, 0x60,
+  0x8c, 0xa1, 0xaa, 0x2a, 0xa4, 0x69, 0x0a, 0xd7, 0x75, 0x11, 0x04, 0xc1,
+  0x61, 0x01, 0x70, 0xce, 0x2d, 0x7f, 0x85, 0x10, 0x96, 0x3a, 0x9d, 0x4e,
+  0x07, 0x67, 0x67, 0x67, 0xe8, 0xf5, 0x7a, 0xe8, 0x76, 0xbb, 0x5b, 0xea,
+  0xb3, 0xc9, 0x75, 0x73, 0xfa, 0xfd, 0x3e, 0xde, 0xbd, 0x7b, 0x87, 0x2c,
+  0xcb, 0x30, 0x9b, 0xcd, 0x30, 0x9f, 0xcf, 0x51, 0xd7, 0xb5, 0xfd, 0xdc,
+  0x72, 0xb9, 0x04, 0xa5, 0x14, 0xc3, 0xe1, 0x10, 0xbe, 0xef, 0x1f, 0x06,
+  0x80, 0xd6, 0x1a, 0xcb, 0xe5, 0x12, 0x9c, 0x73, 0xab, 0x38, 0x42, 0x08,
+  0x84, 0x61, 0x88, 0x37, 0x6f, 0xde, 0xe0, 0xf8, 0xf8, 0xd8, 0xaa, 0xcb,
+  0x63, 0x0a, 0x1f, 0xa5, 0x14, 0xa3, 0xd1, 0x08, 0xfd, 0x7e, 0x1f, 0xd3,
+  0xe9, 0x14, 0xd7, 0xd7, 0xd7, 0xe0, 0x9c, 0x5b, 0x15, 0x5a, 0x2c, 0x16,
+  0x60, 0x8c, 0xe1, 0xe8, 0xe8, 0x68, 0xa7, 0xa4, 0x26, 0xf7, 0x5d, 0xba,
+  0x5e, 0xaf, 0x2d, 0x9f, 0x8d, 0x97, 0x4f, 0x4f, 0x4f, 0x31, 0x1c, 0x0e,
+  0xef, 0xf5, 0xfa, 0x83, 0x23, 0xdf, 0xbf, 0x2d, 0x86, 0x49, 0xee, 0xb3,
+  0xb3, 0x33, 0x30, 0xc6, 0x6c, 0x3d, 0x51, 0x4a, 0x61, 0xb1, 0x58, 0x80,
+  0x73, 0x7e, 0x98, 0x76, 0x5a, 0x29, 0x65, 0x2b, 0xac, 0xd6, 0x1a, 0x4a,
+  0x29, 0x50, 0x4a, 0x71, 0x74, 0x74, 0x64, 0x0d, 0x7f, 0xaa, 0x72, 0x18,
+  0x10, 0x8e, 0xe3, 0x60, 0x34, 0x1a, 0x61, 0x3c, 0x1e, 0x5b, 0xc9, 0x15,
+  0x42, 0x58, 0xb5, 0x33, 0x82, 0xb0, 0x37, 0x80, 0xcd, 0x4b, 0xcd, 0x7b,
+  0xa3, 0xf3, 0x3b, 0x0f, 0xdf, 0x8e, 0x63, 0x29, 0x75, 0x72, 0x72, 0x82,
+  0x38, 0x8e, 0xad, 0xb3, 0xb4, 0xd6, 0x28, 0x8a, 0x02, 0x55, 0x55, 0x3d,
+  0xf9, 0x0e, 0x72, 0xdf, 0x45, 0xe6, 0x69, 0x1a, 0x33, 0x29, 0x25, 0xaa,
+  0xaa, 0xb2, 0x1c, 0xdd, 0x05, 0x88, 0xf9, 0x3e, 0xa5, 0x14, 0xa2, 0x28,
+  0x42, 0xb7, 0xdb, 0xdd, 0x6a, 0x33, 0xea, 0xba, 0x46, 0x59, 0x96, 0x8f,
+  0xca, 0xad, 0x07, 0x01, 0x6c, 0xf6, 0x30, 0x9b, 0x9d, 0xe5, 0x74, 0x3a,
+  0x05, 0xe7, 0x7c, 0x2b, 0x32, 0xbb, 0xce, 0x11, 0x26, 0xa2, 0x77, 0xf3,
+  0xac, 0xaa, 0x2a, 0xac, 0xd7, 0xeb, 0x27, 0x7d, 0xff, 0x37, 0x00, 0x8c,
+  0x2e, 0x9b, 0x86, 0xcc, 0x75, 0x5d, 0xb8, 0xae, 0x8b, 0x34, 0x4d, 0x71,
+  0x75, 0x75, 0x05, 0x21, 0xc4, 0xce, 0xd5, 0x73, 0x33, 0x82, 0xc6, 0xf3,
+  0xc6, 0xe3, 0x26, 0x27, 0xf6, 0x06, 0x40, 0x08, 0x41, 0x92, 0x24, 0x60,
+  0x8c, 0x59, 0x10, 0xbe, 0xef, 0x43, 0x29, 0x85, 0xab, 0xab, 0x2b, 0x5c,
+  0x5c, 0x5c, 0xa0, 0x28, 0x8a, 0x9d, 0xfb, 0x18, 0x42, 0x08, 0xb2, 0x2c,
+  0x43, 0x9a, 0xa6, 0x36, 0x69, 0xb5, 0xd6, 0x36, 0x0a, 0x26, 0x27, 0xf6,
+  0x1a, 0xea, 0x0d, 0x47, 0x0d, 0x00, 0x03, 0x42, 0x4a, 0x89, 0x4f, 0x9f,
+  0x3e, 0xe1, 0xc3, 0x87, 0x0f, 0xc8, 0xb2, 0x6c, 0xa7, 0x48, 0xb8, 0xae,
+  0x8b, 0xdb, 0xdb, 0x5b, 0x64, 0x59, 0x66, 0x3d, 0xbd, 0xf9, 0x34, 0xad,
+  0xca, 0x5e, 0x00, 0x4c, 0xb7, 0x98, 0x24, 0x89, 0xa5, 0x91, 0xef, 0xfb,
+  0x60, 0x8c, 0xc1, 0x71, 0x1c, 0xa4, 0x69, 0x8a, 0xcf, 0x9f, 0x3f, 0xdb,
+  0x61, 0xe6, 0xa9, 0x39, 0x40, 0x08, 0xb1, 0xe0, 0x37, 0x23, 0x69, 0x94,
+  0x6a, 0x2f, 0x0a, 0x99, 0x13, 0x04, 0x01, 0x5e, 0xbc, 0x78, 0x81, 0x24,
+  0x49, 0x40, 0x08, 0xb1, 0x00, 0x82, 0x20, 0x00, 0xa5, 0x14, 0x59, 0x96,
+  0xa1, 0x2c, 0x4b, 0x4b, 0x81, 0xc7, 0x5c, 0x6a, 0xb8, 0x3f, 0x1c, 0x0e,
+  0xd1, 0xeb, 0xf5, 0xbe, 0xa9, 0x2b, 0x66, 0x34, 0x35, 0x52, 0xbe, 0xf7,
+  0x5e, 0x28, 0x8a, 0x22, 0x0c, 0x06, 0x03, 0x44, 0x51, 0xb4, 0x95, 0x0f,
+  0xa6, 0x92, 0x7e, 0xf9, 0xf2, 0x05, 0x42, 0x08, 0xab, 0x54, 0x0f, 0x01,
+  0xd9, 0x34, 0xcc, 0xf4, 0x52, 0x84, 0x90, 0xad, 0x95, 0xcc, 0x2e, 0x94,
+  0xfc, 0x61, 0x26, 0xc6, 0x71, 0x8c, 0xf1, 0x78, 0x8c, 0x6e, 0xb7, 0x6b,
+  0xa9, 0x14, 0x86, 0x21, 0x5c, 0xd7, 0xc5, 0x6c, 0x36, 0xc3, 0xd7, 0xaf,
+  0x5f, 0x21, 0xa5, 0x04, 0xa5, 0xd4, 0x7a, 0x71, 0x53, 0x1a, 0x8d, 0x91,
+  0xa6, 0xcd, 0x36, 0xaa, 0x16, 0x86, 0x21, 0x28, 0xa5, 0xf7, 0x02, 0x7e,
+  0x0a, 0x85, 0xe8, 0x63, 0x54, 0x23, 0x49, 0x12, 0x38, 0x8e, 0x03, 0x29,
+  0x25, 0x56, 0xab, 0x95, 0xad, 0x05, 0x4d, 0xd3, 0x60, 0x32, 0x99, 0x40,
+  0x29, 0x85, 0x57, 0xaf, 0x5e, 0x21, 0x0c, 0xc3, 0xad, 0x48, 0x54, 0x55,
+  0x05, 0xce, 0x39, 0xc2, 0x30, 0x44, 0x18, 0x86, 0x96, 0xef, 0xf7, 0x79,
+  0xfa, 0xee, 0x62, 0xe0, 0xa0, 0x43, 0xbd, 0xe3, 0x38, 0x88, 0xa2, 0x08,
+  0x27, 0x27, 0x27, 0xc8, 0xb2, 0x0c, 0x8b, 0xc5, 0xc2, 0x7a, 0xb4, 0xae,
+  0x6b, 0x5c, 0x5f, 0x5f, 0x63, 0xb9, 0x5c, 0x6e, 0xe5, 0x4c, 0x55, 0x55,
+  0x98, 0x4c, 0x26, 0xc8, 0xb2, 0x0c, 0x83, 0xc1, 0x00, 0xe3, 0xf1, 0x18,
+  0x49, 0x92, 0xc0, 0xf3, 0x3c, 0x70, 0xce, 0x71, 0x7b, 0x7b, 0x0b, 0x29,
+  0x25, 0x7c, 0xdf, 0xb7, 0x55, 0x7a, 0xb3, 0x67, 0x3a, 0xf8, 0x5a, 0xc5,
+  0x44, 0xc2, 0x75, 0x5d, 0xb4, 0x6d, 0x8b, 0xa2, 0x28, 0xac, 0xdc, 0x09,
+  0x21, 0x90, 0xe7, 0x39, 0x8a, 0xa2, 0x80, 0xeb, 0xba, 0x16, 0x98, 0x19,
+  0x45, 0xa7, 0xd3, 0x29, 0xf2, 0x3c, 0x87, 0xef, 0xfb, 0x70, 0x5d, 0x17,
+  0x52, 0x4a, 0x70, 0xce, 0x41, 0x08, 0xb1, 0x8a, 0xb4, 0xa9, 0x4c, 0x07,
+  0xa5, 0xd0, 0xdd, 0x13, 0x86, 0x21, 0x46, 0xa3, 0x11, 0x7c, 0xdf, 0x47,
+  0x51, 0x14, 0xb6, 0x5b, 0xdd, 0x1c, 0x7c, 0x0c, 0x85, 0x3c, 0xcf, 0xb3,
+  0x2d, 0x03, 0x00, 0x3b, 0x91, 0x39, 0x8e, 0x63, 0xeb, 0x0b, 0xa5, 0x74,
+  0x4b, 0x3e, 0x37, 0x81, 0xfc, 0xb4, 0xdd, 0x68, 0x10, 0x04, 0x76, 0x8a,
+  0x32, 0xde, 0x26, 0x84, 0xc0, 0xf3, 0x3c, 0xdb, 0x22, 0xdc, 0xf5, 0xe2,
+  0x5d, 0x7a, 0xb4, 0x6d, 0x6b, 0x6b, 0x0c, 0x21, 0xc4, 0x46, 0xee, 0x97,
+  0x2d, 0x77, 0x29, 0xa5, 0xe8, 0xf7, 0xfb, 0x60, 0x8c, 0xd9, 0x9a, 0x20,
+  0x84, 0xb0, 0x14, 0x33, 0x39, 0x72, 0x5f, 0x62, 0x6e, 0xfe, 0x6d, 0x93,
+  0x3e, 0x26, 0x32, 0x4f, 0xd9, 0x19, 0xed, 0xb5, 0x5e, 0x27, 0x84, 0x20,
+  0x8e, 0x63, 0xf8, 0xbe, 0x8f, 0x38, 0x8e, 0x91, 0xe7, 0xb9, 0x6d, 0xc6,
+  0x8c, 0xe2, 0x18, 0x19, 0xbd, 0x3b, 0xc9, 0x99, 0xcf, 0x98, 0x19, 0xc1,
+  0x00, 0x78, 0xea, 0x46, 0x7b, 0xef, 0xdf, 0x07, 0xcc, 0xbe, 0xa7, 0xdf,
+  0xef, 0x23, 0x8a, 0x22, 0xac, 0x56, 0x2b, 0x54, 0x55, 0x65, 0x57, 0x29,
+  0x9b, 0x45, 0xea, 0xae, 0x61, 0x6d, 0xdb, 0x5a, 0x6f, 0xbb, 0xae, 0x8b,
+  0x28, 0x8a, 0x9e, 0xbc, 0xb5, 0x3b, 0x08, 0x00, 0x63, 0x20, 0x63, 0x0c,
+  0x9e, 0xe7, 0x21, 0x49, 0x12, 0x3b, 0x6d, 0x35, 0x4d, 0x63, 0x23, 0x70,
+  0x9f, 0xba, 0x18, 0x50, 0x8c, 0x31, 0x5b, 0xdc, 0x7e, 0x7a, 0x12, 0xff,
+  0x88, 0x56, 0x26, 0xa1, 0x19, 0x63, 0xdf, 0xf0, 0xfe, 0x7b, 0x2b, 0x18,
+  0x43, 0xa1, 0x5f, 0xfe, 0x13, 0xd3, 0x8f, 0xa2, 0x72, 0xdf, 0xfb, 0x83,
+  0x3a, 0x0c, 0xcf, 0xfc, 0xfc, 0x01, 0xf0, 0x07, 0xc0, 0xff, 0x1d, 0x00,
+  0x6d, 0xdb, 0xf6, 0xe3, 0x33, 0xb5, 0xfd, 0x23, 0x00, 0xfc, 0x03, 0x8f,
+  0x6f, 0x4b, 0x0d, 0xbe, 0x3c, 0x5f, 0x76, 0x00, 0x00, 0x00, 0x00, 0x49,
+  0x45, 0x4e, 0x44, 0xae, 0x42, 0x60, 0x82
+};
+
+//Command line options, handled in handle_local_options()
+static const GOptionEntry command_line_options[] =
+{
+  {"baseline", 0, 0, G_OPTION_ARG_FILENAME, NULL,
+   "Times --check compares with, recorded there when missing", "FILE"},
+  {"benchmark", 0, 0, G_OPTION_ARG_NONE, NULL,
+   "Time the kernels of every precision on deep zooms and exit", NULL},
+  {"canvas-size", 0, 0, G_OPTION_ARG_INT, NULL,
+   "Width in pixels of the image of the canvas window (default 65536)",
+   "N"},
+  {"check", 0, 0, G_OPTION_ARG_NONE, NULL,
+   "Check every fractal against golden images and the baseline times and "
+   "exit", NULL},
+  {"fixed-bits", 0, 0, G_OPTION_ARG_INT, NULL,
+   "Fraction bits of the fixed-point kernels", "N"},
+  {"max-slowdown", 0, 0, G_OPTION_ARG_INT, NULL,
+   "Slowdown over the baseline that fails --check (default 10)", "PERCENT"},
+  {"self-test", 0, 0, G_OPTION_ARG_NONE, NULL,
+   "Check the double-double and fixed 128-bit kernels against exact "
+   "arithmetic and exit", NULL},
+  {"shm-output", 0, 0, G_OPTION_ARG_FILENAME, NULL,
+   "Draw into shared memory offered on the Unix socket SOCKET", "SOCKET"},
+  {"startup-benchmark", 0, 0, G_OPTION_ARG_NONE, NULL,
+   "Time the start up to the first image and exit", NULL},
+  {"ui-benchmark", 0, 0, G_OPTION_ARG_NONE, NULL,
+   "Measure the input latency during renders with synthetic events and "
+   "exit", NULL},
+  {"zoom-center", 0, 0, G_OPTION_ARG_STRING, NULL,
+   "Point --zoom-video zooms into (default -0.743644786,0.1318252536)",
+   "RE,IM"},
+  {"zoom-depth", 0, 0, G_OPTION_ARG_DOUBLE, NULL,
+   "Magnification --zoom-video ends at (default 1e4)", "ZOOM"},
+  {"zoom-frames", 0, 0, G_OPTION_ARG_INT, NULL,
+   "Number of frames of --zoom-video (default 300)", "N"},
+  {"zoom-video", 0, 0, G_OPTION_ARG_FILENAME, NULL,
+   "Write the frames of a Mandelbrot zoom to DIR and exit", "DIR"},
+  {NULL}
+};
 
 //Functions
-static void henon(GtkWidget* drawing_area);
-static void lorenz_xy(GtkWidget* drawing_area);
-static void lorenz_yz(GtkWidget* drawing_area);
-static void lorenz_xz(GtkWidget* drawing_area);
-static void julia(GtkWidget* drawing_area);
-static void juliasin(GtkWidget* drawing_area);
-static void mandel(GtkWidget* drawing_area);
+static void henon(RenderRequest *request);
+static void lorenz_xy(RenderRequest *request);
+static void lorenz_yz(RenderRequest *request);
+static void lorenz_xz(RenderRequest *request);
+static void lorenz_3d_vertices(void);
+static void lorenz_3d_rotation(RenderRequest *request);
+static void lorenz_3d_setup(RenderRequest *request, int band);
+static int lorenz_3d_project(RenderRequest *request, int slice);
+static void lorenz_3d_band(RenderTile *tile);
+static VEC_INLINE void vec_round(const v4df *x, v4df *k, v4di *n);
+static VEC_INLINE void vec_sincos(const v4df *arg, v4df *s, v4df *c);
+static VEC_INLINE void vec_exp(const v4df *arg, v4df *e);
+static VEC_INLINE void vec_coshsinh(const v4df *arg, v4df *ch, v4df *sh);
+static int formula_operands(FormulaOp op);
+static VEC_INLINE void vec_clamp(v4df *x, double limit);
+static VEC_INLINE void formula_exp(v4df *re, v4df *im);
+static VEC_INLINE void formula_log(v4df *re, v4df *im);
+static VEC_INLINE void formula_run(const FormulaProgram *program,
+                                   const v4df *z_re, const v4df *z_im,
+                                   const v4df *c_re, const v4df *c_im,
+                                   v4df *re, v4df *im);
+static gboolean formula_error(FormulaParser *parser, GError **error,
+                              const gchar *format, ...) G_GNUC_PRINTF(3, 4);
+static gchar formula_peek(FormulaParser *parser);
+static gboolean formula_emit(FormulaParser *parser, FormulaOp op, int n,
+                             double re, double im, GError **error);
+static gboolean formula_parse_expression(FormulaParser *parser,
+                                         GError **error);
+static gboolean formula_parse_term(FormulaParser *parser, GError **error);
+static gboolean formula_parse_unary(FormulaParser *parser, GError **error);
+static gboolean formula_parse_power(FormulaParser *parser, GError **error);
+static gboolean formula_parse_primary(FormulaParser *parser, GError **error);
+static gboolean formula_compile(const gchar *text, gboolean allow_z,
+                                FormulaProgram *program, GError **error);
+static Formula *formula_new(const gchar *text, const gchar *start_text,
+                            gboolean julia_style, GError **error);
+static Formula *formula_copy(Formula *formula);
+static void formula_free(Formula *formula);
+static VEC_INLINE gint64 fixed64_from(long double v, int bits);
+static VEC_INLINE gint64 fixed64_mul(gint64 a, gint64 b, int bits);
+static VEC_INLINE gint64 fixed64_norm(gint64 x, gint64 y, int bits);
+static VEC_INLINE __int128 fixed128_from(long double v, int bits);
+static VEC_INLINE __int128 fixed128_mul(__int128 a, __int128 b, int bits);
+static VEC_INLINE __int128 fixed128_sqr(__int128 a, int bits);
+static VEC_INLINE __int128 fixed128_norm(__int128 x, __int128 y, int bits);
+static VEC_INLINE __int128 fixed_view_point(__int128 origin, __int128 step,
+                                            int s, int bits);
+static VEC_INLINE double_dd dd_from_long_double(long double v);
+static VEC_INLINE double_dd dd_from_fixed(__int128 v);
+static const RenderKernel *render_kernel(FractalType type,
+                                         RenderPrecision precision,
+                                         RenderSimd simd);
+static void render_init_simd(void);
+static RenderRequest *render_request_ref(RenderRequest *request);
+static void render_request_unref(RenderRequest *request);
+static gboolean render_request_is_stale(RenderRequest *request);
+static RenderTile *render_tile_new(RenderRequest *request,
+                                   int x, int y, int width, int height);
+static void render_tile_free(RenderTile *tile);
+static gboolean orbit_plot(RenderTile **batch, int screen_x, int screen_y);
+static void render_counters_add(RenderCounters *to,
+                                const RenderCounters *from);
+static void render_sample_point(int x, int y, int cell, int *point);
+static RenderTile *render_tile_samples(RenderTile *tile,
+                                       const RenderKernel *kernel,
+                                       const int *pixels, int n_pixels,
+                                       int first, int count);
+static void render_color_add(guint32 *sum, guint32 color);
+static guint32 render_color_mean(const guint32 *sum, int n);
+static guint32 render_color_blend(guint32 a, guint32 b);
+static void render_tile_antialias(RenderTile *tile,
+                                  const RenderKernel *kernel);
+static void render_tile_deepen(RenderTile *tile);
+static void render_tile_alloc_orbits(RenderTile *tile);
+static void render_tile_compact_orbits(RenderTile *tile);
+static gint64 render_tile_state_bytes(RenderTile *tile);
+static void render_tile_fill(RenderTile *tile, const GdkRectangle *block,
+                             guint32 color);
+static void render_tile_boundary(RenderTile *tile,
+                                 const RenderKernel *kernel);
+static gboolean render_julia_connected(long double a, long double b);
+static void julia_inverse(RenderTile *tile);
+static const RenderKernel *render_distance_kernel(RenderRequest *request);
+static void render_worker(gpointer data, gpointer user_data);
+static void render_set_view(RenderRequest *request);
+static void render_initial_center(RenderRequest *request,
+                                  __int128 *center_re, __int128 *center_im);
+static void render_set_center(RenderRequest *request, __int128 center_re,
+                              __int128 center_im, long double zoom);
+static int render_fixed_bits(RenderPrecision precision);
+static RenderRequest *render_request_alloc(FractalType type,
+                                           RenderPrecision precision,
+                                           int width, int height);
+static RenderRequest *render_request_new(FractalType type,
+                                         RenderPrecision precision);
+static int render_symmetry_axis(long double offset, long double scale);
+static void render_set_symmetry(RenderRequest *request);
+static void render_queue_tiles(RenderRequest *request, GPtrArray *tiles,
+                               int x_begin, int x_end,
+                               int y_begin, int y_end);
+static gint64 render_tile_distance(const RenderTile *tile);
+static gint render_tile_compare(gconstpointer a, gconstpointer b,
+                                gpointer user_data);
+static gint render_tile_compare_indirect(gconstpointer a, gconstpointer b,
+                                         gpointer user_data);
+static void render_push_tiles(GPtrArray *tiles);
+static void render_set_focus(int x, int y);
+static gboolean render_tile_mirror_rect(RenderTile *tile, GdkRectangle *rect);
+static void render_start(GtkWidget *drawing_area, FractalType type);
+static void render_cancel(void);
+static void render_deepen_clear(void);
+static gboolean render_deepen_wanted(void);
+static gboolean render_deepen(GtkWidget *drawing_area);
+static gboolean render_flush(gpointer data);
+static void render_blit_tile(GtkWidget *drawing_area, RenderTile *tile);
+static int render_thread_slot(void);
+static gint64 render_thread_cpu_time(void);
+static void render_tile_start_clock(RenderTile *tile);
+static void render_tile_stop_clock(RenderTile *tile);
+static RenderTile *orbit_batch_new(RenderRequest *request);
+static void orbit_deliver(RenderTile *batch);
+static void render_count_pixel(RenderCounters *counters, int iterations,
+                               int escaped_at);
+static void render_stats_reset(RenderRequest *request, int tiles_total);
+static void render_stats_add(RenderTile *tile);
+static gdouble render_stats_wall_time(void);
+static gdouble render_stats_utilization(void);
+static void render_stats_show(void);
+static void set_benchmark_view(const BenchmarkView *view);
+static guint32 *render_image(FractalType type, RenderPrecision precision,
+                             RenderSimd simd);
+static guint32 *render_request_image(RenderRequest *request);
+static void render_request_queue(RenderRequest *request, guint32 *image);
+static void render_image_add_tile(guint32 *image, RenderTile *tile);
+static int run_benchmark(void);
+static ReferenceNumber reference_from_fixed(__int128 v);
+static ReferenceNumber reference_add(ReferenceNumber a, ReferenceNumber b);
+static ReferenceNumber reference_sub(ReferenceNumber a, ReferenceNumber b);
+static ReferenceNumber reference_mul(ReferenceNumber a, ReferenceNumber b);
+static gboolean reference_exceeds(ReferenceNumber a, guint64 n);
+static gboolean reference_mandel(__int128 re, __int128 im);
+static int run_self_test(void);
+static void check_cells(const guint32 *image, guint8 *cells);
+static gboolean check_case(const CheckCase *check, RenderPrecision precision,
+                           GKeyFile *baseline, gboolean *recorded);
+static int run_check(void);
+static RenderPrecision zoom_video_precision(long double zoom);
+static guint32 zoom_video_blend(guint32 a, guint32 b, guint32 weight);
+static void zoom_video_resample(const guint32 *keyframe, int key_width,
+                                int key_height, guint32 *frame, int width,
+                                int height, double x_ratio, double y_ratio);
+static int run_zoom_video(const gchar *directory);
+static void json_append_string(GString *json, const gchar *key,
+                               const gchar *value);
+static void json_append_double(GString *json, const gchar *key,
+                               gdouble value);
+static gchar *render_stats_to_json(void);
+static void save_render_stats(const gchar *image_filename);
+static gint64 trace_clock(void);
+static TraceRing *trace_ring_get(void);
+static void trace_event(const gchar *name, gchar phase, int arg_x, int arg_y);
+static void trace_begin(const gchar *name);
+static void trace_begin_tile(const gchar *name, int x, int y);
+static void trace_end(const gchar *name);
+static void trace_init(void);
+static void trace_write(void);
+static void ui_benchmark_start(GtkWidget *drawing_area);
+static void ui_benchmark_put(GdkEventType type, int x, int y, guint button);
+static gboolean ui_benchmark_tick(gpointer data);
+static void ui_benchmark_event(GdkEvent *event, gpointer data);
+static void ui_benchmark_after_paint(GdkFrameClock *clock, gpointer data);
+static gint ui_benchmark_compare(gconstpointer a, gconstpointer b);
+static void ui_benchmark_print(const gchar *name, GArray *latency);
+static void ui_benchmark_finish(void);
+static void render_jobs_init(GApplication *app, gpointer data);
+static void render_job_activate(GSimpleAction *action, GVariant *parameter,
+                                gpointer data);
+static void render_job_cancel(GSimpleAction *action, GVariant *parameter,
+                              gpointer data);
+static void render_jobs_change_state(GSimpleAction *action, GVariant *value,
+                                     gpointer data);
+static gint render_job_compare(gconstpointer a, gconstpointer b,
+                               gpointer data);
+static void render_job_next(void);
+static gboolean render_job_flush(gpointer data);
+static void render_jobs_publish(void);
+static void render_jobs_prune(void);
+static void render_jobs_cancel_all(void);
+static void julia_preview_update(GtkWidget *widget, int x, int y);
+static void julia_preview_hide(GtkWidget *widget);
+static gboolean julia_preview_flush(gpointer data);
+static void julia_preview_draw(cairo_t *cr);
+static gint64 canvas_tile_key(int x, int y);
+static void canvas_open(GtkWidget *drawing_area);
+static RenderRequest *canvas_request_new(Canvas *canvas);
+static void canvas_visible(Canvas *canvas, GdkRectangle *visible);
+static void canvas_update(Canvas *canvas);
+static gboolean canvas_flush(gpointer data);
+static void canvas_evict(Canvas *canvas);
+static void canvas_show_memory(Canvas *canvas);
+static gboolean canvas_draw(GtkWidget *widget, cairo_t *cr, gpointer data);
+static void canvas_size_allocate(GtkWidget *widget,
+                                 GdkRectangle *allocation, gpointer data);
+static void canvas_moved(GtkAdjustment *adjustment, gpointer data);
+static gboolean canvas_scroll(GtkWidget *widget, GdkEventScroll *event,
+                              gpointer data);
+static gboolean canvas_button_press(GtkWidget *widget,
+                                    GdkEventButton *event, gpointer data);
+static gboolean canvas_motion(GtkWidget *widget, GdkEventMotion *event,
+                              gpointer data);
+static void canvas_destroy(GtkWidget *widget, gpointer data);
+static int image_format_from_name(const gchar *filename);
+static void image_save_start(const gchar *filename, ImageFormat format);
+static void image_save_thread(GTask *task, gpointer source,
+                              gpointer task_data, GCancellable *cancellable);
+static void image_save_done(GObject *source, GAsyncResult *result,
+                            gpointer data);
+static gboolean image_save_progress(gpointer data);
+static void image_save_free(ImageSave *save);
+static guint32 png_crc(guint32 crc, const guint8 *data, gsize length);
+static guint32 adler32(guint32 adler, const guint8 *data, gsize length);
+static guint32 adler32_combine(guint32 adler1, guint32 adler2,
+                               gsize length2);
+static void png_append_chunk(GByteArray *out, const gchar *type,
+                             const guint8 *data, gsize length);
+static void png_band_encode(ImageSave *save, PngBand *band);
+static gpointer png_band_thread(gpointer data);
+static gboolean png_encode(ImageSave *save, GByteArray *out,
+                           GError **error);
+static void ppm_encode(ImageSave *save, GByteArray *out);
+static void qoi_encode(ImageSave *save, GByteArray *out);
+static gboolean shm_output_open(const gchar *path);
+static gboolean shm_output_accept(gint fd, GIOCondition condition,
+                                  gpointer data);
+static void shm_output_begin(void);
+static void shm_output_end(void);
+static void shm_output_close(void);
+static GdkPixbuf *app_icon(void);
+static gchar *session_filename(const gchar *name);
+static void session_load(void);
+static void session_show(GtkWidget *drawing_area);
+static void session_save(GtkWidget *widget, gpointer data);
+static void startup_painted(void);
 static void clear_surface (void);
 static void do_drawing(cairo_t *cr);
 static void stop_function(void);
+static void julia_drag(GtkWidget *widget, int x, int y);
 
 //Callbacks
 static void activate (GtkApplication *app, gpointer user_data);
+static gint handle_local_options(GApplication *app, GVariantDict *options,
+                                 gpointer user_data);
 static gboolean configure_event (GtkWidget *widget,
                                  GdkEventConfigure *event,
                                  gpointer data);
 static gboolean on_draw_event(GtkWidget *widget, cairo_t *cr,
                               gpointer user_data);
+static gboolean button_press_event(GtkWidget *widget, GdkEventButton *event,
+                                   gpointer data);
+static gboolean motion_notify_event(GtkWidget *widget, GdkEventMotion *event,
+                                    gpointer data);
+static gboolean leave_notify_event(GtkWidget *widget,
+                                   GdkEventCrossing *event, gpointer data);
 static gboolean delete_event(GtkWidget *widget,
                              GdkEvent  *event,
                              gpointer   data );
@@ -65,9 +1835,19 @@ static void henondraw (GtkWidget *drawing_area, GtkButton* button);
 static void lorenz_xydraw(GtkWidget* drawing_area, GtkButton* button);
 static void lorenz_yzdraw(GtkWidget* drawing_area, GtkButton* button);
 static void lorenz_xzdraw(GtkWidget* drawing_area, GtkButton* button);
+static void lorenz_3ddraw(GtkWidget* drawing_area, GtkButton* button);
 static void juliadraw (GtkWidget *drawing_area, GtkButton* button);
 static void juliasindraw(GtkWidget* drawing_area, GtkButton* button);
 static void mandeldraw (GtkWidget *drawing_area, GtkButton* button);
+static void formuladraw(GtkWidget *drawing_area, GtkButton* button);
+static void precision_toggled(GtkCheckMenuItem *item, gpointer data);
+static void antialias_toggled(GtkCheckMenuItem *item, gpointer data);
+static void show_samples_toggled(GtkCheckMenuItem *item, gpointer data);
+static void distance_toggled(GtkCheckMenuItem *item, gpointer data);
+static void inverse_toggled(GtkCheckMenuItem *item, gpointer data);
+static void julia_preview_toggled(GtkCheckMenuItem *item, gpointer data);
+static void more_iterations_activated(GtkMenuItem *item, gpointer data);
+static void auto_deepen_toggled(GtkCheckMenuItem *item, gpointer data);
 static void clear_drawing_area (GtkWidget* drawing_area);
 static void enter_button_a_clicked(GtkWidget *button, gpointer data);
 static void enter_button_b_clicked(GtkWidget *button, gpointer data);
@@ -83,698 +1863,7651 @@ static void open_function(GtkButton* button, gpointer user_data);
 
 //Function definitions
 
-//Generates Henon map
-static void henon(GtkWidget* drawing_area)
+//Render engine
+
+static RenderRequest *render_request_ref(RenderRequest *request)
 {
-  closing = FALSE;
+  g_atomic_int_inc(&request->ref_count);
 
-  cairo_t *cr;
+  return request;
+}
 
-  cr = cairo_create (surface);
+static void render_request_unref(RenderRequest *request)
+{
+  if (g_atomic_int_dec_and_test(&request->ref_count))
+  {
+    if (request->formula)
+      formula_free(request->formula);
+    if (request->results)
+      g_async_queue_unref(request->results);
+    g_free(request->lorenz_points);
+    g_free(request->lorenz_band_start);
+    g_free(request);
+  }
+}
 
-  int width;
-  int height;
-  long double x;
-  long double y;
-  long double init_x;
-  long double init_y;
-  long double x_new;
-  long double y_new;
-  long double a;
-  long double b;
-  long double d_screen_x;
-  long double d_screen_y;
-  int screen_x;
-  int screen_y;
-  int counter;
-  int max_count;
+//TRUE once a newer request (or Stop) has retired this one, or its job
+//has been cancelled
+static gboolean render_request_is_stale(RenderRequest *request)
+{
+  if (request->results)
+    return g_atomic_int_get(&request->cancelled);
 
-  counter = 0;
-  max_count = 40000;
+  return g_atomic_int_get(&render_generation) != request->generation;
+}
 
-  width = DAWIDTH;
-  height = DAHEIGHT;
+//Where the finished tiles of a request go
+static GAsyncQueue *render_request_results(RenderRequest *request)
+{
+  return request->results ? request->results : render_results;
+}
 
-  init_x = 0.1;
-  init_y = 0.1;
+static RenderTile *render_tile_new(RenderRequest *request,
+                                   int x, int y, int width, int height)
+{
+  RenderTile *tile;
 
-  //a = 1.4;
-  //b = 0.3;
+  tile = g_new0(RenderTile, 1);
+  tile->request = render_request_ref(request);
+  tile->x = x;
+  tile->y = y;
+  tile->width = width;
+  tile->height = height;
 
-  a = (long double)parameter_a;
-  b = (long double)parameter_b;
+  return tile;
+}
 
-  x = init_x;
-  y = init_y;
+static void render_tile_free(RenderTile *tile)
+{
+  render_request_unref(tile->request);
+  g_free(tile->pixels);
+  g_free(tile->points);
+  g_free(tile->distances);
+  g_free(tile->orbit_pixels);
+  g_free(tile->orbit_re);
+  g_free(tile->orbit_im);
+  g_free(tile);
+}
 
-  while (counter < max_count && closing == FALSE)
-  {
-    x_new = 1 - a*x*x + y;
-    y_new = b*x;
+//Adds a point to an attractor batch and hands full batches to the main
+//thread. Returns FALSE once the request has been superseded.
+static gboolean orbit_plot(RenderTile **batch, int screen_x, int screen_y)
+{
+  RenderTile *tile = *batch;
+  RenderRequest *request = tile->request;
 
-    x = x_new;
-    y = y_new;
+  if (tile->points == NULL)
+    tile->points = g_new(int, 2*ORBIT_BATCH);
 
-    //x = ((long double)screen_x/(1000/6.67)) - 3.335;
-    d_screen_x = ((x + 3.335)*(width/6.67));
-    screen_x = (int)d_screen_x;
+  tile->points[2*tile->n_points] = screen_x;
+  tile->points[2*tile->n_points + 1] = screen_y;
+  tile->n_points++;
 
-    //y = -(((long double)screen_y/(600/4)) - 2.0);
-    d_screen_y = ((-y + 2.0)*height/4);
-    screen_y = (int)d_screen_y;
+  if (tile->n_points < ORBIT_BATCH)
+    return TRUE;
 
-    cairo_set_source_rgb (cr, 0, 0, 0);
-    cairo_set_line_width (cr, 0.5);
-    cairo_set_line_cap (cr, CAIRO_LINE_CAP_ROUND);
-    cairo_move_to (cr, screen_x, screen_y);
-    cairo_close_path (cr);
-    cairo_stroke (cr);
+  orbit_deliver(tile);
+  *batch = orbit_batch_new(request);
 
-    gtk_widget_queue_draw_area(drawing_area, screen_x, screen_y, 1, 1);
+  return !render_request_is_stale(request);
+}
 
-    while (gtk_events_pending())
-    {
-      gtk_main_iteration();
-    }
+//Adds the kernel counters of a frame or sample batch to those of its tile
+static void render_counters_add(RenderCounters *to,
+                                const RenderCounters *from)
+{
+  int i;
 
-    counter++;
-  }
+  to->iterations += from->iterations;
+  to->interior += from->interior;
+  to->escaped += from->escaped;
+  to->samples += from->interior + from->escaped;
 
-  cairo_destroy (cr);
+  for (i = 0; i < HISTOGRAM_BINS; i++)
+    to->histogram[i] += from->histogram[i];
 }
 
-//Generates lorenz_xy attractor and displays in 2D
+//Antialiasing sample of pixel (x, y) in grid cell aa_cells[cell], at a
+//jittered position within the cell that only depends on the three
+//numbers, so a view renders the same every time
+static void render_sample_point(int x, int y, int cell, int *point)
+{
+  const int cell_size = SAMPLE_SCALE/AA_GRID;
+  guint32 hash;
+
+  hash = (guint32)x*73856093u ^ (guint32)y*19349663u ^
+         (guint32)cell*83492791u;
+  hash ^= hash >> 13;
+  hash *= 0x5bd1e995u;
+  hash ^= hash >> 15;
+
+  point[0] = x*SAMPLE_SCALE - SAMPLE_SCALE/2 + aa_cells[cell][0]*cell_size +
+             hash % cell_size;
+  point[1] = y*SAMPLE_SCALE - SAMPLE_SCALE/2 + aa_cells[cell][1]*cell_size +
+             (hash/cell_size) % cell_size;
+}
 
-/*
-Equations and code borrowed from Paul Bourke
-http://paulbourke.net/fractals/lorenz_xy/
+//Runs the kernel on samples first .. first + count - 1 of the given
+//pixels of a tile (indices into its rectangle). Sample j of pixel i is
+//pixels[i*count + j] of the batch returned.
+static RenderTile *render_tile_samples(RenderTile *tile,
+                                       const RenderKernel *kernel,
+                                       const int *pixels, int n_pixels,
+                                       int first, int count)
+{
+  RenderTile *batch;
+  int i;
+  int j;
 
-3 coupled non-linear differential equations
+  batch = render_tile_new(tile->request, 0, 0, 0, 0);
+  batch->n_points = n_pixels*count;
+  batch->points = g_new(int, 2*batch->n_points);
+  batch->pixels = g_new(guint32, batch->n_points);
 
-dx / dt = a (y - x)
-dy / dt = x (b - z) - y
-dz / dt = xy - c z
+  for (i = 0; i < n_pixels; i++)
+  {
+    for (j = 0; j < count; j++)
+      render_sample_point(tile->x + pixels[i] % tile->width,
+                          tile->y + pixels[i]/tile->width, first + j,
+                          batch->points + 2*(i*count + j));
+  }
 
-One commonly used set of constants is a = 10, b = 28, c = 8 / 3.
-Another is a = 28, b = 46.92, c = 4.
-"a" is sometimes known as the Prandtl number and "b" the Rayleigh number.
+  kernel->run(batch);
+  render_counters_add(&tile->counters, &batch->counters);
 
-*/
+  return batch;
+}
 
-static void lorenz_xy(GtkWidget* drawing_area)
+//Sums of the red, green and blue channels of RGB24 colors
+static void render_color_add(guint32 *sum, guint32 color)
 {
-  closing = FALSE;
+  sum[0] += (color >> 16) & 0xff;
+  sum[1] += (color >> 8) & 0xff;
+  sum[2] += color & 0xff;
+}
 
-  cairo_t *cr;
+static guint32 render_color_mean(const guint32 *sum, int n)
+{
+  return ((sum[0] + n/2)/n) << 16 | ((sum[1] + n/2)/n) << 8 |
+         (sum[2] + n/2)/n;
+}
 
-  cr = cairo_create (surface);
+//Halfway between two RGB24 colors, for the sample-count overlay
+static guint32 render_color_blend(guint32 a, guint32 b)
+{
+  return ((a & 0xfefefe) + (b & 0xfefefe)) >> 1;
+}
 
-  int width;
-  int height;
-  long double x;
-  long double y;
-  long double z;
-  long double init_x;
-  long double init_y;
-  long double init_z;
-  long double x_new;
-  long double y_new;
-  long double z_new;
-  long double d_screen_x;
-  long double d_screen_y;
-  int screen_x;
-  int screen_y;
-  int counter;
-  int max_count;
+//Computes an escape-time tile with adaptive antialiasing. The tile is
+//first computed with a border of one pixel, so pixels on its edges see
+//all their neighbors. A pixel that differs from any of its eight
+//neighbors gets AA_FIRST_SAMPLES - 1 more samples, and one whose samples
+//still disagree gets the rest of the AA_MAX_SAMPLES. Each pixel ends up
+//the mean of its samples.
+static void render_tile_antialias(RenderTile *tile,
+                                  const RenderKernel *kernel)
+{
+  RenderRequest *request = tile->request;
+  RenderTile *frame;
+  RenderTile *batch;
+  guint32 *sums;
+  guint32 color;
+  gboolean differs;
+  int *edges;
+  int *mixed;
+  int *refine;
+  int *samples;
+  int n_edges = 0;
+  int n_mixed = 0;
+  int frame_width = tile->width + 2;
+  int first = AA_FIRST_SAMPLES - 1;
+  int rest = AA_MAX_SAMPLES - AA_FIRST_SAMPLES;
+  int x;
+  int y;
+  int dx;
+  int dy;
+  int i;
+  int j;
+
+  frame = render_tile_new(request, tile->x - 1, tile->y - 1,
+                          frame_width, tile->height + 2);
+  frame->pixels = g_new(guint32, frame->width*frame->height);
+  if (tile->orbit_pixels)
+    render_tile_alloc_orbits(frame);
+  kernel->run(frame);
+
+  //Orbits of the frame's inner pixels; render_worker() drops those of
+  //pixels that do not end up interior
+  for (i = 0; i < frame->unresolved; i++)
+  {
+    x = frame->orbit_pixels[i]%frame_width - 1;
+    y = frame->orbit_pixels[i]/frame_width - 1;
 
-  long double h = 0.01;
-  long double a = 10.0;
-  long double b = 28.0;
-  long double c = 8.0 / 3.0;
+    if (x >= 0 && x < tile->width && y >= 0 && y < tile->height)
+    {
+      j = tile->unresolved++;
+      tile->orbit_pixels[j] = y*tile->width + x;
+      tile->orbit_re[j] = frame->orbit_re[i];
+      tile->orbit_im[j] = frame->orbit_im[i];
+    }
+  }
 
-  counter = 0;
-  max_count = 400000;
+  //The border counts as extra samples; the tile's own pixels do not
+  render_counters_add(&tile->counters, &frame->counters);
+  tile->counters.samples -= tile->width*tile->height;
 
-  width = DAWIDTH;
-  height = DAHEIGHT;
+  edges = g_new(int, tile->width*tile->height);
 
-  init_x = 0.1;
-  init_y = 0.0;
-  init_z = 0.0;
+  for (y = 0; y < tile->height; y++)
+  {
+    for (x = 0; x < tile->width; x++)
+    {
+      color = frame->pixels[(y + 1)*frame_width + x + 1];
+      tile->pixels[y*tile->width + x] = color;
 
-  x = init_x;
-  y = init_y;
-  z = init_z;
+      differs = FALSE;
+      for (dy = 0; dy <= 2; dy++)
+      {
+        for (dx = 0; dx <= 2; dx++)
+          differs |= frame->pixels[(y + dy)*frame_width + x + dx] != color;
+      }
 
-  while (counter < max_count && closing == FALSE)
+      if (differs)
+        edges[n_edges++] = y*tile->width + x;
+    }
+  }
+
+  render_tile_free(frame);
+
+  sums = g_new0(guint32, 3*n_edges);
+  samples = g_new(int, n_edges);
+  mixed = g_new(int, n_edges);
+  refine = g_new(int, n_edges);
+
+  //First round: one more sample in each quadrant
+  batch = render_tile_samples(tile, kernel, edges, n_edges, 0, first);
+
+  for (i = 0; i < n_edges; i++)
   {
-    x_new = x + h * a * (y - x);
-    y_new = y + h * (x * (b - z) - y);
-    z_new = z + h * (x * y - c * z);
+    color = tile->pixels[edges[i]];
+    render_color_add(sums + 3*i, color);
+    samples[i] = AA_FIRST_SAMPLES;
 
-    x = x_new;
-    y = y_new;
-    z = z_new;
+    differs = FALSE;
+    for (j = 0; j < first; j++)
+    {
+      render_color_add(sums + 3*i, batch->pixels[i*first + j]);
+      differs |= batch->pixels[i*first + j] != color;
+    }
 
-    //x = (screen_x/(1000/5) - 2.5);
-    //d_screen_x = (x + 2.5)*(width/5);
+    if (differs)
+    {
+      mixed[n_mixed] = i;
+      refine[n_mixed] = edges[i];
+      n_mixed++;
+    }
+  }
 
-    //x = d_screen_x/10 - 50.0
-    d_screen_x = (x + 50.0)*10;
-    screen_x = (int)d_screen_x;
+  render_tile_free(batch);
 
-    //y = -(d_screen_y/(600/3) - 1.5);
-    //d_screen_y = (-y + 1.5)*(height/3);
+  //Second round: the rest of the grid where those disagree
+  batch = render_tile_samples(tile, kernel, refine, n_mixed, first, rest);
 
-    //y = -(d_screen_y/6 - 50.0);
-    d_screen_y = (-y + 50.0)*6;
-    screen_y = (int)d_screen_y;
+  for (i = 0; i < n_mixed; i++)
+  {
+    for (j = 0; j < rest; j++)
+      render_color_add(sums + 3*mixed[i], batch->pixels[i*rest + j]);
+    samples[mixed[i]] = AA_MAX_SAMPLES;
+  }
 
-    cairo_set_source_rgb (cr, 0, 0, 0);
-    cairo_set_line_width (cr, 0.5);
-    cairo_set_line_cap (cr, CAIRO_LINE_CAP_ROUND);
-    cairo_move_to (cr, screen_x, screen_y);
-    cairo_close_path (cr);
-    cairo_stroke (cr);
+  render_tile_free(batch);
+
+  for (i = 0; i < n_edges; i++)
+  {
+    color = render_color_mean(sums + 3*i, samples[i]);
+
+    if (request->show_samples)
+      color = render_color_blend(color, samples[i] == AA_MAX_SAMPLES ?
+                                        COLOR_MAX_SAMPLES :
+                                        COLOR_FIRST_SAMPLES);
+
+    tile->pixels[edges[i]] = color;
+  }
+
+  g_free(refine);
+  g_free(mixed);
+  g_free(samples);
+  g_free(sums);
+  g_free(edges);
+}
 
-    gtk_widget_queue_draw_area(drawing_area, screen_x, screen_y, 1, 1);
+//Makes room in a tile's side table for every one of its pixels
+static void render_tile_alloc_orbits(RenderTile *tile)
+{
+  int size = tile->width*tile->height;
+
+  tile->orbit_pixels = g_new(guint16, size);
+  tile->orbit_re = g_new(double, size);
+  tile->orbit_im = g_new(double, size);
+  tile->unresolved = 0;
+}
+
+//Drops the orbits of pixels that are no longer interior (escaped, or
+//antialiased with exterior samples) and shrinks the side table to the
+//entries left
+static void render_tile_compact_orbits(RenderTile *tile)
+{
+  int n = 0;
+  int i;
 
-    while (gtk_events_pending())
+  for (i = 0; i < tile->unresolved; i++)
+  {
+    if (tile->pixels[tile->orbit_pixels[i]] == COLOR_INTERIOR)
     {
-      gtk_main_iteration();
+      tile->orbit_pixels[n] = tile->orbit_pixels[i];
+      tile->orbit_re[n] = tile->orbit_re[i];
+      tile->orbit_im[n] = tile->orbit_im[i];
+      n++;
     }
-
-    counter++;
   }
 
-  cairo_destroy (cr);
+  tile->unresolved = n;
+  tile->orbit_pixels = g_renew(guint16, tile->orbit_pixels, n);
+  tile->orbit_re = g_renew(double, tile->orbit_re, n);
+  tile->orbit_im = g_renew(double, tile->orbit_im, n);
 }
 
-static void lorenz_yz(GtkWidget* drawing_area)
+//Memory a tile kept for iteration deepening holds: its pixels and the
+//side table
+static gint64 render_tile_state_bytes(RenderTile *tile)
 {
-  closing = FALSE;
+  return sizeof(RenderTile) +
+         (gint64)tile->width*tile->height*sizeof(guint32) +
+         (gint64)tile->unresolved*(sizeof(guint16) + 2*sizeof(double));
+}
 
-  cairo_t *cr;
+//Colors a block of a tile's pixels (in image coordinates)
+static void render_tile_fill(RenderTile *tile, const GdkRectangle *block,
+                             guint32 color)
+{
+  guint32 *pixel;
+  int x;
+  int y;
 
-  cr = cairo_create (surface);
+  for (y = block->y; y < block->y + block->height; y++)
+  {
+    pixel = tile->pixels + (y - tile->y)*tile->width + block->x - tile->x;
 
-  int width;
-  int height;
-  long double x;
-  long double y;
-  long double z;
-  long double init_x;
-  long double init_y;
-  long double init_z;
+    for (x = 0; x < block->width; x++)
+      pixel[x] = color;
+  }
+}
+
+//Computes an escape-time tile by distance estimation, one level of
+//blocks at a time, starting from the whole tile. Each block is probed at
+//its center: a block all of whose pixels are shown to lie more than
+//DISTANCE_BAND pixels from the set is filled with COLOR_EXTERIOR, one
+//whose center has no estimate or that has DISTANCE_MIN_BLOCK pixels or
+//fewer is split into its pixels, and any other is split in four. A
+//pixel is drawn with the set when it is within DISTANCE_BAND pixels of
+//it, so thin filaments stay whole.
+static void render_tile_boundary(RenderTile *tile,
+                                 const RenderKernel *kernel)
+{
+  RenderRequest *request = tile->request;
+  RenderTile *batch;
+  GdkRectangle *blocks;
+  GdkRectangle *next;
+  GdkRectangle *swap;
+  GdkRectangle *block;
+  GdkRectangle part;
+  double distance;
+  double radius;
+  int n_blocks = 1;
+  int n_next;
+  int x;
+  int y;
+  int i;
+
+  //Blocks of one level never overlap, so there are at most as many as
+  //pixels
+  blocks = g_new(GdkRectangle, tile->width*tile->height);
+  next = g_new(GdkRectangle, tile->width*tile->height);
+  blocks[0].x = tile->x;
+  blocks[0].y = tile->y;
+  blocks[0].width = tile->width;
+  blocks[0].height = tile->height;
+
+  //Every probe counts as a sample; the tile's pixels do not
+  tile->counters.samples -= tile->width*tile->height;
+
+  while (n_blocks > 0)
+  {
+    batch = render_tile_new(request, 0, 0, 0, 0);
+    batch->n_points = n_blocks;
+    batch->points = g_new(int, 2*n_blocks);
+    batch->pixels = g_new(guint32, n_blocks);
+    batch->distances = g_new(double, n_blocks);
+
+    for (i = 0; i < n_blocks; i++)
+    {
+      block = &blocks[i];
+      batch->points[2*i] = (2*block->x + block->width - 1)*SAMPLE_SCALE/2;
+      batch->points[2*i + 1] = (2*block->y + block->height - 1)*
+                               SAMPLE_SCALE/2;
+    }
+
+    kernel->run(batch);
+    render_counters_add(&tile->counters, &batch->counters);
+
+    n_next = 0;
+
+    for (i = 0; i < n_blocks; i++)
+    {
+      block = &blocks[i];
+      distance = batch->distances[i];
+      radius = 0.5*sqrt((block->width - 1)*(block->width - 1) +
+                        (block->height - 1)*(block->height - 1));
+
+      if (block->width == 1 && block->height == 1)
+      {
+        render_tile_fill(tile, block, distance < DISTANCE_BAND ?
+                                      COLOR_INTERIOR : COLOR_EXTERIOR);
+      }
+
+      else if (request->distance_fill &&
+               distance >= DISTANCE_SAFETY*(radius + DISTANCE_BAND))
+      {
+        render_tile_fill(tile, block, COLOR_EXTERIOR);
+      }
+
+      else if (distance < 0 ||
+               block->width*block->height <= DISTANCE_MIN_BLOCK)
+      {
+        for (y = block->y; y < block->y + block->height; y++)
+        {
+          for (x = block->x; x < block->x + block->width; x++)
+          {
+            next[n_next].x = x;
+            next[n_next].y = y;
+            next[n_next].width = 1;
+            next[n_next].height = 1;
+            n_next++;
+          }
+        }
+      }
+
+      else
+      {
+        //Quarters, of which the right and bottom ones may be empty
+        for (y = 0; y < 2; y++)
+        {
+          for (x = 0; x < 2; x++)
+          {
+            part.width = x == 0 ? (block->width + 1)/2 : block->width/2;
+            part.height = y == 0 ? (block->height + 1)/2 : block->height/2;
+            part.x = block->x + x*((block->width + 1)/2);
+            part.y = block->y + y*((block->height + 1)/2);
+
+            if (part.width > 0 && part.height > 0)
+              next[n_next++] = part;
+          }
+        }
+      }
+    }
+
+    render_tile_free(batch);
+
+    swap = blocks;
+    blocks = next;
+    next = swap;
+    n_blocks = n_next;
+  }
+
+  g_free(next);
+  g_free(blocks);
+}
+
+//Whether the Julia set of z -> z*z + a + bi is connected, which it is
+//when the orbit of 0 stays bounded
+static gboolean render_julia_connected(long double a, long double b)
+{
+  long double x = 0;
+  long double y = 0;
   long double x_new;
-  long double y_new;
-  long double z_new;
-  long double d_screen_x;
-  long double d_screen_y;
-  long double d_screen_z;
-  int screen_x;
-  int screen_y;
-  int screen_z;
-  int counter;
-  int max_count;
+  int i;
 
-  long double h = 0.01;
-  long double a = 10.0;
-  long double b = 28.0;
-  long double c = 8.0 / 3.0;
+  for (i = 0; i < DISTANCE_CONNECTED_ITERATIONS; i++)
+  {
+    x_new = x*x - y*y + a;
+    y = 2*x*y + b;
+    x = x_new;
 
-  counter = 0;
-  max_count = 100000;
+    if (x*x + y*y > 4)
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+//Draws the Julia set of z -> z*z + c over the whole image by the modified
+//inverse iteration method. Starting from the repelling fixed point, both
+//preimages +-sqrt(z - c) of every point are taken in turn, depth first.
+//The set attracts the backward orbits, so each preimage lies on it, but
+//they pile up where the set is easy to reach; a point whose pixel (or
+//grid cell, outside the image) has been reached INVERSE_MAX_HITS times
+//already is plotted but not followed further, which spreads the work
+//evenly over the boundary. Works in double precision whatever the menu
+//says, and is meant for views of the whole set: zoomed in, the pruning
+//outside the image cuts off most of the orbits that would reach it.
+static void julia_inverse(RenderTile *tile)
+{
+  RenderRequest *request = tile->request;
+  int width = tile->width;
+  int height = tile->height;
+  double re_min = (double)request->re_min;
+  double im_max = (double)request->im_max;
+  double x_scale = (double)request->x_scale;
+  double y_scale = (double)request->y_scale;
+  double c_re = (double)request->parameter_a;
+  double c_im = (double)request->parameter_b;
+  double radius;
+  double cell_scale;
+  double r;
+  double w_re;
+  double w_im;
+  double px;
+  double py;
+  guint8 *hits;
+  guint8 *cells;
+  guint8 *count;
+  GArray *stack;
+  InversePoint point;
+  gint64 visited = 0;
+  int i;
+
+  for (i = 0; i < width*height; i++)
+    tile->pixels[i] = COLOR_EXTERIOR;
+
+  hits = g_new0(guint8, width*height);
+  cells = g_new0(guint8, INVERSE_GRID*INVERSE_GRID);
+  stack = g_array_new(FALSE, FALSE, sizeof(InversePoint));
+
+  //|z| > radius escapes, so the set lies in the disk and so does the grid
+  radius = 0.5 + sqrt(0.25 + hypot(c_re, c_im));
+  cell_scale = INVERSE_GRID/(2*radius);
+
+  //The fixed point 1/2 + sqrt(1/4 - c), which is repelling (or at worst
+  //parabolic) and so on the set
+  w_re = 0.25 - c_re;
+  w_im = -c_im;
+  r = hypot(w_re, w_im);
+  point.re = 0.5 + sqrt(0.5*(r + w_re));
+  point.im = copysign(sqrt(0.5*(r - w_re)), w_im);
+  point.depth = 0;
+  g_array_append_val(stack, point);
+
+  while (stack->len > 0)
+  {
+    point = g_array_index(stack, InversePoint, stack->len - 1);
+    g_array_set_size(stack, stack->len - 1);
+
+    if (++visited % INVERSE_CHECK == 0 && render_request_is_stale(request))
+      break;
+
+    px = (point.re - re_min)*x_scale;
+    py = (im_max - point.im)*y_scale;
+
+    if (px >= 0 && px < width && py >= 0 && py < height)
+    {
+      i = (int)py*width + (int)px;
+      count = &hits[i];
+
+      if (*count == 0)
+      {
+        tile->pixels[i] = COLOR_INTERIOR;
+        tile->counters.interior++;
+      }
+    }
+
+    else
+    {
+      px = (point.re + radius)*cell_scale;
+      py = (point.im + radius)*cell_scale;
+      if (px < 0 || px >= INVERSE_GRID || py < 0 || py >= INVERSE_GRID)
+        continue;
+
+      count = &cells[(int)py*INVERSE_GRID + (int)px];
+    }
+
+    if (*count >= INVERSE_MAX_HITS || point.depth >= INVERSE_MAX_DEPTH)
+      continue;
+    (*count)++;
+
+    //The principal square root of z - c and its negative
+    w_re = point.re - c_re;
+    w_im = point.im - c_im;
+    r = hypot(w_re, w_im);
+    point.re = sqrt(0.5*(r + w_re));
+    point.im = copysign(sqrt(0.5*(r - w_re)), w_im);
+    point.depth++;
+    g_array_append_val(stack, point);
+
+    point.re = -point.re;
+    point.im = -point.im;
+    g_array_append_val(stack, point);
+  }
+
+  tile->counters.iterations = visited;
+  tile->counters.escaped = width*height - tile->counters.interior;
+
+  g_array_free(stack, TRUE);
+  g_free(cells);
+  g_free(hits);
+}
+
+//Thread pool function: computes one tile, or a whole attractor orbit,
+//unless the request has been retired in the meantime
+static void render_worker(gpointer data, gpointer user_data)
+{
+  RenderTile *tile = data;
+  RenderRequest *request = render_request_ref(tile->request);
+  const RenderKernel *kernel;
+  const RenderKernel *distance_kernel;
+
+  kernel = render_kernel(request->type, request->precision, request->simd);
+  distance_kernel = render_distance_kernel(request);
+
+  if (render_request_is_stale(request))
+  {
+    render_tile_free(tile);
+  }
+
+  else if (kernel || request->type == FRACTAL_LORENZ_3D)
+  {
+    //A deepening pass continues the pixels and orbits the tile has
+    if (tile->deepen == 0)
+    {
+      tile->pixels = g_new(guint32, tile->width*tile->height);
+      if (request->keep_orbits)
+        render_tile_alloc_orbits(tile);
+    }
+
+    //The kernels color the pixels as they go, so "tile" covers both
+    trace_begin_tile("tile", tile->x, tile->y);
+    render_tile_start_clock(tile);
+
+    if (tile->deepen)
+      render_tile_deepen(tile);
+    else if (request->type == FRACTAL_LORENZ_3D)
+      lorenz_3d_band(tile);
+    else if (request->inverse)
+      julia_inverse(tile);
+    else if (distance_kernel)
+      render_tile_boundary(tile, distance_kernel);
+    else if (request->antialias)
+      render_tile_antialias(tile, kernel);
+    else
+      kernel->run(tile);
+
+    if (tile->orbit_pixels)
+      render_tile_compact_orbits(tile);
+
+    render_tile_stop_clock(tile);
+    trace_end("tile");
+
+    g_async_queue_push(render_request_results(request), tile);
+  }
+
+  else
+  {
+    render_tile_free(tile);
+
+    trace_begin("orbit");
+
+    if (request->type == FRACTAL_HENON)
+      henon(request);
+    else if (request->type == FRACTAL_LORENZ_XY)
+      lorenz_xy(request);
+    else if (request->type == FRACTAL_LORENZ_YZ)
+      lorenz_yz(request);
+    else
+      lorenz_xz(request);
+
+    trace_end("orbit");
+  }
+
+  //Only counted down after the results are queued, so render_flush()
+  //knows nothing more is coming once this reaches zero
+  g_atomic_int_add(&request->tiles_pending, -1);
+  render_request_unref(request);
+}
+
+//Sets the part of the complex plane shown for the request's fractal: the
+//current zoom, or the initial view when the fractal has changed
+static void render_set_view(RenderRequest *request)
+{
+  gboolean julia_style;
+
+  julia_style = request->type == FRACTAL_FORMULA &&
+                request->formula->julia_style;
+
+  if (request->type != view_type || julia_style != view_julia_style)
+  {
+    view_type = request->type;
+    view_julia_style = julia_style;
+    view_zoom = 1.0;
+    render_initial_center(request, &view_center_re, &view_center_im);
+  }
+
+  render_set_center(request, view_center_re, view_center_im, view_zoom);
+}
+
+//Center of the initial view of the request's fractal, in fixed point with
+//VIEW_BITS fraction bits
+static void render_initial_center(RenderRequest *request,
+                                  __int128 *center_re, __int128 *center_im)
+{
+  long double re_min;
+
+  if (request->type == FRACTAL_MANDEL ||
+      (request->type == FRACTAL_FORMULA && !request->formula->julia_style))
+    re_min = -2.5;
+  else
+    re_min = -2.0;
+
+  *center_re = fixed128_from(re_min + (long double)(request->width/2)/
+                             (request->width/5), VIEW_BITS);
+  *center_im = fixed128_from(1.5 - (long double)(request->height/2)/
+                             (request->height/3), VIEW_BITS);
+}
+
+//Sets the view of a request from its center and zoom
+static void render_set_center(RenderRequest *request, __int128 center_re,
+                              __int128 center_im, long double zoom)
+{
+  int half_width = request->width/2;
+  int half_height = request->height/2;
+
+  //x_scale and y_scale are kept as the integer divisions of the original
+  //loops, d_screen_x/(width/5) and d_screen_y/(height/3), times the zoom
+  request->x_scale = (request->width/5)*zoom;
+  request->y_scale = (request->height/3)*zoom;
+  request->re_min = ldexpl(center_re, -VIEW_BITS) -
+                    half_width/request->x_scale;
+  request->im_max = ldexpl(center_im, -VIEW_BITS) +
+                    half_height/request->y_scale;
+
+  request->view_step_x = fixed128_from(1.0/request->x_scale, VIEW_BITS);
+  request->view_step_y = fixed128_from(1.0/request->y_scale, VIEW_BITS);
+  request->view_re_min = center_re - half_width*request->view_step_x;
+  request->view_im_max = center_im + half_height*request->view_step_y;
+}
+
+//Fraction bits of the fixed-point kernels: --fixed-bits, brought into
+//the range of the precision, or the most the precision holds
+static int render_fixed_bits(RenderPrecision precision)
+{
+  int low = FIXED64_MIN_BITS;
+  int high = FIXED64_MAX_BITS;
+
+  if (precision == PRECISION_FIXED128)
+  {
+    low = FIXED128_MIN_BITS;
+    high = FIXED128_MAX_BITS;
+  }
+
+  if (fixed_bits == 0)
+    return high;
+
+  return CLAMP(fixed_bits, low, high);
+}
+
+//Returns twice the pixel coordinate at which offset + coordinate/scale
+//is zero, or -1 when that does not fall on a whole or half pixel inside
+//the image. Working with twice the coordinate keeps axes that lie
+//between two pixel rows exact.
+static int render_symmetry_axis(long double offset, long double scale)
+{
+  long double axis;
+
+  axis = 2*offset*scale;
+
+  if (axis <= 0 || axis > G_MAXINT/2 || axis != floorl(axis))
+    return -1;
+
+  return (int)axis;
+}
+
+//The Mandelbrot set is symmetric about the real axis, and the Julia sets
+//of z*z + c are symmetric under z -> -z. When the view contains the axis
+//(or the origin), only the unique part is computed and the rest mirrored.
+static void render_set_symmetry(RenderRequest *request)
+{
+  int width = request->width;
+  int height = request->height;
+  int half;
+
+  request->mirror_x = -1;
+  request->mirror_y = -1;
+  memset(&request->mirror, 0, sizeof(request->mirror));
+
+  if ((request->type != FRACTAL_MANDEL && request->type != FRACTAL_JULIA) ||
+      request->inverse)
+    return;
+
+  request->mirror_y = render_symmetry_axis(request->im_max, request->y_scale);
+  if (request->mirror_y < 0)
+    return;
+
+  if (request->type == FRACTAL_JULIA)
+  {
+    request->mirror_x = render_symmetry_axis(-request->re_min,
+                                             request->x_scale);
+    if (request->mirror_x < 0)
+    {
+      request->mirror_y = -1;
+      return;
+    }
+  }
+
+  //Rows below the axis whose partner row is in the image; a row on the
+  //axis is its own partner and is computed
+  half = request->mirror_y/2;
+  request->mirror.y = half + 1;
+  request->mirror.height = MIN(request->mirror_y, height - 1) - half;
+
+  //Columns whose partner column is in the image
+  if (request->mirror_x >= 0)
+  {
+    request->mirror.x = MAX(0, request->mirror_x - (width - 1));
+    request->mirror.width = MIN(width - 1, request->mirror_x) -
+                            request->mirror.x + 1;
+  }
+  else
+  {
+    request->mirror.x = 0;
+    request->mirror.width = width;
+  }
+
+  if (request->mirror.width <= 0 || request->mirror.height <= 0)
+  {
+    request->mirror_x = -1;
+    request->mirror_y = -1;
+    memset(&request->mirror, 0, sizeof(request->mirror));
+  }
+}
+
+//Splits a rectangle of the image into tiles, for render_push_tiles()
+static void render_queue_tiles(RenderRequest *request, GPtrArray *tiles,
+                               int x_begin, int x_end,
+                               int y_begin, int y_end)
+{
+  int x;
+  int y;
+
+  for (x = x_begin; x < x_end; x += TILE_SIZE)
+  {
+    for (y = y_begin; y < y_end; y += TILE_SIZE)
+    {
+      request->tiles_pending++;
+      g_ptr_array_add(tiles, render_tile_new(request, x, y,
+                                             MIN(TILE_SIZE, x_end - x),
+                                             MIN(TILE_SIZE, y_end - y)));
+    }
+  }
+}
+
+//Square of the distance from the center of a tile to the focus of its
+//request. In 64 bits, as canvas images are up to CANVAS_MAX_SIZE wide.
+static gint64 render_tile_distance(const RenderTile *tile)
+{
+  RenderRequest *request = tile->request;
+  gint focus_x;
+  gint focus_y;
+  gint64 dx;
+  gint64 dy;
+
+  if (request->results)
+  {
+    focus_x = request->focus_x;
+    focus_y = request->focus_y;
+  }
+  else
+  {
+    focus_x = g_atomic_int_get(&render_focus_x);
+    focus_y = g_atomic_int_get(&render_focus_y);
+  }
+
+  if (focus_x < 0 || focus_y < 0)
+  {
+    focus_x = request->width/2;
+    focus_y = request->height/2;
+  }
+
+  dx = tile->x + tile->width/2 - focus_x;
+  dy = tile->y + tile->height/2 - focus_y;
+
+  return dx*dx + dy*dy;
+}
+
+//Sort function of the render pool: the tiles of newer requests first,
+//then the tiles nearest the focus, so the image fills in from the center
+//(or the pointer) outwards
+static gint render_tile_compare(gconstpointer a, gconstpointer b,
+                                gpointer user_data)
+{
+  const RenderTile *tile_a = a;
+  const RenderTile *tile_b = b;
+  gint64 distance_a;
+  gint64 distance_b;
+
+  if (tile_a->request->generation != tile_b->request->generation)
+    return tile_b->request->generation - tile_a->request->generation;
+
+  distance_a = render_tile_distance(tile_a);
+  distance_b = render_tile_distance(tile_b);
+
+  return (distance_a > distance_b) - (distance_a < distance_b);
+}
+
+//render_tile_compare() for a GPtrArray of tiles
+static gint render_tile_compare_indirect(gconstpointer a, gconstpointer b,
+                                         gpointer user_data)
+{
+  return render_tile_compare(*(RenderTile * const *)a,
+                             *(RenderTile * const *)b, user_data);
+}
+
+//Hands the tiles to the render threads, nearest the focus first. Idle
+//threads take tiles as soon as they are pushed, so the pushes themselves
+//go in order as well as the pool's queue.
+static void render_push_tiles(GPtrArray *tiles)
+{
+  guint i;
+
+  g_ptr_array_sort_with_data(tiles, render_tile_compare_indirect, NULL);
+
+  for (i = 0; i < tiles->len; i++)
+    g_thread_pool_push(render_pool, g_ptr_array_index(tiles, i), NULL);
+
+  g_ptr_array_free(tiles, TRUE);
+}
+
+//Moves the focus to (x, y), or back to the center for -1, and reorders
+//the tiles still waiting when that changes the tile it falls in
+static void render_set_focus(int x, int y)
+{
+  gint focus_x = g_atomic_int_get(&render_focus_x);
+  gint focus_y = g_atomic_int_get(&render_focus_y);
+
+  if (x < 0 || y < 0)
+  {
+    x = -1;
+    y = -1;
+  }
+
+  if ((x < 0 && focus_x < 0) ||
+      (x >= 0 && focus_x >= 0 && x/TILE_SIZE == focus_x/TILE_SIZE &&
+       y/TILE_SIZE == focus_y/TILE_SIZE))
+    return;
+
+  g_atomic_int_set(&render_focus_x, x);
+  g_atomic_int_set(&render_focus_y, y);
+
+  //Setting the sort function again sorts the waiting tiles
+  if (render_flush_id != 0)
+    g_thread_pool_set_sort_function(render_pool, render_tile_compare, NULL);
+}
+
+//The part of the mirror rectangle that is copied from this tile
+static gboolean render_tile_mirror_rect(RenderTile *tile, GdkRectangle *rect)
+{
+  RenderRequest *request = tile->request;
+  GdkRectangle image;
+
+  if (request->mirror_y < 0 || tile->pixels == NULL)
+    return FALSE;
+
+  image.y = request->mirror_y - (tile->y + tile->height - 1);
+  image.height = tile->height;
+
+  if (request->mirror_x >= 0)
+    image.x = request->mirror_x - (tile->x + tile->width - 1);
+  else
+    image.x = tile->x;
+  image.width = tile->width;
+
+  return gdk_rectangle_intersect(&image, &request->mirror, rect);
+}
+
+//A request of the given size with the current parameters and one sample
+//per pixel; its view is still to be set
+static RenderRequest *render_request_alloc(FractalType type,
+                                           RenderPrecision precision,
+                                           int width, int height)
+{
+  RenderRequest *request;
+
+  request = g_new0(RenderRequest, 1);
+  request->ref_count = 1;
+  request->type = type;
+  request->width = width;
+  request->height = height;
+  request->parameter_a = (long double)parameter_a;
+  request->parameter_b = (long double)parameter_b;
+  request->precision = precision;
+  request->simd = render_simd;
+  request->fixed_bits = render_fixed_bits(precision);
+  request->iterations = MAX_ITERATIONS;
+  request->focus_x = -1;
+  request->focus_y = -1;
+  if (type == FRACTAL_LORENZ_3D)
+    lorenz_3d_rotation(request);
+
+  return request;
+}
+
+//A request for the current parameters and view, with a new generation
+//number, which retires the requests before it
+static RenderRequest *render_request_new(FractalType type,
+                                         RenderPrecision precision)
+{
+  RenderRequest *request;
+
+  request = render_request_alloc(type, precision, DAWIDTH, DAHEIGHT);
+  request->antialias = render_antialias;
+  request->show_samples = render_show_samples;
+  request->distance = render_distance;
+  request->distance_fill = type == FRACTAL_MANDEL ||
+                           (type == FRACTAL_JULIA &&
+                            render_julia_connected(request->parameter_a,
+                                                   request->parameter_b));
+  request->inverse = render_inverse && type == FRACTAL_JULIA;
+  request->generation = g_atomic_int_add(&render_generation, 1) + 1;
+
+  if (type == FRACTAL_FORMULA)
+    request->formula = formula_copy(current_formula);
+
+  render_set_view(request);
+
+  return request;
+}
+
+//Retires any render in flight and queues the tiles of a new one on the
+//render threads. The threads themselves are reused.
+static void render_start(GtkWidget *drawing_area, FractalType type)
+{
+  RenderRequest *request;
+  GdkRectangle *mirror;
+  GPtrArray *tiles;
+  int bands;
+  int band;
+  int y;
+
+  request = render_request_new(type, render_precision);
+  request->keep_orbits = (type == FRACTAL_MANDEL || type == FRACTAL_JULIA) &&
+                         request->precision == PRECISION_DOUBLE &&
+                         !request->distance && !request->inverse;
+  render_set_symmetry(request);
+  render_set_focus(-1, -1);
+  render_deepen_clear();
+
+  if (current_request)
+    render_request_unref(current_request);
+  current_request = request;
+
+  if (render_kernel(type, request->precision, request->simd))
+  {
+    //Everything outside the mirror rectangle: the rows above and below
+    //it, and the columns beside it that have no partner in the image
+    mirror = &request->mirror;
+    tiles = g_ptr_array_new();
+
+    if (request->inverse)
+    {
+      //The backward orbits roam the whole image, so it is a single tile
+      request->tiles_pending = 1;
+      g_ptr_array_add(tiles, render_tile_new(request, 0, 0, request->width,
+                                             request->height));
+    }
+
+    else if (mirror->height > 0)
+    {
+      render_queue_tiles(request, tiles, 0, request->width, 0, mirror->y);
+      render_queue_tiles(request, tiles, 0, mirror->x,
+                         mirror->y, mirror->y + mirror->height);
+      render_queue_tiles(request, tiles,
+                         mirror->x + mirror->width, request->width,
+                         mirror->y, mirror->y + mirror->height);
+      render_queue_tiles(request, tiles, 0, request->width,
+                         mirror->y + mirror->height, request->height);
+    }
+
+    else
+    {
+      render_queue_tiles(request, tiles,
+                         0, request->width, 0, request->height);
+    }
+
+    render_push_tiles(tiles);
+  }
+
+  else if (type == FRACTAL_LORENZ_3D)
+  {
+    //One band of the image per render thread
+    tiles = g_ptr_array_new();
+    bands = g_thread_pool_get_max_threads(render_pool);
+    band = (request->height + bands - 1)/bands;
+    lorenz_3d_setup(request, band);
+
+    for (y = 0; y < request->height; y += band)
+    {
+      request->tiles_pending++;
+      g_ptr_array_add(tiles, render_tile_new(request, 0, y, request->width,
+                                             MIN(band, request->height - y)));
+    }
+
+    render_push_tiles(tiles);
+  }
+
+  else
+  {
+    //Attractor orbits are sequential, so they run as a single job
+    request->tiles_pending = 1;
+    g_thread_pool_push(render_pool, render_tile_new(request, 0, 0, 0, 0),
+                       NULL);
+  }
+
+  render_stats_reset(request, request->tiles_pending);
+
+  if (render_flush_id == 0)
+    render_flush_id = g_timeout_add(16, render_flush, drawing_area);
+}
+
+//Retires the render in flight without starting a new one
+static void render_cancel(void)
+{
+  RenderTile *tile;
+
+  g_atomic_int_inc(&render_generation);
+
+  if (render_flush_id)
+  {
+    g_source_remove(render_flush_id);
+    render_flush_id = 0;
+
+    render_stats.stopped = TRUE;
+    render_stats.end_time = g_get_monotonic_time();
+  }
+
+  while ((tile = g_async_queue_try_pop(render_results)) != NULL)
+    render_tile_free(tile);
+
+  render_deepen_clear();
+}
+
+//Drops the tiles kept for iteration deepening
+static void render_deepen_clear(void)
+{
+  guint i;
+
+  if (deepen_tiles == NULL)
+    deepen_tiles = g_ptr_array_new();
+
+  for (i = 0; i < deepen_tiles->len; i++)
+    render_tile_free(g_ptr_array_index(deepen_tiles, i));
+  g_ptr_array_set_size(deepen_tiles, 0);
+
+  render_stats.state_bytes = 0;
+}
+
+//Whether auto-deepening goes on after the pass just finished: after the
+//first one, and after passes that decided at least DEEPEN_THRESHOLD of
+//the pixels they continued
+static gboolean render_deepen_wanted(void)
+{
+  if (current_request == NULL || !current_request->keep_orbits ||
+      current_request->iterations >= DEEPEN_MAX_ITERATIONS)
+    return FALSE;
+
+  if (current_request->iterations == MAX_ITERATIONS)
+    return TRUE;
+
+  return render_stats.escaped - deepen_escaped >=
+         DEEPEN_THRESHOLD*deepen_unresolved;
+}
+
+//Queues the kept tiles of the current render again, to continue their
+//orbits for as many iterations as the limit so far. Returns FALSE when
+//there is nothing to continue.
+static gboolean render_deepen(GtkWidget *drawing_area)
+{
+  RenderRequest *request = current_request;
+  RenderTile *tile;
+  GPtrArray *tiles;
+  guint i;
+
+  if (request == NULL || render_request_is_stale(request) ||
+      deepen_tiles == NULL || deepen_tiles->len == 0 ||
+      request->iterations > G_MAXINT/2)
+    return FALSE;
+
+  deepen_unresolved = 0;
+  deepen_escaped = render_stats.escaped;
+
+  for (i = 0; i < deepen_tiles->len; i++)
+  {
+    tile = g_ptr_array_index(deepen_tiles, i);
+    tile->deepen = request->iterations;
+    memset(&tile->counters, 0, sizeof(tile->counters));
+    deepen_unresolved += tile->unresolved;
+  }
+
+  request->iterations *= 2;
+  g_atomic_int_set(&request->tiles_pending, deepen_tiles->len);
+
+  render_stats.iteration_limit = request->iterations;
+  render_stats.state_bytes = 0;
+  render_stats.finished = FALSE;
+
+  tiles = deepen_tiles;
+  deepen_tiles = g_ptr_array_new();
+  render_push_tiles(tiles);
+
+  if (render_flush_id == 0)
+    render_flush_id = g_timeout_add(16, render_flush, drawing_area);
+
+  return TRUE;
+}
+
+//Copies a finished tile or attractor batch onto the surface
+static void render_blit_tile(GtkWidget *drawing_area, RenderTile *tile)
+{
+  cairo_t *cr;
+  cairo_surface_t *image;
+  RenderRequest *request = tile->request;
+  GdkRectangle mirror;
+  int min_x;
+  int min_y;
+  int max_x;
+  int max_y;
+  int i;
+
+  cr = cairo_create (surface);
+
+  if (tile->pixels)
+  {
+    image = cairo_image_surface_create_for_data((unsigned char *)tile->pixels,
+                                                CAIRO_FORMAT_RGB24,
+                                                tile->width, tile->height,
+                                                tile->width*4);
+    cairo_set_source_surface (cr, image, tile->x, tile->y);
+    cairo_rectangle (cr, tile->x, tile->y, tile->width, tile->height);
+    cairo_fill (cr);
+
+    gtk_widget_queue_draw_area(drawing_area, tile->x, tile->y,
+                               tile->width, tile->height);
+
+    //Copy the tile, flipped, to where its mirror image belongs
+    if (render_tile_mirror_rect(tile, &mirror))
+    {
+      cairo_save (cr);
+      cairo_rectangle (cr, mirror.x, mirror.y, mirror.width, mirror.height);
+      cairo_clip (cr);
+
+      if (request->mirror_x >= 0)
+      {
+        cairo_translate (cr, request->mirror_x + 1, request->mirror_y + 1);
+        cairo_scale (cr, -1, -1);
+      }
+      else
+      {
+        cairo_translate (cr, 0, request->mirror_y + 1);
+        cairo_scale (cr, 1, -1);
+      }
+
+      cairo_set_source_surface (cr, image, tile->x, tile->y);
+      cairo_pattern_set_filter (cairo_get_source (cr), CAIRO_FILTER_NEAREST);
+      cairo_paint (cr);
+      cairo_restore (cr);
+
+      gtk_widget_queue_draw_area(drawing_area, mirror.x, mirror.y,
+                                 mirror.width, mirror.height);
+    }
+
+    cairo_surface_destroy (image);
+  }
+
+  else if (tile->n_points > 0)
+  {
+    min_x = max_x = tile->points[0];
+    min_y = max_y = tile->points[1];
+
+    cairo_set_source_rgb (cr, 0, 0, 0);
+    cairo_set_line_width (cr, 0.5);
+    cairo_set_line_cap (cr, CAIRO_LINE_CAP_ROUND);
+
+    for (i = 0; i < tile->n_points; i++)
+    {
+      cairo_move_to (cr, tile->points[2*i], tile->points[2*i + 1]);
+      cairo_close_path (cr);
+
+      min_x = MIN(min_x, tile->points[2*i]);
+      max_x = MAX(max_x, tile->points[2*i]);
+      min_y = MIN(min_y, tile->points[2*i + 1]);
+      max_y = MAX(max_y, tile->points[2*i + 1]);
+    }
+    cairo_stroke (cr);
+
+    gtk_widget_queue_draw_area(drawing_area, min_x - 1, min_y - 1,
+                               max_x - min_x + 2, max_y - min_y + 2);
+  }
+
+  cairo_destroy (cr);
+}
+
+//Timeout callback on the GTK thread: paints the tiles finished since the
+//last call. Tiles of retired requests are dropped unpainted.
+static gboolean render_flush(gpointer data)
+{
+  GtkWidget *drawing_area = data;
+  RenderTile *tile;
+  gboolean finished;
+  int blitted = 0;
+
+  trace_begin("render_flush");
+
+  //Read before draining: a tile is always queued before it is counted
+  finished = g_atomic_int_get(&current_request->tiles_pending) == 0;
+
+  while ((tile = g_async_queue_try_pop(render_results)) != NULL)
+  {
+    if (render_request_is_stale(tile->request))
+    {
+      render_tile_free(tile);
+      continue;
+    }
+
+    if (blitted++ == 0)
+      shm_output_begin();
+
+    trace_begin_tile("upload", tile->x, tile->y);
+    render_blit_tile(drawing_area, tile);
+    trace_end("upload");
+
+    if (startup_time)
+      startup_image = "first tile";
+
+    render_stats_add(tile);
+
+    //Tiles with orbits still going wait for the next deepening pass
+    if (tile->unresolved > 0)
+    {
+      g_ptr_array_add(deepen_tiles, tile);
+      render_stats.state_bytes += render_tile_state_bytes(tile);
+    }
+    else
+      render_tile_free(tile);
+  }
+
+  if (finished && render_auto_deepen && render_deepen_wanted() &&
+      render_deepen(drawing_area))
+    finished = FALSE;
+
+  if (finished)
+  {
+    render_stats.finished = TRUE;
+    render_stats.end_time = g_get_monotonic_time();
+  }
+
+  render_stats_show();
+
+  trace_end("render_flush");
+
+  if (finished || render_request_is_stale(current_request))
+    render_flush_id = 0;
+
+  if (blitted || finished)
+  {
+    if (blitted == 0)
+      shm_output_begin();
+    shm_output_end();
+  }
+
+  if (render_flush_id == 0)
+    return G_SOURCE_REMOVE;
+
+  return G_SOURCE_CONTINUE;
+}
+
+//Tracing
+
+//Monotonic clock in nanoseconds
+static gint64 trace_clock(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (gint64)ts.tv_sec*1000000000 + ts.tv_nsec;
+}
+
+//Ring buffer of the calling thread, registered on first use
+static TraceRing *trace_ring_get(void)
+{
+  TraceRing *ring;
+  gint index;
+
+  ring = g_private_get(&trace_ring_key);
+  if (ring)
+    return ring;
+
+  index = g_atomic_int_add(&trace_ring_count, 1);
+  if (index >= MAX_TRACE_THREADS)
+    return NULL;
+
+  ring = g_new0(TraceRing, 1);
+  ring->tid = index + 1;
+  ring->thread_name = index == 0 ? g_strdup("GTK")
+                                 : g_strdup_printf("render %d", index);
+  g_atomic_pointer_set(&trace_rings[index], ring);
+  g_private_set(&trace_ring_key, ring);
+
+  return ring;
+}
+
+//Records one event in the calling thread's ring. Costs a single test
+//when tracing is off.
+static inline void trace_event(const gchar *name, gchar phase,
+                               int arg_x, int arg_y)
+{
+  TraceRing *ring;
+  TraceEvent *event;
+
+  if (G_LIKELY(trace_file == NULL))
+    return;
+
+  ring = trace_ring_get();
+  if (ring == NULL)
+    return;
+
+  event = &ring->events[ring->head % TRACE_RING_SIZE];
+  event->name = name;
+  event->timestamp = trace_clock();
+  event->phase = phase;
+  event->arg_x = arg_x;
+  event->arg_y = arg_y;
+
+  ring->head++;
+}
+
+static inline void trace_begin(const gchar *name)
+{
+  trace_event(name, 'B', -1, -1);
+}
+
+static inline void trace_begin_tile(const gchar *name, int x, int y)
+{
+  trace_event(name, 'B', x, y);
+}
+
+static inline void trace_end(const gchar *name)
+{
+  trace_event(name, 'E', -1, -1);
+}
+
+//Turns tracing on when FRACTAL_TRACE names an output file. Called on the
+//GTK thread before the render threads start, so it gets ring 0.
+static void trace_init(void)
+{
+  trace_file = g_getenv("FRACTAL_TRACE");
+
+  if (trace_file == NULL || *trace_file == '\0')
+  {
+    trace_file = NULL;
+    return;
+  }
+
+  trace_start_time = trace_clock();
+  trace_ring_get();
+}
+
+//Writes all rings as Chrome trace-event JSON. Called after the render
+//threads have stopped.
+static void trace_write(void)
+{
+  GString *json;
+  GError *error = NULL;
+  TraceRing *ring;
+  TraceEvent *event;
+  guint64 first;
+  guint64 i;
+  gint count;
+  gint r;
+  gboolean comma = FALSE;
+
+  if (trace_file == NULL)
+    return;
+
+  json = g_string_new("{\"displayTimeUnit\": \"ms\", \"traceEvents\": [");
+
+  count = MIN(g_atomic_int_get(&trace_ring_count), MAX_TRACE_THREADS);
+
+  for (r = 0; r < count; r++)
+  {
+    ring = g_atomic_pointer_get(&trace_rings[r]);
+    if (ring == NULL)
+      continue;
+
+    g_string_append_printf(json,
+                           "%s\n{\"name\": \"thread_name\", \"ph\": \"M\", "
+                           "\"pid\": 1, \"tid\": %d, "
+                           "\"args\": {\"name\": \"%s\"}}",
+                           comma ? "," : "", ring->tid, ring->thread_name);
+    comma = TRUE;
+
+    first = ring->head > TRACE_RING_SIZE ? ring->head - TRACE_RING_SIZE : 0;
+
+    for (i = first; i < ring->head; i++)
+    {
+      event = &ring->events[i % TRACE_RING_SIZE];
+
+      g_string_append_printf(json,
+                             ",\n{\"name\": \"%s\", \"ph\": \"%c\", "
+                             "\"pid\": 1, \"tid\": %d, "
+                             "\"ts\": %" G_GINT64_FORMAT ".%03d",
+                             event->name, event->phase, ring->tid,
+                             (event->timestamp - trace_start_time)/1000,
+                             (int)((event->timestamp - trace_start_time)%1000));
+
+      if (event->arg_x >= 0)
+        g_string_append_printf(json, ", \"args\": {\"x\": %d, \"y\": %d}",
+                               event->arg_x, event->arg_y);
+
+      g_string_append_c(json, '}');
+    }
+  }
+
+  g_string_append(json, "\n]}\n");
+
+  if (!g_file_set_contents(trace_file, json->str, json->len, &error))
+  {
+    g_warning("Could not write trace %s: %s", trace_file, error->message);
+    g_error_free(error);
+  }
+
+  g_string_free(json, TRUE);
+}
+
+//Render statistics
+
+//Small index identifying the calling render thread, used to add up the
+//busy time of each thread
+static int render_thread_slot(void)
+{
+  gint slot;
+
+  slot = GPOINTER_TO_INT(g_private_get(&render_thread_key));
+
+  if (slot == 0)
+  {
+    slot = g_atomic_int_add(&render_threads_seen, 1) + 1;
+    g_private_set(&render_thread_key, GINT_TO_POINTER(slot));
+  }
+
+  return (slot - 1) % MAX_RENDER_THREADS;
+}
+
+//CPU time used by the calling thread, in microseconds
+static gint64 render_thread_cpu_time(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+
+  return (gint64)ts.tv_sec*G_USEC_PER_SEC + ts.tv_nsec/1000;
+}
+
+static void render_tile_start_clock(RenderTile *tile)
+{
+  tile->counters.thread = render_thread_slot();
+  tile->counters.wall_time = g_get_monotonic_time();
+  tile->counters.cpu_time = render_thread_cpu_time();
+}
+
+static void render_tile_stop_clock(RenderTile *tile)
+{
+  tile->counters.wall_time = g_get_monotonic_time() - tile->counters.wall_time;
+  tile->counters.cpu_time = render_thread_cpu_time() - tile->counters.cpu_time;
+}
+
+//Starts a new batch of attractor points on the calling render thread
+static RenderTile *orbit_batch_new(RenderRequest *request)
+{
+  RenderTile *batch;
+
+  batch = render_tile_new(request, 0, 0, 0, 0);
+  trace_begin("batch");
+  render_tile_start_clock(batch);
+
+  return batch;
+}
+
+//Hands a batch of attractor points over to the GTK thread
+static void orbit_deliver(RenderTile *batch)
+{
+  render_tile_stop_clock(batch);
+  trace_end("batch");
+
+  batch->counters.iterations = batch->n_points;
+
+  g_async_queue_push(render_request_results(batch->request), batch);
+}
+
+//Bookkeeping for one pixel of an escape-time fractal. escaped_at is the
+//iteration at which |z| first reached 2, or 0 for interior pixels.
+static inline void render_count_pixel(RenderCounters *counters, int iterations,
+                                      int escaped_at)
+{
+  counters->iterations += iterations;
+
+  if (escaped_at == 0)
+  {
+    counters->interior++;
+  }
+
+  else
+  {
+    counters->escaped++;
+    counters->histogram[(escaped_at - 1)*HISTOGRAM_BINS/MAX_ITERATIONS]++;
+  }
+}
+
+//Starts the statistics for a new request
+static void render_stats_reset(RenderRequest *request, int tiles_total)
+{
+  GArray *tiles = render_stats.tiles;
+  const RenderKernel *kernel;
+
+  if (tiles == NULL)
+    tiles = g_array_new(FALSE, FALSE, sizeof(RenderTileRecord));
+  g_array_set_size(tiles, 0);
+  g_free(render_stats.formula);
+
+  memset(&render_stats, 0, sizeof(render_stats));
+  render_stats.tiles = tiles;
+  render_stats.type = request->type;
+  render_stats.width = request->width;
+  render_stats.height = request->height;
+  render_stats.parameter_a = request->parameter_a;
+  render_stats.parameter_b = request->parameter_b;
+  if (request->formula)
+    render_stats.formula = g_strdup(request->formula->text);
+  kernel = render_distance_kernel(request);
+  if (kernel == NULL)
+    kernel = render_kernel(request->type, request->precision, request->simd);
+  if (kernel)
+  {
+    render_stats.kernel = request->inverse ? "inverse iteration"
+                                           : kernel->name;
+    render_stats.zoom = view_zoom;
+  }
+  else if (request->type == FRACTAL_LORENZ_3D)
+  {
+    render_stats.kernel = "rasterizer";
+    render_stats.zoom = 1.0;
+  }
+  render_stats.threads = g_thread_pool_get_max_threads(render_pool);
+  render_stats.tiles_total = tiles_total;
+  render_stats.iteration_limit = request->iterations;
+  render_stats.start_time = g_get_monotonic_time();
+}
+
+//Adds the counters of a finished tile to the current render
+static void render_stats_add(RenderTile *tile)
+{
+  RenderCounters *counters = &tile->counters;
+  RenderTileRecord record;
+  GdkRectangle mirror;
+  int i;
+
+  render_stats.cpu_time += counters->cpu_time;
+  render_stats.iterations += counters->iterations;
+  render_stats.interior += counters->interior;
+  render_stats.escaped += counters->escaped;
+  render_stats.samples += counters->samples;
+  render_stats.busy_time[counters->thread] += counters->wall_time;
+
+  for (i = 0; i < HISTOGRAM_BINS; i++)
+    render_stats.histogram[i] += counters->histogram[i];
+
+  //A deepening pass only turns interior pixels into escaped ones
+  if (tile->deepen)
+  {
+    render_stats.interior -= counters->escaped;
+    return;
+  }
+
+  if (tile->pixels)
+    render_stats.pixels += tile->width*tile->height;
+  else
+    render_stats.points += tile->n_points;
+
+  if (render_tile_mirror_rect(tile, &mirror))
+    render_stats.mirrored_pixels += mirror.width*mirror.height;
+
+  record.x = tile->x;
+  record.y = tile->y;
+  record.width = tile->width;
+  record.height = tile->height;
+  record.thread = counters->thread;
+  record.wall_time = counters->wall_time;
+  record.cpu_time = counters->cpu_time;
+  record.iterations = counters->iterations;
+  g_array_append_val(render_stats.tiles, record);
+}
+
+//Wall time of the current render so far, in seconds
+static gdouble render_stats_wall_time(void)
+{
+  gint64 end;
+
+  if (render_stats.finished || render_stats.stopped)
+    end = render_stats.end_time;
+  else
+    end = g_get_monotonic_time();
+
+  return (end - render_stats.start_time)/(gdouble)G_USEC_PER_SEC;
+}
+
+//Fraction of the available thread time the render threads were busy
+static gdouble render_stats_utilization(void)
+{
+  gint64 busy = 0;
+  gdouble wall;
+  int i;
+
+  for (i = 0; i < MAX_RENDER_THREADS; i++)
+    busy += render_stats.busy_time[i];
+
+  wall = render_stats_wall_time();
+  if (wall <= 0.0 || render_stats.threads == 0)
+    return 0.0;
+
+  return busy/(G_USEC_PER_SEC*wall*render_stats.threads);
+}
+
+//Puts a summary of the current render into the status bar
+static void render_stats_show(void)
+{
+  gchar *text;
+  gchar *kept;
+  const gchar *state;
+  gdouble wall;
+  guint context;
+
+  if (status_bar == NULL || render_stats.tiles == NULL)
+    return;
+
+  wall = render_stats_wall_time();
+
+  if (render_stats.finished)
+    state = "";
+  else if (render_stats.stopped)
+    state = " (stopped)";
+  else
+    state = " (rendering)";
+
+  if (render_stats.pixels > 0)
+  {
+    text = g_strdup_printf("%s (%s) zoom %.3Lg, %d iterations%s: "
+                           "%.2f s wall, %.2f s CPU, "
+                           "%.1f M iterations, %.2f Mpixel/s, "
+                           "%.2f samples/pixel, %.1f%% interior, "
+                           "%d threads %.0f%% busy",
+                           fractal_names[render_stats.type],
+                           render_stats.kernel, render_stats.zoom,
+                           render_stats.iteration_limit, state, wall,
+                           render_stats.cpu_time/(gdouble)G_USEC_PER_SEC,
+                           render_stats.iterations/1e6,
+                           wall > 0.0 ? (render_stats.pixels +
+                                         render_stats.mirrored_pixels)/
+                                        wall/1e6 : 0.0,
+                           1.0 + (gdouble)render_stats.samples/
+                                 render_stats.pixels,
+                           100.0*render_stats.interior/
+                           (render_stats.pixels + render_stats.samples),
+                           render_stats.threads,
+                           100.0*render_stats_utilization());
+  }
+
+  else
+  {
+    text = g_strdup_printf("%s%s: %.2f s wall, %.2f s CPU, "
+                           "%" G_GINT64_FORMAT " points, %.0f points/s",
+                           fractal_names[render_stats.type], state,
+                           wall,
+                           render_stats.cpu_time/(gdouble)G_USEC_PER_SEC,
+                           render_stats.points,
+                           wall > 0.0 ? render_stats.points/wall : 0.0);
+  }
+
+  //Memory held for iteration deepening, per pixel of the image
+  if (render_stats.state_bytes > 0)
+  {
+    kept = text;
+    text = g_strdup_printf("%s, %.1f MB kept (%.1f bytes/pixel)", kept,
+                           render_stats.state_bytes/1e6,
+                           (gdouble)render_stats.state_bytes/
+                           (render_stats.width*render_stats.height));
+    g_free(kept);
+  }
+
+  context = gtk_statusbar_get_context_id(GTK_STATUSBAR(status_bar), "render");
+  gtk_statusbar_remove_all(GTK_STATUSBAR(status_bar), context);
+  gtk_statusbar_push(GTK_STATUSBAR(status_bar), context, text);
+
+  g_free(text);
+}
+
+//Appends "key": "value" with the JSON escapes
+static void json_append_string(GString *json, const gchar *key,
+                               const gchar *value)
+{
+  const gchar *p;
+
+  g_string_append_printf(json, "  \"%s\": \"", key);
+
+  for (p = value; *p; p++)
+  {
+    if (*p == '"' || *p == '\\')
+      g_string_append_printf(json, "\\%c", *p);
+    else if ((guchar)*p < 0x20)
+      g_string_append_printf(json, "\\u%04x", *p);
+    else
+      g_string_append_c(json, *p);
+  }
+
+  g_string_append(json, "\",\n");
+}
+
+//Appends "key": value for a double, independent of the current locale
+static void json_append_double(GString *json, const gchar *key, gdouble value)
+{
+  gchar buffer[G_ASCII_DTOSTR_BUF_SIZE];
+
+  g_string_append_printf(json, "  \"%s\": %s,\n", key,
+                         g_ascii_formatd(buffer, sizeof(buffer), "%.9g",
+                                         value));
+}
+
+//Statistics of the current (or last) render as a JSON document
+static gchar *render_stats_to_json(void)
+{
+  GString *json;
+  RenderTileRecord *record;
+  gchar buffer[G_ASCII_DTOSTR_BUF_SIZE];
+  gdouble wall;
+  guint i;
+
+  wall = render_stats_wall_time();
+
+  json = g_string_new("{\n");
+  g_string_append_printf(json, "  \"fractal\": \"%s\",\n",
+                         fractal_names[render_stats.type]);
+  g_string_append_printf(json, "  \"width\": %d,\n", render_stats.width);
+  g_string_append_printf(json, "  \"height\": %d,\n", render_stats.height);
+  json_append_double(json, "parameter_a", render_stats.parameter_a);
+  json_append_double(json, "parameter_b", render_stats.parameter_b);
+  if (render_stats.formula)
+    json_append_string(json, "formula", render_stats.formula);
+  if (render_stats.kernel)
+  {
+    json_append_string(json, "kernel", render_stats.kernel);
+    json_append_double(json, "zoom", render_stats.zoom);
+  }
+  g_string_append_printf(json, "  \"finished\": %s,\n",
+                         render_stats.finished ? "true" : "false");
+  json_append_double(json, "wall_time_s", wall);
+  json_append_double(json, "cpu_time_s",
+                     render_stats.cpu_time/(gdouble)G_USEC_PER_SEC);
+  g_string_append_printf(json, "  \"iterations\": %" G_GINT64_FORMAT ",\n",
+                         render_stats.iterations);
+  g_string_append_printf(json, "  \"pixels\": %" G_GINT64_FORMAT ",\n",
+                         render_stats.pixels);
+  g_string_append_printf(json, "  \"mirrored_pixels\": %" G_GINT64_FORMAT
+                         ",\n", render_stats.mirrored_pixels);
+  g_string_append_printf(json, "  \"points\": %" G_GINT64_FORMAT ",\n",
+                         render_stats.points);
+  g_string_append_printf(json, "  \"antialias_samples\": %" G_GINT64_FORMAT
+                         ",\n", render_stats.samples);
+  json_append_double(json, "pixels_per_s",
+                     wall > 0.0 ? (render_stats.pixels +
+                                   render_stats.mirrored_pixels)/wall : 0.0);
+  g_string_append_printf(json, "  \"interior\": %" G_GINT64_FORMAT ",\n",
+                         render_stats.interior);
+  g_string_append_printf(json, "  \"escaped\": %" G_GINT64_FORMAT ",\n",
+                         render_stats.escaped);
+  json_append_double(json, "interior_fraction",
+                     render_stats.pixels > 0 ?
+                     render_stats.interior/(gdouble)(render_stats.pixels +
+                                                     render_stats.samples) :
+                     0.0);
+
+  g_string_append_printf(json, "  \"bailout_histogram\": {\n"
+                         "    \"bin_width\": %d,\n    \"counts\": [",
+                         MAX_ITERATIONS/HISTOGRAM_BINS);
+  for (i = 0; i < HISTOGRAM_BINS; i++)
+    g_string_append_printf(json, "%s%" G_GINT64_FORMAT, i ? ", " : "",
+                           render_stats.histogram[i]);
+  g_string_append(json, "]\n  },\n");
+
+  g_string_append_printf(json, "  \"threads\": %d,\n", render_stats.threads);
+  json_append_double(json, "thread_utilization", render_stats_utilization());
+  g_string_append(json, "  \"thread_busy_s\": [");
+  for (i = 0; i < (guint)MIN(render_stats.threads, MAX_RENDER_THREADS); i++)
+    g_string_append_printf(json, "%s%s", i ? ", " : "",
+                           g_ascii_formatd(buffer, sizeof(buffer), "%.6f",
+                                           render_stats.busy_time[i]/
+                                           (gdouble)G_USEC_PER_SEC));
+  g_string_append(json, "],\n");
+
+  g_string_append(json, "  \"tiles\": [");
+  for (i = 0; i < render_stats.tiles->len; i++)
+  {
+    record = &g_array_index(render_stats.tiles, RenderTileRecord, i);
+    g_string_append_printf(json,
+                           "%s\n    {\"x\": %d, \"y\": %d, \"width\": %d, "
+                           "\"height\": %d, \"thread\": %d, "
+                           "\"wall_time_us\": %" G_GINT64_FORMAT ", "
+                           "\"cpu_time_us\": %" G_GINT64_FORMAT ", "
+                           "\"iterations\": %" G_GINT64_FORMAT "}",
+                           i ? "," : "", record->x, record->y,
+                           record->width, record->height, record->thread,
+                           record->wall_time, record->cpu_time,
+                           record->iterations);
+  }
+  g_string_append(json, "\n  ]\n}\n");
+
+  return g_string_free(json, FALSE);
+}
+
+//Writes the statistics of the last render next to a saved image, as
+//image.json for image.png
+static void save_render_stats(const gchar *image_filename)
+{
+  gchar *json;
+  gchar *json_filename;
+  const gchar *extension;
+  GError *error = NULL;
+
+  if (render_stats.tiles == NULL)
+    return;
+
+  extension = strrchr(image_filename, '.');
+  if (extension && strchr(extension, G_DIR_SEPARATOR) == NULL)
+    json_filename = g_strdup_printf("%.*s.json",
+                                    (int)(extension - image_filename),
+                                    image_filename);
+  else
+    json_filename = g_strconcat(image_filename, ".json", NULL);
+
+  json = render_stats_to_json();
+
+  if (!g_file_set_contents(json_filename, json, -1, &error))
+  {
+    g_warning("Could not write %s: %s", json_filename, error->message);
+    g_error_free(error);
+  }
+
+  g_free(json);
+  g_free(json_filename);
+}
+
+//Generates Henon map
+static void henon(RenderRequest *request)
+{
+  RenderTile *batch;
+
+  int width;
+  int height;
+  long double x;
+  long double y;
+  long double init_x;
+  long double init_y;
+  long double x_new;
+  long double y_new;
+  long double a;
+  long double b;
+  long double d_screen_x;
+  long double d_screen_y;
+  int screen_x;
+  int screen_y;
+  int counter;
+  int max_count;
+
+  counter = 0;
+  max_count = 40000;
+
+  width = request->width;
+  height = request->height;
+
+  init_x = 0.1;
+  init_y = 0.1;
+
+  //a = 1.4;
+  //b = 0.3;
+
+  a = request->parameter_a;
+  b = request->parameter_b;
+
+  x = init_x;
+  y = init_y;
+
+  batch = orbit_batch_new(request);
+
+  while (counter < max_count)
+  {
+    x_new = 1 - a*x*x + y;
+    y_new = b*x;
+
+    x = x_new;
+    y = y_new;
+
+    //x = ((long double)screen_x/(1000/6.67)) - 3.335;
+    d_screen_x = ((x + 3.335)*(width/6.67));
+    screen_x = (int)d_screen_x;
+
+    //y = -(((long double)screen_y/(600/4)) - 2.0);
+    d_screen_y = ((-y + 2.0)*height/4);
+    screen_y = (int)d_screen_y;
+
+    if (!orbit_plot(&batch, screen_x, screen_y))
+      break;
+
+    counter++;
+  }
+
+  orbit_deliver(batch);
+}
+
+//Generates lorenz_xy attractor and displays in 2D
+
+/*
+Equations and code borrowed from Paul Bourke
+http://paulbourke.net/fractals/lorenz_xy/
+
+3 coupled non-linear differential equations
+
+dx / dt = a (y - x)
+dy / dt = x (b - z) - y
+dz / dt = xy - c z
+
+One commonly used set of constants is a = 10, b = 28, c = 8 / 3.
+Another is a = 28, b = 46.92, c = 4.
+"a" is sometimes known as the Prandtl number and "b" the Rayleigh number.
+
+*/
+
+static void lorenz_xy(RenderRequest *request)
+{
+  RenderTile *batch;
+
+  long double x;
+  long double y;
+  long double z;
+  long double init_x;
+  long double init_y;
+  long double init_z;
+  long double x_new;
+  long double y_new;
+  long double z_new;
+  long double d_screen_x;
+  long double d_screen_y;
+  int screen_x;
+  int screen_y;
+  int counter;
+  int max_count;
+
+  long double h = 0.01;
+  long double a = 10.0;
+  long double b = 28.0;
+  long double c = 8.0 / 3.0;
+
+  counter = 0;
+  max_count = 400000;
+
+  init_x = 0.1;
+  init_y = 0.0;
+  init_z = 0.0;
+
+  x = init_x;
+  y = init_y;
+  z = init_z;
+
+  batch = orbit_batch_new(request);
+
+  while (counter < max_count)
+  {
+    x_new = x + h * a * (y - x);
+    y_new = y + h * (x * (b - z) - y);
+    z_new = z + h * (x * y - c * z);
+
+    x = x_new;
+    y = y_new;
+    z = z_new;
+
+    //x = (screen_x/(1000/5) - 2.5);
+    //d_screen_x = (x + 2.5)*(width/5);
+
+    //x = d_screen_x/10 - 50.0
+    d_screen_x = (x + 50.0)*10;
+    screen_x = (int)d_screen_x;
+
+    //y = -(d_screen_y/(600/3) - 1.5);
+    //d_screen_y = (-y + 1.5)*(height/3);
+
+    //y = -(d_screen_y/6 - 50.0);
+    d_screen_y = (-y + 50.0)*6;
+    screen_y = (int)d_screen_y;
+
+    if (!orbit_plot(&batch, screen_x, screen_y))
+      break;
+
+    counter++;
+  }
+
+  orbit_deliver(batch);
+}
+
+static void lorenz_yz(RenderRequest *request)
+{
+  RenderTile *batch;
+
+  long double x;
+  long double y;
+  long double z;
+  long double init_x;
+  long double init_y;
+  long double init_z;
+  long double x_new;
+  long double y_new;
+  long double z_new;
+  long double d_screen_y;
+  long double d_screen_z;
+  int screen_y;
+  int screen_z;
+  int counter;
+  int max_count;
+
+  long double h = 0.01;
+  long double a = 10.0;
+  long double b = 28.0;
+  long double c = 8.0 / 3.0;
+
+  counter = 0;
+  max_count = 100000;
+
+  init_x = 0.1;
+  init_y = 0.0;
+  init_z = 0.0;
+
+  x = init_x;
+  y = init_y;
+  z = init_z;
+
+  batch = orbit_batch_new(request);
+
+  while (counter < max_count)
+  {
+    x_new = x + h * a * (y - x);
+    y_new = y + h * (x * (b - z) - y);
+    z_new = z + h * (x * y - c * z);
+
+    x = x_new;
+    y = y_new;
+    z = z_new;
+
+    //x = (screen_x/(1000/5) - 2.5);
+    //d_screen_x = (x + 2.5)*(width/5);
+
+    //x = d_screen_x/10 - 50.0
+    d_screen_y = (y + 50.0)*10;
+    screen_y = (int)d_screen_y;
+
+    //y = -(d_screen_y/(600/3) - 1.5);
+    //d_screen_y = (-y + 1.5)*(height/3);
+
+    //y = -(d_screen_y/6 - 50.0);
+    d_screen_z = (-z + 50.0)*6;
+    screen_z = (int)d_screen_z;
+
+    if (!orbit_plot(&batch, screen_y, screen_z))
+      break;
+
+    counter++;
+  }
+
+  orbit_deliver(batch);
+}
+
+static void lorenz_xz(RenderRequest *request)
+{
+  RenderTile *batch;
+
+  long double x;
+  long double y;
+  long double z;
+  long double init_x;
+  long double init_y;
+  long double init_z;
+  long double x_new;
+  long double y_new;
+  long double z_new;
+  long double d_screen_x;
+  long double d_screen_z;
+  int screen_x;
+  int screen_z;
+  int counter;
+  int max_count;
+
+  long double h = 0.01;
+  long double a = 10.0;
+  long double b = 28.0;
+  long double c = 8.0 / 3.0;
+
+  counter = 0;
+  max_count = 100000;
+
+  init_x = 0.1;
+  init_y = 0.0;
+  init_z = 0.0;
+
+  x = init_x;
+  y = init_y;
+  z = init_z;
+
+  batch = orbit_batch_new(request);
+
+  while (counter < max_count)
+  {
+    x_new = x + h * a * (y - x);
+    y_new = y + h * (x * (b - z) - y);
+    z_new = z + h * (x * y - c * z);
+
+    x = x_new;
+    y = y_new;
+    z = z_new;
+
+    //x = (screen_x/(1000/5) - 2.5);
+    //d_screen_x = (x + 2.5)*(width/5);
+
+    //x = d_screen_x/10 - 50.0
+    d_screen_x = (x + 50.0)*10;
+    screen_x = (int)d_screen_x;
+
+    //y = -(d_screen_y/(600/3) - 1.5);
+    //d_screen_y = (-y + 1.5)*(height/3);
+
+    //y = -(d_screen_y/6 - 50.0);
+    d_screen_z = (-z + 50.0)*6;
+    screen_z = (int)d_screen_z;
+
+    if (!orbit_plot(&batch, screen_x, screen_z))
+      break;
+
+    counter++;
+  }
+
+  orbit_deliver(batch);
+}
+
+//Integrates the Lorenz system as lorenz_xy() does and keeps the points
+//for the 3D view. Only done once: the equations have fixed constants.
+static void lorenz_3d_vertices(void)
+{
+  double x = 0.1;
+  double y = 0.0;
+  double z = 0.0;
+  double x_new;
+  double y_new;
+  double z_new;
+  double h = 0.01;
+  double a = 10.0;
+  double b = 28.0;
+  double c = 8.0 / 3.0;
+  int i;
+
+  if (lorenz_vertices)
+    return;
+
+  lorenz_vertices = g_new(float, 3*LORENZ_3D_STEPS);
+
+  for (i = 0; i < LORENZ_3D_STEPS; i++)
+  {
+    x_new = x + h * a * (y - x);
+    y_new = y + h * (x * (b - z) - y);
+    z_new = z + h * (x * y - c * z);
+
+    x = x_new;
+    y = y_new;
+    z = z_new;
+
+    lorenz_vertices[3*i] = x;
+    lorenz_vertices[3*i + 1] = y;
+    lorenz_vertices[3*i + 2] = z - LORENZ_3D_CENTER_Z;
+  }
+
+  lorenz_vertex_count = LORENZ_3D_STEPS;
+}
+
+//Rotation of the 3D Lorenz view: turned by the yaw around the z axis of
+//the attractor, then tilted by the pitch around the image x axis
+static void lorenz_3d_rotation(RenderRequest *request)
+{
+  double *m = request->rotation;
+  double cy = cos(lorenz_yaw);
+  double sy = sin(lorenz_yaw);
+  double cp = cos(lorenz_pitch);
+  double sp = sin(lorenz_pitch);
+
+  m[0] = cy;
+  m[1] = -sy;
+  m[2] = 0;
+  m[3] = cp*sy;
+  m[4] = cp*cy;
+  m[5] = -sp;
+  m[6] = sp*sy;
+  m[7] = sp*cy;
+  m[8] = cp;
+}
+
+//Prepares a request of the 3D Lorenz view for bands of band rows, with
+//one slice of the vertices to project per band
+static void lorenz_3d_setup(RenderRequest *request, int band)
+{
+  lorenz_3d_vertices();
+
+  request->lorenz_band = band;
+  request->lorenz_bands = (request->height + band - 1)/band;
+  request->lorenz_slices = request->lorenz_bands;
+  request->lorenz_slice = (lorenz_vertex_count + request->lorenz_slices - 1)/
+                          request->lorenz_slices;
+  request->lorenz_points = g_new(LorenzPoint, lorenz_vertex_count);
+  request->lorenz_band_start = g_new0(int, request->lorenz_slices*
+                                           (request->lorenz_bands + 1));
+}
+
+//Projects a slice of the vertices of the 3D Lorenz view and sorts the
+//points landing in the image by band, keeping their order within a band.
+//Each point adds light to its pixel, between LORENZ_3D_FAR at the back
+//and LORENZ_3D_NEAR at the front. Returns the number of vertices.
+static int lorenz_3d_project(RenderRequest *request, int slice)
+{
+  const double *m = request->rotation;
+  const float *v;
+  double scale = request->height/LORENZ_3D_SIZE;
+  double center_x = request->width/2.0;
+  double center_y = request->height/2.0;
+  double light_scale = (LORENZ_3D_NEAR - LORENZ_3D_FAR)/LORENZ_3D_SIZE;
+  double light_mid = (LORENZ_3D_NEAR + LORENZ_3D_FAR)/2;
+  double screen_x;
+  double screen_y;
+  double light;
+  LorenzPoint *points;
+  int *point_band;
+  int *start;
+  int first = slice*request->lorenz_slice;
+  int last = MIN(first + request->lorenz_slice, lorenz_vertex_count);
+  int count = 0;
+  int i;
+
+  points = g_new(LorenzPoint, MAX(last - first, 0));
+  point_band = g_new(int, MAX(last - first, 0));
+  start = request->lorenz_band_start + slice*(request->lorenz_bands + 1);
+  v = lorenz_vertices + 3*first;
+
+  for (i = first; i < last; i++, v += 3)
+  {
+    screen_y = center_y - scale*(m[3]*v[0] + m[4]*v[1] + m[5]*v[2]);
+    if (screen_y < 0 || screen_y >= request->height)
+      continue;
+
+    screen_x = center_x + scale*(m[0]*v[0] + m[1]*v[1] + m[2]*v[2]);
+    if (screen_x < 0 || screen_x >= request->width)
+      continue;
+
+    light = light_mid + light_scale*(m[6]*v[0] + m[7]*v[1] + m[8]*v[2]);
+    points[count].pixel = (int)screen_y*request->width + (int)screen_x;
+    points[count].light = CLAMP(light, LORENZ_3D_FAR, LORENZ_3D_NEAR);
+    point_band[count] = (int)screen_y/request->lorenz_band;
+    start[point_band[count] + 1]++;
+    count++;
+  }
+
+  //Counting sort into the slice's part of lorenz_points: start[b] becomes
+  //where band b begins, and moves along as its points go in
+  start[0] = first;
+  for (i = 1; i <= request->lorenz_bands; i++)
+    start[i] += start[i - 1];
+
+  for (i = 0; i < count; i++)
+    request->lorenz_points[start[point_band[i]]++] = points[i];
+
+  //The scatter left start[b] at the end of band b, which is where band
+  //b + 1 begins
+  for (i = request->lorenz_bands; i > 0; i--)
+    start[i] = start[i - 1];
+  start[0] = first;
+
+  g_free(points);
+  g_free(point_band);
+
+  return MAX(last - first, 0);
+}
+
+//Draws the band of the 3D Lorenz view a tile covers. The tile first
+//projects the slices of the vertices no other band has claimed, then
+//waits for those still being projected, which are already running, so
+//the wait is short and cannot deadlock. The light of the points in the
+//band is summed per pixel, slice by slice so in the order of the
+//trajectory, and the sums are mapped to colors from black through red
+//and yellow to white.
+static void lorenz_3d_band(RenderTile *tile)
+{
+  RenderRequest *request = tile->request;
+  const LorenzPoint *point;
+  const LorenzPoint *end;
+  const int *start;
+  int b = tile->y/request->lorenz_band;
+  int first = tile->y*tile->width;
+  int slice;
+  double light;
+  float *sum;
+  int i;
+
+  while ((slice = g_atomic_int_add(&request->lorenz_next_slice, 1)) <
+         request->lorenz_slices)
+  {
+    tile->counters.iterations += lorenz_3d_project(request, slice);
+    g_atomic_int_inc(&request->lorenz_slices_done);
+  }
+
+  while (g_atomic_int_get(&request->lorenz_slices_done) <
+         request->lorenz_slices)
+    g_thread_yield();
+
+  sum = g_new0(float, tile->width*tile->height);
+
+  for (slice = 0; slice < request->lorenz_slices; slice++)
+  {
+    start = request->lorenz_band_start + slice*(request->lorenz_bands + 1);
+    point = request->lorenz_points + start[b];
+    end = request->lorenz_points + start[b + 1];
+    for (; point < end; point++)
+      sum[point->pixel - first] += point->light;
+  }
+
+  for (i = 0; i < tile->width*tile->height; i++)
+  {
+    light = 1.0 - exp(-sum[i]);
+    tile->pixels[i] = (guint32)(255*light) << 16 |
+                      (guint32)(255*light*light) << 8 |
+                      (guint32)(255*light*light*light*light);
+
+    if (sum[i] > 0)
+      tile->counters.interior++;
+  }
+
+  g_free(sum);
+}
+
+//Vector math for the vector kernels. The functions work on SIMD_WIDTH
+//doubles at a time using GCC vector extensions, which compile to SSE2 or
+//AVX instructions depending on the target. They are always inlined, so
+//each kernel instantiation gets them for its own instruction set.
+//Vectors go in and out through pointers: passed or returned by value
+//they would take another ABI with AVX than without, which GCC warns
+//about (-Wpsabi) even though nothing crosses one.
+
+//Splits x into its nearest integer n (k, as a double) and the low bits
+//of n as an integer vector, valid for |x| < 2^51
+static VEC_INLINE void vec_round(const v4df *x, v4df *k, v4di *n)
+{
+  const v4df magic = {0x1.8p52, 0x1.8p52, 0x1.8p52, 0x1.8p52};
+  v4df t;
+
+  t = *x + magic;
+  *n = (v4di)t;
+  *k = t - magic;
+}
+
+//sin(x) and cos(x) together. Cody-Waite reduction by pi/2 and the Cephes
+//minimax polynomials on [-pi/4, pi/4]; the error is within a few ulp for
+//|x| < SINCOS_MAX_ARG. Lanes beyond that fall back to the libm functions,
+//which only happens on orbits that are about to escape anyway.
+static VEC_INLINE void vec_sincos(const v4df *arg, v4df *s, v4df *c)
+{
+  const v4df two_over_pi = {M_2_PI, M_2_PI, M_2_PI, M_2_PI};
+  const v4df dp1 = {1.57079625129699707031e+00, 1.57079625129699707031e+00,
+                    1.57079625129699707031e+00, 1.57079625129699707031e+00};
+  const v4df dp2 = {7.54978941586159635336e-08, 7.54978941586159635336e-08,
+                    7.54978941586159635336e-08, 7.54978941586159635336e-08};
+  const v4df dp3 = {5.39030285815811905290e-15, 5.39030285815811905290e-15,
+                    5.39030285815811905290e-15, 5.39030285815811905290e-15};
+  const v4di one = {1, 1, 1, 1};
+  const v4di two = {2, 2, 2, 2};
+  v4df x;
+  v4df q;
+  v4df r;
+  v4df z;
+  v4df ps;
+  v4df pc;
+  v4di n;
+  v4di swap;
+  int i;
+
+  x = *arg;
+  z = x*two_over_pi;
+  vec_round(&z, &q, &n);
+  r = ((x - q*dp1) - q*dp2) - q*dp3;
+  z = r*r;
+
+  ps = VEC4(1.58962301576546568060e-10);
+  ps = ps*z - 2.50507477628578072866e-8;
+  ps = ps*z + 2.75573136213857245213e-6;
+  ps = ps*z - 1.98412698295895385996e-4;
+  ps = ps*z + 8.33333333332211858878e-3;
+  ps = ps*z - 1.66666666666666307295e-1;
+  ps = r + r*z*ps;
+
+  pc = VEC4(-1.13585365213876817300e-11);
+  pc = pc*z + 2.08757008419747316778e-9;
+  pc = pc*z - 2.75573141792967388112e-7;
+  pc = pc*z + 2.48015872888517045348e-5;
+  pc = pc*z - 1.38888888888730564116e-3;
+  pc = pc*z + 4.16666666666665929218e-2;
+  pc = 1.0 - 0.5*z + z*z*pc;
+
+  //Quadrant n mod 4: swap sin and cos in odd quadrants, negate sin in
+  //quadrants 2 and 3 and cos in quadrants 1 and 2
+  swap = -(n & one);
+  *s = VEC_SELECT(swap, pc, ps);
+  *c = VEC_SELECT(swap, ps, pc);
+  *s = (v4df)((v4di)*s ^ ((n & two) << 62));
+  *c = (v4df)((v4di)*c ^ (((n + one) & two) << 62));
+
+  for (i = 0; i < SIMD_WIDTH; i++)
+  {
+    if (fabs(x[i]) > SINCOS_MAX_ARG || isnan(x[i]))
+    {
+      (*s)[i] = sin(x[i]);
+      (*c)[i] = cos(x[i]);
+    }
+  }
+}
+
+//exp(x) for 0 <= x <= 709: reduction by ln 2 and a degree 12
+//Taylor polynomial on [-ln2/2, ln2/2], good to about 2 ulp
+static VEC_INLINE void vec_exp(const v4df *arg, v4df *e)
+{
+  const v4df log2e = {M_LOG2E, M_LOG2E, M_LOG2E, M_LOG2E};
+  const v4df ln2_hi = {6.93147180369123816490e-01, 6.93147180369123816490e-01,
+                       6.93147180369123816490e-01, 6.93147180369123816490e-01};
+  const v4df ln2_lo = {1.90821492927058770002e-10, 1.90821492927058770002e-10,
+                       1.90821492927058770002e-10, 1.90821492927058770002e-10};
+  const v4di bias = {1023, 1023, 1023, 1023};
+  v4df x;
+  v4df k;
+  v4df r;
+  v4df p;
+  v4di n;
+
+  x = *arg;
+  r = x*log2e;
+  vec_round(&r, &k, &n);
+  r = (x - k*ln2_hi) - k*ln2_lo;
+
+  p = VEC4(1.0/479001600.0);
+  p = p*r + 1.0/39916800.0;
+  p = p*r + 1.0/3628800.0;
+  p = p*r + 1.0/362880.0;
+  p = p*r + 1.0/40320.0;
+  p = p*r + 1.0/5040.0;
+  p = p*r + 1.0/720.0;
+  p = p*r + 1.0/120.0;
+  p = p*r + 1.0/24.0;
+  p = p*r + 1.0/6.0;
+  p = p*r + 0.5;
+  p = p*r + 1.0;
+  p = p*r + 1.0;
+
+  //Multiply by 2^n by building the double directly
+  *e = p*(v4df)(((n & 0x7ff) + bias) << 52);
+}
+
+//cosh(y) and sinh(y) from a single exp(|y|). Below |y| = 0.5 sinh uses
+//its Taylor series, as e - 1/e would cancel.
+static VEC_INLINE void vec_coshsinh(const v4df *arg, v4df *ch, v4df *sh)
+{
+  const v4di sign = {1LL << 63, 1LL << 63, 1LL << 63, 1LL << 63};
+  v4df y;
+  v4df ay;
+  v4df e;
+  v4df ei;
+  v4df z;
+  v4df small;
+
+  y = *arg;
+  ay = VEC_ABS(y);
+  vec_exp(&ay, &e);
+  ei = 1.0/e;
+
+  *ch = 0.5*(e + ei);
+
+  z = ay*ay;
+  small = VEC4(1.0/39916800.0);
+  small = small*z + 1.0/362880.0;
+  small = small*z + 1.0/5040.0;
+  small = small*z + 1.0/120.0;
+  small = small*z + 1.0/6.0;
+  small = ay + ay*z*small;
+
+  *sh = VEC_SELECT(ay < 0.5, small, 0.5*(e - ei));
+  *sh = (v4df)((v4di)*sh | ((v4di)y & sign));
+}
+
+//User formulas
+
+//Number of stack entries an instruction consumes
+static int formula_operands(FormulaOp op)
+{
+  switch (op)
+  {
+    case FORMULA_OP_CONST:
+    case FORMULA_OP_Z:
+    case FORMULA_OP_C:
+      return 0;
+
+    case FORMULA_OP_ADD:
+    case FORMULA_OP_SUB:
+    case FORMULA_OP_MUL:
+    case FORMULA_OP_DIV:
+    case FORMULA_OP_POW:
+      return 2;
+
+    default:
+      return 1;
+  }
+}
+
+//Limits x to [-limit, limit], in place; NaN passes through
+static VEC_INLINE void vec_clamp(v4df *x, double limit)
+{
+  *x = VEC_SELECT(*x > limit, VEC4(limit), *x);
+  *x = VEC_SELECT(*x < -limit, VEC4(-limit), *x);
+}
+
+//e^z, in place
+static VEC_INLINE void formula_exp(v4df *re, v4df *im)
+{
+  v4df x;
+  v4df e;
+  v4df s;
+  v4df c;
+
+  x = *re;
+  vec_clamp(&x, FORMULA_EXP_MAX);
+  e = VEC_ABS(x);
+  vec_exp(&e, &e);
+  e = VEC_SELECT(x < 0.0, 1.0/e, e);
+  vec_sincos(im, &s, &c);
+
+  *re = e*c;
+  *im = e*s;
+}
+
+//Principal value of log z, in place. There is no vector log, so this one
+//goes through libm lane by lane.
+static VEC_INLINE void formula_log(v4df *re, v4df *im)
+{
+  double x;
+  double y;
+  int i;
+
+  for (i = 0; i < SIMD_WIDTH; i++)
+  {
+    x = (*re)[i];
+    y = (*im)[i];
+    (*re)[i] = log(hypot(x, y));
+    (*im)[i] = atan2(y, x);
+  }
+}
+
+//Runs a compiled formula on SIMD_WIDTH values of z and c at once. The
+//result is only stored at the end, so it may go over z.
+static VEC_INLINE void formula_run(const FormulaProgram *program,
+                                   const v4df *z_re, const v4df *z_im,
+                                   const v4df *c_re, const v4df *c_im,
+                                   v4df *re, v4df *im)
+{
+  v4df stack_re[FORMULA_MAX_STACK];
+  v4df stack_im[FORMULA_MAX_STACK];
+  const FormulaInstruction *instruction;
+  const FormulaInstruction *end;
+  v4df x;
+  v4df y;
+  v4df u;
+  v4df v;
+  v4df w;
+  v4df s;
+  v4df c;
+  v4df ch;
+  v4df sh;
+  int top = -1;
+  int n;
+
+  end = program->code + program->length;
+
+  for (instruction = program->code; instruction < end; instruction++)
+  {
+    //Binary operations combine x + iy (below) with u + iv (on top);
+    //unary ones work on x + iy
+    switch (instruction->op)
+    {
+      case FORMULA_OP_CONST:
+        top++;
+        stack_re[top] = VEC4(instruction->re);
+        stack_im[top] = VEC4(instruction->im);
+        break;
+
+      case FORMULA_OP_Z:
+        top++;
+        stack_re[top] = *z_re;
+        stack_im[top] = *z_im;
+        break;
+
+      case FORMULA_OP_C:
+        top++;
+        stack_re[top] = *c_re;
+        stack_im[top] = *c_im;
+        break;
+
+      case FORMULA_OP_ADD:
+        top--;
+        stack_re[top] += stack_re[top + 1];
+        stack_im[top] += stack_im[top + 1];
+        break;
+
+      case FORMULA_OP_SUB:
+        top--;
+        stack_re[top] -= stack_re[top + 1];
+        stack_im[top] -= stack_im[top + 1];
+        break;
+
+      case FORMULA_OP_MUL:
+        top--;
+        x = stack_re[top];
+        y = stack_im[top];
+        u = stack_re[top + 1];
+        v = stack_im[top + 1];
+        stack_re[top] = x*u - y*v;
+        stack_im[top] = x*v + y*u;
+        break;
+
+      case FORMULA_OP_DIV:
+        top--;
+        x = stack_re[top];
+        y = stack_im[top];
+        u = stack_re[top + 1];
+        v = stack_im[top + 1];
+        w = 1.0/(u*u + v*v);
+        stack_re[top] = (x*u + y*v)*w;
+        stack_im[top] = (y*u - x*v)*w;
+        break;
+
+      case FORMULA_OP_NEG:
+        stack_re[top] = -stack_re[top];
+        stack_im[top] = -stack_im[top];
+        break;
+
+      case FORMULA_OP_RECIP:
+        x = stack_re[top];
+        y = stack_im[top];
+        w = 1.0/(x*x + y*y);
+        stack_re[top] = x*w;
+        stack_im[top] = -y*w;
+        break;
+
+      case FORMULA_OP_SQR:
+        x = stack_re[top];
+        y = stack_im[top];
+        stack_re[top] = x*x - y*y;
+        stack_im[top] = 2.0*x*y;
+        break;
+
+      case FORMULA_OP_POWI:
+        //z^n by repeated squaring; n is fixed when the formula is compiled
+        x = stack_re[top];
+        y = stack_im[top];
+        u = VEC4(1.0);
+        v = VEC4(0.0);
+
+        for (n = instruction->n; n > 0; n >>= 1)
+        {
+          if (n & 1)
+          {
+            w = u*x - v*y;
+            v = u*y + v*x;
+            u = w;
+          }
+
+          if (n > 1)
+          {
+            w = x*x - y*y;
+            y = 2.0*x*y;
+            x = w;
+          }
+        }
+
+        stack_re[top] = u;
+        stack_im[top] = v;
+        break;
+
+      case FORMULA_OP_POW:
+        //z^w = exp(w log z)
+        top--;
+        x = stack_re[top];
+        y = stack_im[top];
+        u = stack_re[top + 1];
+        v = stack_im[top + 1];
+        formula_log(&x, &y);
+        w = x*u - y*v;
+        y = x*v + y*u;
+        formula_exp(&w, &y);
+        stack_re[top] = w;
+        stack_im[top] = y;
+        break;
+
+      case FORMULA_OP_CONJ:
+        stack_im[top] = -stack_im[top];
+        break;
+
+      case FORMULA_OP_EXP:
+        formula_exp(&stack_re[top], &stack_im[top]);
+        break;
+
+      case FORMULA_OP_LOG:
+        formula_log(&stack_re[top], &stack_im[top]);
+        break;
+
+      case FORMULA_OP_SIN:
+        vec_sincos(&stack_re[top], &s, &c);
+        w = stack_im[top];
+        vec_clamp(&w, FORMULA_EXP_MAX);
+        vec_coshsinh(&w, &ch, &sh);
+        stack_re[top] = s*ch;
+        stack_im[top] = c*sh;
+        break;
+
+      case FORMULA_OP_COS:
+        vec_sincos(&stack_re[top], &s, &c);
+        w = stack_im[top];
+        vec_clamp(&w, FORMULA_EXP_MAX);
+        vec_coshsinh(&w, &ch, &sh);
+        stack_re[top] = c*ch;
+        stack_im[top] = -s*sh;
+        break;
+
+      case FORMULA_OP_SINH:
+        w = stack_re[top];
+        vec_clamp(&w, FORMULA_EXP_MAX);
+        vec_coshsinh(&w, &ch, &sh);
+        vec_sincos(&stack_im[top], &s, &c);
+        stack_re[top] = sh*c;
+        stack_im[top] = ch*s;
+        break;
+
+      case FORMULA_OP_COSH:
+        w = stack_re[top];
+        vec_clamp(&w, FORMULA_EXP_MAX);
+        vec_coshsinh(&w, &ch, &sh);
+        vec_sincos(&stack_im[top], &s, &c);
+        stack_re[top] = ch*c;
+        stack_im[top] = sh*s;
+        break;
+    }
+  }
+
+  *re = stack_re[0];
+  *im = stack_im[0];
+}
+
+//Sets a parse error pointing at the current position
+static gboolean formula_error(FormulaParser *parser, GError **error,
+                              const gchar *format, ...)
+{
+  va_list args;
+  gchar *message;
+
+  va_start(args, format);
+  message = g_strdup_vprintf(format, args);
+  va_end(args);
+
+  g_set_error(error, FORMULA_ERROR, 0, "%s at position %d", message,
+              (int)(parser->pos - parser->text) + 1);
+  g_free(message);
+
+  return FALSE;
+}
+
+//Skips blanks and returns the next character without consuming it
+static gchar formula_peek(FormulaParser *parser)
+{
+  while (g_ascii_isspace(*parser->pos))
+    parser->pos++;
+
+  return *parser->pos;
+}
+
+//Appends an instruction. Operations on constants are folded: they are run
+//once here and replaced by their value.
+static gboolean formula_emit(FormulaParser *parser, FormulaOp op, int n,
+                             double re, double im, GError **error)
+{
+  FormulaProgram *program = parser->program;
+  FormulaProgram folded;
+  FormulaInstruction *instruction;
+  const v4df zero = VEC4(0.0);
+  v4df value_re;
+  v4df value_im;
+  int operands;
+  int i;
+
+  if (program->length == FORMULA_MAX_CODE)
+    return formula_error(parser, error, "Formula too long");
+
+  instruction = &program->code[program->length++];
+  instruction->op = op;
+  instruction->n = n;
+  instruction->re = re;
+  instruction->im = im;
+
+  operands = formula_operands(op);
+  parser->depth += 1 - operands;
+  program->depth = MAX(program->depth, parser->depth);
+
+  if (program->depth > FORMULA_MAX_STACK)
+    return formula_error(parser, error, "Formula nested too deeply");
+
+  if (operands == 0)
+    return TRUE;
+
+  //An operand that is a constant is always a single instruction, so the
+  //operands are constants exactly when the instructions before are
+  for (i = 2; i <= operands + 1; i++)
+  {
+    if (program->code[program->length - i].op != FORMULA_OP_CONST)
+      return TRUE;
+  }
+
+  folded.length = operands + 1;
+  folded.depth = operands;
+  memcpy(folded.code, program->code + program->length - folded.length,
+         folded.length*sizeof(FormulaInstruction));
+  formula_run(&folded, &zero, &zero, &zero, &zero,
+              &value_re, &value_im);
+
+  program->length -= operands;
+  instruction = &program->code[program->length - 1];
+  instruction->op = FORMULA_OP_CONST;
+  instruction->n = 0;
+  instruction->re = value_re[0];
+  instruction->im = value_im[0];
+
+  return TRUE;
+}
+
+//expression: term {('+' | '-') term}
+static gboolean formula_parse_expression(FormulaParser *parser,
+                                         GError **error)
+{
+  gchar op;
+
+  if (!formula_parse_term(parser, error))
+    return FALSE;
+
+  while ((op = formula_peek(parser)) == '+' || op == '-')
+  {
+    parser->pos++;
+
+    if (!formula_parse_term(parser, error) ||
+        !formula_emit(parser, op == '+' ? FORMULA_OP_ADD : FORMULA_OP_SUB,
+                      0, 0.0, 0.0, error))
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+//term: unary {['*' | '/'] unary}, where a missing operator before a name
+//or parenthesis multiplies as in 2z or 3 sin(z)
+static gboolean formula_parse_term(FormulaParser *parser, GError **error)
+{
+  gchar op;
+
+  if (!formula_parse_unary(parser, error))
+    return FALSE;
+
+  for (;;)
+  {
+    op = formula_peek(parser);
+
+    if (op == '*' || op == '/')
+      parser->pos++;
+    else if (g_ascii_isalpha(op) || op == '(')
+      op = '*';
+    else
+      return TRUE;
+
+    if (!formula_parse_unary(parser, error) ||
+        !formula_emit(parser, op == '*' ? FORMULA_OP_MUL : FORMULA_OP_DIV,
+                      0, 0.0, 0.0, error))
+      return FALSE;
+  }
+}
+
+//unary: ('-' | '+') unary | power
+static gboolean formula_parse_unary(FormulaParser *parser, GError **error)
+{
+  gchar op;
+
+  op = formula_peek(parser);
+
+  if (op == '-' || op == '+')
+  {
+    parser->pos++;
+
+    if (!formula_parse_unary(parser, error))
+      return FALSE;
+
+    return op == '+' ||
+           formula_emit(parser, FORMULA_OP_NEG, 0, 0.0, 0.0, error);
+  }
+
+  return formula_parse_power(parser, error);
+}
+
+//power: primary ['^' unary]. Real integer exponents become multiplications
+//(z^2 a single squaring); anything else is evaluated as exp(w log z).
+static gboolean formula_parse_power(FormulaParser *parser, GError **error)
+{
+  FormulaInstruction *exponent;
+  gboolean ok = TRUE;
+  int n;
+
+  if (!formula_parse_primary(parser, error))
+    return FALSE;
+
+  if (formula_peek(parser) != '^')
+    return TRUE;
+
+  parser->pos++;
+
+  if (!formula_parse_unary(parser, error))
+    return FALSE;
+
+  exponent = &parser->program->code[parser->program->length - 1];
+
+  if (exponent->op != FORMULA_OP_CONST || exponent->im != 0.0 ||
+      exponent->re != rint(exponent->re) ||
+      fabs(exponent->re) > FORMULA_MAX_POWER)
+    return formula_emit(parser, FORMULA_OP_POW, 0, 0.0, 0.0, error);
+
+  n = (int)exponent->re;
+  parser->program->length--;
+  parser->depth--;
+
+  if (n == 2 || n == -2)
+    ok = formula_emit(parser, FORMULA_OP_SQR, 0, 0.0, 0.0, error);
+  else if (n != 1 && n != -1)
+    ok = formula_emit(parser, FORMULA_OP_POWI, ABS(n), 0.0, 0.0, error);
+
+  if (ok && n < 0)
+    ok = formula_emit(parser, FORMULA_OP_RECIP, 0, 0.0, 0.0, error);
+
+  return ok;
+}
+
+//primary: number | z | c | i | pi | function '(' expression ')'
+//         | '(' expression ')'
+static gboolean formula_parse_primary(FormulaParser *parser, GError **error)
+{
+  static const struct
+  {
+    const gchar *name;
+    FormulaOp op;
+  } functions[] =
+  {
+    {"sin", FORMULA_OP_SIN},
+    {"cos", FORMULA_OP_COS},
+    {"sinh", FORMULA_OP_SINH},
+    {"cosh", FORMULA_OP_COSH},
+    {"exp", FORMULA_OP_EXP},
+    {"log", FORMULA_OP_LOG},
+    {"conj", FORMULA_OP_CONJ}
+  };
+  const gchar *start;
+  gchar *end;
+  gchar *name;
+  gchar next;
+  double value;
+  gboolean ok;
+  guint i;
+
+  next = formula_peek(parser);
+  start = parser->pos;
+
+  if (next == '(')
+  {
+    parser->pos++;
+
+    if (!formula_parse_expression(parser, error))
+      return FALSE;
+
+    if (formula_peek(parser) != ')')
+      return formula_error(parser, error, "Expected ')'");
+
+    parser->pos++;
+
+    return TRUE;
+  }
+
+  if (g_ascii_isdigit(next) || next == '.')
+  {
+    value = g_ascii_strtod(start, &end);
+
+    if (end == start)
+      return formula_error(parser, error, "Invalid number");
+
+    parser->pos = end;
+
+    return formula_emit(parser, FORMULA_OP_CONST, 0, value, 0.0, error);
+  }
+
+  if (next == '\0')
+    return formula_error(parser, error, "Unexpected end of formula");
+
+  if (!g_ascii_isalpha(next))
+    return formula_error(parser, error, "Unexpected '%c'", next);
+
+  while (g_ascii_isalnum(*parser->pos))
+    parser->pos++;
+
+  name = g_strndup(start, parser->pos - start);
+
+  if (strcmp(name, "z") == 0 && parser->allow_z)
+  {
+    ok = formula_emit(parser, FORMULA_OP_Z, 0, 0.0, 0.0, error);
+  }
+
+  else if (strcmp(name, "c") == 0)
+  {
+    ok = formula_emit(parser, FORMULA_OP_C, 0, 0.0, 0.0, error);
+  }
+
+  else if (strcmp(name, "i") == 0)
+  {
+    ok = formula_emit(parser, FORMULA_OP_CONST, 0, 0.0, 1.0, error);
+  }
+
+  else if (strcmp(name, "pi") == 0)
+  {
+    ok = formula_emit(parser, FORMULA_OP_CONST, 0, G_PI, 0.0, error);
+  }
+
+  else
+  {
+    for (i = 0; i < G_N_ELEMENTS(functions); i++)
+    {
+      if (strcmp(name, functions[i].name) == 0)
+        break;
+    }
+
+    if (i == G_N_ELEMENTS(functions))
+    {
+      parser->pos = start;
+      ok = formula_error(parser, error, "Unknown name '%s'", name);
+    }
+
+    else if (formula_peek(parser) != '(')
+    {
+      ok = formula_error(parser, error, "Expected '(' after %s", name);
+    }
+
+    else
+    {
+      ok = formula_parse_primary(parser, error) &&
+           formula_emit(parser, functions[i].op, 0, 0.0, 0.0, error);
+    }
+  }
+
+  g_free(name);
+
+  return ok;
+}
+
+//Compiles one expression. z may only appear in the iteration itself.
+static gboolean formula_compile(const gchar *text, gboolean allow_z,
+                                FormulaProgram *program, GError **error)
+{
+  FormulaParser parser;
+
+  memset(program, 0, sizeof(FormulaProgram));
+  parser.text = text;
+  parser.pos = text;
+  parser.program = program;
+  parser.allow_z = allow_z;
+  parser.depth = 0;
+
+  if (!formula_parse_expression(&parser, error))
+    return FALSE;
+
+  if (formula_peek(&parser) != '\0')
+    return formula_error(&parser, error, "Unexpected '%c'", *parser.pos);
+
+  return TRUE;
+}
+
+//Compiles a user formula. Returns NULL and sets error if it does not
+//parse. The starting value is only used in Mandelbrot style.
+static Formula *formula_new(const gchar *text, const gchar *start_text,
+                            gboolean julia_style, GError **error)
+{
+  Formula *formula;
+
+  formula = g_new0(Formula, 1);
+
+  if (!formula_compile(text, TRUE, &formula->iterate, error))
+  {
+    g_free(formula);
+    return NULL;
+  }
+
+  if (!julia_style &&
+      !formula_compile(start_text, FALSE, &formula->start, error))
+  {
+    g_prefix_error(error, "Starting value: ");
+    g_free(formula);
+    return NULL;
+  }
+
+  formula->text = g_strdup(text);
+  formula->start_text = g_strdup(start_text);
+  formula->julia_style = julia_style;
+
+  return formula;
+}
+
+static Formula *formula_copy(Formula *formula)
+{
+  Formula *copy;
+
+  copy = g_new(Formula, 1);
+  *copy = *formula;
+  copy->text = g_strdup(formula->text);
+  copy->start_text = g_strdup(formula->start_text);
+
+  return copy;
+}
+
+static void formula_free(Formula *formula)
+{
+  g_free(formula->text);
+  g_free(formula->start_text);
+  g_free(formula);
+}
+
+//Fixed-point arithmetic for the fixed-point kernels: gint64 numbers with
+//up to FIXED64_MAX_BITS fraction bits, and __int128 numbers with up to
+//FIXED128_MAX_BITS. The 64-bit products are shifted as signed numbers
+//and so round toward minus infinity; the 128-bit ones are computed on the
+//magnitudes and truncate them, rounding toward zero.
+
+static VEC_INLINE gint64 fixed64_from(long double v, int bits)
+{
+  return (gint64)ldexpl(v, bits);
+}
+
+//a*b through one 64x64->128 bit multiplication
+static VEC_INLINE gint64 fixed64_mul(gint64 a, gint64 b, int bits)
+{
+  return (gint64)(((__int128)a*b) >> bits);
+}
+
+//x*x + y*y, summed in 128 bits and saturated at G_MAXINT64
+static VEC_INLINE gint64 fixed64_norm(gint64 x, gint64 y, int bits)
+{
+  __int128 norm;
+
+  norm = ((__int128)x*x + (__int128)y*y) >> bits;
+
+  return norm > G_MAXINT64 ? G_MAXINT64 : (gint64)norm;
+}
+
+static VEC_INLINE __int128 fixed128_from(long double v, int bits)
+{
+  return (__int128)ldexpl(v, bits);
+}
+
+//a*b from the 64x64->128 bit products of the 64-bit halves of |a| and
+//|b|, shifted right by bits (at least 64). The product of the low halves
+//would only reach the result through a carry into the last place, so it
+//is left out.
+static VEC_INLINE __int128 fixed128_mul(__int128 a, __int128 b, int bits)
+{
+  unsigned __int128 ua = a < 0 ? -(unsigned __int128)a : (unsigned __int128)a;
+  unsigned __int128 ub = b < 0 ? -(unsigned __int128)b : (unsigned __int128)b;
+  guint64 a_lo = (guint64)ua;
+  guint64 a_hi = (guint64)(ua >> 64);
+  guint64 b_lo = (guint64)ub;
+  guint64 b_hi = (guint64)(ub >> 64);
+  unsigned __int128 lh;
+  unsigned __int128 hl;
+  unsigned __int128 hh;
+  unsigned __int128 mid;
+  unsigned __int128 product;
+
+  lh = (unsigned __int128)a_lo*b_hi;
+  hl = (unsigned __int128)a_hi*b_lo;
+  hh = (unsigned __int128)a_hi*b_hi;
+
+  //The product is hh*2^128 + (lh + hl)*2^64
+  mid = (unsigned __int128)(guint64)lh + (guint64)hl;
+  hh += (lh >> 64) + (hl >> 64) + (mid >> 64);
+  product = (hh << (128 - bits)) | ((mid << 64) >> bits);
+
+  if ((a < 0) != (b < 0))
+    return -(__int128)product;
+
+  return (__int128)product;
+}
+
+//a*a with the cross product computed once
+static VEC_INLINE __int128 fixed128_sqr(__int128 a, int bits)
+{
+  unsigned __int128 ua = a < 0 ? -(unsigned __int128)a : (unsigned __int128)a;
+  guint64 a_lo = (guint64)ua;
+  guint64 a_hi = (guint64)(ua >> 64);
+  unsigned __int128 lh;
+  unsigned __int128 hh;
+  unsigned __int128 mid;
+
+  lh = (unsigned __int128)a_lo*a_hi;
+  hh = (unsigned __int128)a_hi*a_hi;
+
+  mid = (unsigned __int128)(guint64)lh << 1;
+  hh += ((lh >> 64) << 1) + (mid >> 64);
+
+  return (__int128)((hh << (128 - bits)) | ((mid << 64) >> bits));
+}
+
+//x*x + y*y, or FIXED128_MAX once |x| or |y| reaches FIXED_NORM_LIMIT,
+//where the squares could overflow
+static VEC_INLINE __int128 fixed128_norm(__int128 x, __int128 y, int bits)
+{
+  __int128 limit = (__int128)FIXED_NORM_LIMIT << bits;
+
+  if (x <= -limit || x >= limit || y <= -limit || y >= limit)
+    return FIXED128_MAX;
+
+  return fixed128_sqr(x, bits) + fixed128_sqr(y, bits);
+}
+
+//origin + s*step of the view, with s in 1/SAMPLE_SCALE pixels, cut from
+//VIEW_BITS to bits fraction bits. Whole pixels are exact.
+static VEC_INLINE __int128 fixed_view_point(__int128 origin, __int128 step,
+                                            int s, int bits)
+{
+  return (origin + (s >> SAMPLE_SHIFT)*step +
+          (((s & (SAMPLE_SCALE - 1))*step) >> SAMPLE_SHIFT)) >>
+         (VIEW_BITS - bits);
+}
+
+//Double-double numbers: hi is the nearest double, lo what is left over
+static VEC_INLINE double_dd dd_from_long_double(long double v)
+{
+  double_dd r;
+
+  r.hi = (double)v;
+  r.lo = (double)(v - r.hi);
+
+  return r;
+}
+
+//A fixed-point view coordinate with VIEW_BITS fraction bits, rounded to
+//the 106 bits of a double-double
+static VEC_INLINE double_dd dd_from_fixed(__int128 v)
+{
+  double_dd r;
+  double hi;
+
+  hi = (double)v;
+  r.hi = ldexp(hi, -VIEW_BITS);
+  r.lo = ldexp((double)(v - (__int128)hi), -VIEW_BITS);
+
+  return r;
+}
+
+//Escape-time kernels
+
+/*
+ESCAPE_KERNEL(name, FORMULA, REAL, VEC, MASK, W, LANE, MATH, ATTRIBUTES)
+defines static void name(RenderTile *tile): the render loop for FORMULA,
+computed in REAL on W pixels of a column (or W points) at once. VEC and
+MASK hold one value and one all-ones/zero flag per lane; LANE and MATH
+name the lane operations and number type to use (SCALAR/VECTOR/VECTOR8,
+LONG_DOUBLE/DOUBLE/VECTOR/DD/DD_FMA/FIXED64/FIXED128). Each instantiation
+is compiled on its own, so the iteration loop has no branches on the
+formula, the precision or the width. Pixel coordinates reach the MATH
+hooks in 1/SAMPLE_SCALE pixels.
+
+A formula is a set of macros working on the loop's variables:
+FORMULA_LIMIT      bailout, from the parameters a and b (or four = 4)
+FORMULA_START      first z = x + iy and c = cr + i ci for the pixel px + i py
+FORMULA_STEP       next z as x_new + i y_new
+FORMULA_KEEP       condition for the orbit to go on, with mzsq = |z_new|^2
+FORMULA_TRACK      keeps what lanes still going need at the end
+FORMULA_DISTANCE   distance of lane i to the set in pixels, or -1.0
+A pixel is interior when its orbit is still going after MAX_ITERATIONS
+and |z| < 2.
+*/
+
+//Lane operations for the template: one number, SIMD_WIDTH doubles or
+//SIMD_WIDTH_AVX512 doubles. Masks are all ones for true either way.
+#define SCALAR_TRUE (-1LL)
+#define SCALAR_FALSE 0LL
+#define SCALAR_SPLAT(x) (x)
+#define SCALAR_MASK(condition) (-(long long)(condition))
+#define SCALAR_SELECT(mask, a, b) ((mask) ? (a) : (b))
+#define SCALAR_ANY(mask) (mask)
+#define SCALAR_GET(v, i) (v)
+#define VECTOR_TRUE ((v4di){-1, -1, -1, -1})
+#define VECTOR_FALSE ((v4di){0, 0, 0, 0})
+#define VECTOR_SPLAT(x) VEC4(x)
+#define VECTOR_MASK(condition) (condition)
+#define VECTOR_SELECT(mask, a, b) VEC_SELECT(mask, a, b)
+#define VECTOR_ANY(mask) ((mask)[0] | (mask)[1] | (mask)[2] | (mask)[3])
+#define VECTOR_GET(v, i) ((v)[i])
+#define VECTOR8_TRUE ((v8di){-1, -1, -1, -1, -1, -1, -1, -1})
+#define VECTOR8_FALSE ((v8di){0, 0, 0, 0, 0, 0, 0, 0})
+#define VECTOR8_SPLAT(x) VEC8(x)
+#define VECTOR8_MASK(condition) (condition)
+#define VECTOR8_SELECT(mask, a, b)                                          \
+  ((v8df)(((v8di)(a) & (mask)) | ((v8di)(b) & ~(mask))))
+#define VECTOR8_ANY(mask)                                                   \
+  ((mask)[0] | (mask)[1] | (mask)[2] | (mask)[3] |                          \
+   (mask)[4] | (mask)[5] | (mask)[6] | (mask)[7])
+#define VECTOR8_GET(v, i) ((v)[i])
+
+/*
+Arithmetic and math functions for the template, by number type.
+
+Z(T)               type of z and c for lanes of type T (T itself, or a
+                   double-double of T)
+Z_FROM, FROM       long double to a z value, and to the type of |z|^2
+ADD, SUB, MUL, SQR arithmetic on z values; MUL2(a, b) is 2ab
+NORM               |z|^2 from the real and imaginary parts
+PIXEL_RE, PIXEL_IM coordinates of a pixel column or row
+BAILOUT            limits the formula's bailout to what the type can hold
+SET_SPLAT(LANE, dst, v), SET_LANE(LANE, dst, i, v)
+                   sets every lane, or lane i, of dst to v
+PARK(LANE, dst, mask, src)
+                   dst = src where mask is set and 0 elsewhere
+Z_DOUBLE(LANE, v, i)
+                   lane i of a z value as a double, for the orbits kept
+                   by iteration deepening
+ABS, SINCOS, COSHSINH
+                   for JuliaSine, which only has floating-point builds
+
+The fixed-point and double-double types only have what Mandelbrot and
+Julia need. Types whose z values are plain numbers share the PLAIN_ hooks.
+*/
+#define PLAIN_Z(T) T
+#define PLAIN_ADD(a, b) ((a) + (b))
+#define PLAIN_SUB(a, b) ((a) - (b))
+#define PLAIN_MUL2(a, b) ((2*(a))*(b))
+#define PLAIN_SET_SPLAT(LANE, dst, v) ((dst) = LANE##_SPLAT(v))
+#define PLAIN_SET_LANE(LANE, dst, i, v) (LANE##_GET(dst, i) = (v))
+#define PLAIN_PARK(LANE, dst, mask, src)                                    \
+  ((dst) = LANE##_SELECT(mask, src, LANE##_SPLAT(0)))
+
+#define LONG_DOUBLE_Z PLAIN_Z
+#define LONG_DOUBLE_Z_FROM LONG_DOUBLE_FROM
+#define LONG_DOUBLE_FROM(v) ((long double)(v))
+#define LONG_DOUBLE_ADD PLAIN_ADD
+#define LONG_DOUBLE_SUB PLAIN_SUB
+#define LONG_DOUBLE_MUL(a, b) ((a)*(b))
+#define LONG_DOUBLE_MUL2 PLAIN_MUL2
+#define LONG_DOUBLE_SQR(a) ((a)*(a))
+#define LONG_DOUBLE_NORM(x, y) ((x)*(x) + (y)*(y))
+#define LONG_DOUBLE_PIXEL_RE(sx) ((long double)(sx)/x_scale + re_min)
+#define LONG_DOUBLE_PIXEL_IM(sy) (im_max - (long double)(sy)/y_scale)
+#define LONG_DOUBLE_BAILOUT(v) (v)
+#define LONG_DOUBLE_SET_SPLAT PLAIN_SET_SPLAT
+#define LONG_DOUBLE_SET_LANE PLAIN_SET_LANE
+#define LONG_DOUBLE_PARK PLAIN_PARK
+#define LONG_DOUBLE_Z_DOUBLE(LANE, v, i) ((double)(v))
+#define LONG_DOUBLE_ABS(x) fabsl(x)
+#define LONG_DOUBLE_SINCOS(x, s, c) ((s) = sinl(x), (c) = cosl(x))
+#define LONG_DOUBLE_COSHSINH(y, ch, sh) ((ch) = coshl(y), (sh) = sinhl(y))
+
+#define DOUBLE_Z PLAIN_Z
+#define DOUBLE_Z_FROM DOUBLE_FROM
+#define DOUBLE_FROM(v) ((double)(v))
+#define DOUBLE_ADD PLAIN_ADD
+#define DOUBLE_SUB PLAIN_SUB
+#define DOUBLE_MUL(a, b) ((a)*(b))
+#define DOUBLE_MUL2 PLAIN_MUL2
+#define DOUBLE_SQR(a) ((a)*(a))
+#define DOUBLE_NORM(x, y) ((x)*(x) + (y)*(y))
+#define DOUBLE_PIXEL_RE(sx) ((double)LONG_DOUBLE_PIXEL_RE(sx))
+#define DOUBLE_PIXEL_IM(sy) ((double)LONG_DOUBLE_PIXEL_IM(sy))
+#define DOUBLE_BAILOUT(v) (v)
+#define DOUBLE_SET_SPLAT PLAIN_SET_SPLAT
+#define DOUBLE_SET_LANE PLAIN_SET_LANE
+#define DOUBLE_PARK PLAIN_PARK
+#define DOUBLE_Z_DOUBLE(LANE, v, i) ((double)LANE##_GET(v, i))
+#define DOUBLE_ABS(x) fabs(x)
+#define DOUBLE_SINCOS(x, s, c) ((s) = sin(x), (c) = cos(x))
+#define DOUBLE_COSHSINH(y, ch, sh) ((ch) = cosh(y), (sh) = sinh(y))
+
+//Vectors of doubles share the double hooks; the vector math functions
+//are SIMD_WIDTH wide only
+#define VECTOR_Z PLAIN_Z
+#define VECTOR_Z_FROM DOUBLE_FROM
+#define VECTOR_FROM DOUBLE_FROM
+#define VECTOR_ADD PLAIN_ADD
+#define VECTOR_SUB PLAIN_SUB
+#define VECTOR_MUL DOUBLE_MUL
+#define VECTOR_MUL2 PLAIN_MUL2
+#define VECTOR_SQR DOUBLE_SQR
+#define VECTOR_NORM DOUBLE_NORM
+#define VECTOR_PIXEL_RE DOUBLE_PIXEL_RE
+#define VECTOR_PIXEL_IM DOUBLE_PIXEL_IM
+#define VECTOR_BAILOUT(v) (v)
+#define VECTOR_SET_SPLAT PLAIN_SET_SPLAT
+#define VECTOR_SET_LANE PLAIN_SET_LANE
+#define VECTOR_PARK PLAIN_PARK
+#define VECTOR_Z_DOUBLE DOUBLE_Z_DOUBLE
+#define VECTOR_ABS(x) VEC_ABS(x)
+#define VECTOR_SINCOS(x, s, c) vec_sincos(&(x), &(s), &(c))
+#define VECTOR_COSHSINH(y, ch, sh) vec_coshsinh(&(y), &(ch), &(sh))
+
+#define FIXED64_Z PLAIN_Z
+#define FIXED64_Z_FROM FIXED64_FROM
+#define FIXED64_FROM(v) fixed64_from(v, bits)
+#define FIXED64_ADD PLAIN_ADD
+#define FIXED64_SUB PLAIN_SUB
+#define FIXED64_MUL(a, b) fixed64_mul(a, b, bits)
+#define FIXED64_MUL2(a, b) fixed64_mul(2*(a), b, bits)
+#define FIXED64_SQR(a) fixed64_mul(a, a, bits)
+#define FIXED64_NORM(x, y) fixed64_norm(x, y, bits)
+#define FIXED64_PIXEL_RE(sx)                                                \
+  ((gint64)fixed_view_point(request->view_re_min, request->view_step_x,    \
+                            sx, bits))
+#define FIXED64_PIXEL_IM(sy)                                                \
+  ((gint64)fixed_view_point(request->view_im_max, -request->view_step_y,   \
+                            sy, bits))
+#define FIXED64_BAILOUT(v) MIN(v, FIXED64_FROM(FIXED_BAILOUT))
+#define FIXED64_SET_SPLAT PLAIN_SET_SPLAT
+#define FIXED64_SET_LANE PLAIN_SET_LANE
+#define FIXED64_PARK PLAIN_PARK
+#define FIXED64_Z_DOUBLE(LANE, v, i) ldexp((double)(v), -bits)
+
+#define FIXED128_Z PLAIN_Z
+#define FIXED128_Z_FROM FIXED128_FROM
+#define FIXED128_FROM(v) fixed128_from(v, bits)
+#define FIXED128_ADD PLAIN_ADD
+#define FIXED128_SUB PLAIN_SUB
+#define FIXED128_MUL(a, b) fixed128_mul(a, b, bits)
+#define FIXED128_MUL2(a, b) fixed128_mul(2*(a), b, bits)
+#define FIXED128_SQR(a) fixed128_sqr(a, bits)
+#define FIXED128_NORM(x, y) fixed128_norm(x, y, bits)
+#define FIXED128_PIXEL_RE(sx)                                               \
+  fixed_view_point(request->view_re_min, request->view_step_x, sx, bits)
+#define FIXED128_PIXEL_IM(sy)                                               \
+  fixed_view_point(request->view_im_max, -request->view_step_y, sy, bits)
+#define FIXED128_BAILOUT(v) MIN(v, FIXED128_FROM(FIXED_BAILOUT))
+#define FIXED128_SET_SPLAT PLAIN_SET_SPLAT
+#define FIXED128_SET_LANE PLAIN_SET_LANE
+#define FIXED128_PARK PLAIN_PARK
+#define FIXED128_Z_DOUBLE FIXED64_Z_DOUBLE
+
+//Double-double: DD splits products with Dekker's method, DD_FMA uses
+//fused multiply-subtract (AVX2 and AVX-512 builds). The arithmetic is
+//picked by the type of the operands, which must be lvalues. |z|^2 only
+//needs the high parts.
+#define DD_Z(T) T##_dd
+#define DD_Z_FROM(v) dd_from_long_double(v)
+#define DD_FROM(v) ((double)(v))
+#define DD_ADD(a, b)                                                        \
+  _Generic((a), double_dd: dd_add, v4df_dd: dd4_add)(&(a), &(b))
+#define DD_SUB(a, b)                                                        \
+  _Generic((a), double_dd: dd_sub, v4df_dd: dd4_sub)(&(a), &(b))
+#define DD_MUL(a, b)                                                        \
+  _Generic((a), double_dd: dd_mul, v4df_dd: dd4_mul)(&(a), &(b))
+#define DD_MUL2(a, b)                                                       \
+  _Generic((a), double_dd: dd_mul2, v4df_dd: dd4_mul2)(&(a), &(b))
+#define DD_SQR(a) _Generic((a), double_dd: dd_sqr, v4df_dd: dd4_sqr)(&(a))
+#define DD_NORM(x, y) ((x).hi*(x).hi + (y).hi*(y).hi)
+#define DD_PIXEL_RE(sx)                                                     \
+  dd_from_fixed(fixed_view_point(request->view_re_min,                      \
+                                 request->view_step_x, sx, VIEW_BITS))
+#define DD_PIXEL_IM(sy)                                                     \
+  dd_from_fixed(fixed_view_point(request->view_im_max,                      \
+                                 -request->view_step_y, sy, VIEW_BITS))
+#define DD_BAILOUT(v) (v)
+#define DD_SET_SPLAT(LANE, dst, v)                                          \
+  ((dst).hi = LANE##_SPLAT((v).hi), (dst).lo = LANE##_SPLAT((v).lo))
+#define DD_SET_LANE(LANE, dst, i, v)                                        \
+  (LANE##_GET((dst).hi, i) = (v).hi, LANE##_GET((dst).lo, i) = (v).lo)
+#define DD_PARK(LANE, dst, mask, src)                                       \
+  ((dst).hi = LANE##_SELECT(mask, (src).hi, LANE##_SPLAT(0)),               \
+   (dst).lo = LANE##_SELECT(mask, (src).lo, LANE##_SPLAT(0)))
+#define DD_Z_DOUBLE(LANE, v, i) LANE##_GET((v).hi, i)
+
+#define DD_FMA_Z DD_Z
+#define DD_FMA_Z_FROM DD_Z_FROM
+#define DD_FMA_FROM DD_FROM
+#define DD_FMA_ADD(a, b)                                                    \
+  _Generic((a), v4df_dd: dd4_fma_add, v8df_dd: dd8_fma_add)(&(a), &(b))
+#define DD_FMA_SUB(a, b)                                                    \
+  _Generic((a), v4df_dd: dd4_fma_sub, v8df_dd: dd8_fma_sub)(&(a), &(b))
+#define DD_FMA_MUL(a, b)                                                    \
+  _Generic((a), v4df_dd: dd4_fma_mul, v8df_dd: dd8_fma_mul)(&(a), &(b))
+#define DD_FMA_MUL2(a, b)                                                   \
+  _Generic((a), v4df_dd: dd4_fma_mul2, v8df_dd: dd8_fma_mul2)(&(a), &(b))
+#define DD_FMA_SQR(a)                                                       \
+  _Generic((a), v4df_dd: dd4_fma_sqr, v8df_dd: dd8_fma_sqr)(&(a))
+#define DD_FMA_NORM DD_NORM
+#define DD_FMA_PIXEL_RE DD_PIXEL_RE
+#define DD_FMA_PIXEL_IM DD_PIXEL_IM
+#define DD_FMA_BAILOUT DD_BAILOUT
+#define DD_FMA_SET_SPLAT DD_SET_SPLAT
+#define DD_FMA_SET_LANE DD_SET_LANE
+#define DD_FMA_PARK DD_PARK
+#define DD_FMA_Z_DOUBLE DD_Z_DOUBLE
+
+//Instruction sets of the AVX2 and AVX-512 instantiations
+#if defined(__x86_64__) || defined(__i386__)
+#define KERNEL_AVX2 __attribute__ ((target ("avx2,fma")))
+#define KERNEL_AVX512 __attribute__ ((target ("avx512f,avx2,fma")))
+#else
+#define KERNEL_AVX2
+#define KERNEL_AVX512
+#endif
+
+/*
+DOUBLE_DOUBLE_ARITHMETIC(PREFIX, T, TWO_PROD, ATTRIBUTES) defines
+PREFIX_add, _sub, _mul, _mul2 and _sqr on T_dd numbers, after the QD
+library of Hida, Li and Bailey. TWO_PROD(T, p, e, a, b) sets p + e to the
+exact product a*b. Additions keep the error terms of both parts, since
+x*x - y*y cancels. Operands are taken through pointers, like the vector
+math helpers.
+*/
+
+//Dekker's product: a and b are split into 26-bit halves whose products
+//are exact
+#define TWO_PROD_DEKKER(T, p, e, a, b)                                      \
+  do                                                                        \
+  {                                                                         \
+    T split_a = 134217729.0*(a);                                            \
+    T split_b = 134217729.0*(b);                                            \
+    T a_hi = split_a - (split_a - (a));                                     \
+    T b_hi = split_b - (split_b - (b));                                     \
+    T a_lo = (a) - a_hi;                                                    \
+    T b_lo = (b) - b_hi;                                                    \
+                                                                            \
+    (p) = (a)*(b);                                                          \
+    (e) = ((a_hi*b_hi - (p)) + a_hi*b_lo + a_lo*b_hi) + a_lo*b_lo;          \
+  } while (0)
+
+//With FMA the rounding error of a*b is one fused multiply-subtract
+#if defined(__x86_64__) || defined(__i386__)
+#define TWO_PROD_FMA4(T, p, e, a, b)                                        \
+  ((p) = (a)*(b), (e) = _mm256_fmsub_pd(a, b, p))
+#define TWO_PROD_FMA8(T, p, e, a, b)                                        \
+  ((p) = (a)*(b), (e) = _mm512_fmsub_pd(a, b, p))
+#else
+#define TWO_PROD_FMA4 TWO_PROD_DEKKER
+#define TWO_PROD_FMA8 TWO_PROD_DEKKER
+#endif
+
+#define DOUBLE_DOUBLE_ARITHMETIC(PREFIX, T, TWO_PROD, ATTRIBUTES)           \
+static ATTRIBUTES VEC_INLINE T##_dd PREFIX##_add(const T##_dd *a,           \
+                                                 const T##_dd *b)           \
+{                                                                           \
+  T##_dd r;                                                                 \
+  T s;                                                                      \
+  T e;                                                                      \
+  T t;                                                                      \
+  T f;                                                                      \
+  T v;                                                                      \
+                                                                            \
+  /* exact sums of the high parts and of the low parts */                   \
+  s = a->hi + b->hi;                                                        \
+  v = s - a->hi;                                                            \
+  e = (a->hi - (s - v)) + (b->hi - v);                                      \
+  t = a->lo + b->lo;                                                        \
+  v = t - a->lo;                                                            \
+  f = (a->lo - (t - v)) + (b->lo - v);                                      \
+                                                                            \
+  /* renormalize twice */                                                   \
+  e += t;                                                                   \
+  r.hi = s + e;                                                             \
+  e -= r.hi - s;                                                            \
+  e += f;                                                                   \
+  s = r.hi + e;                                                             \
+  r.lo = e - (s - r.hi);                                                    \
+  r.hi = s;                                                                 \
+                                                                            \
+  return r;                                                                 \
+}                                                                           \
+                                                                            \
+static ATTRIBUTES VEC_INLINE T##_dd PREFIX##_sub(const T##_dd *a,           \
+                                                 const T##_dd *b)           \
+{                                                                           \
+  T##_dd n;                                                                 \
+                                                                            \
+  n.hi = -b->hi;                                                            \
+  n.lo = -b->lo;                                                            \
+                                                                            \
+  return PREFIX##_add(a, &n);                                               \
+}                                                                           \
+                                                                            \
+static ATTRIBUTES VEC_INLINE T##_dd PREFIX##_mul(const T##_dd *a,           \
+                                                 const T##_dd *b)           \
+{                                                                           \
+  T##_dd r;                                                                 \
+  T p;                                                                      \
+  T e;                                                                      \
+                                                                            \
+  TWO_PROD(T, p, e, a->hi, b->hi);                                          \
+  e += a->hi*b->lo + a->lo*b->hi;                                           \
+  r.hi = p + e;                                                             \
+  r.lo = e - (r.hi - p);                                                    \
+                                                                            \
+  return r;                                                                 \
+}                                                                           \
+                                                                            \
+static ATTRIBUTES VEC_INLINE T##_dd PREFIX##_mul2(const T##_dd *a,          \
+                                                  const T##_dd *b)          \
+{                                                                           \
+  T##_dd r;                                                                 \
+                                                                            \
+  r = PREFIX##_mul(a, b);                                                   \
+  r.hi = 2*r.hi;                                                            \
+  r.lo = 2*r.lo;                                                            \
+                                                                            \
+  return r;                                                                 \
+}                                                                           \
+                                                                            \
+static ATTRIBUTES VEC_INLINE T##_dd PREFIX##_sqr(const T##_dd *a)           \
+{                                                                           \
+  T##_dd r;                                                                 \
+  T p;                                                                      \
+  T e;                                                                      \
+                                                                            \
+  TWO_PROD(T, p, e, a->hi, a->hi);                                          \
+  e += (2*a->hi)*a->lo;                                                     \
+  r.hi = p + e;                                                             \
+  r.lo = e - (r.hi - p);                                                    \
+                                                                            \
+  return r;                                                                 \
+}
+
+DOUBLE_DOUBLE_ARITHMETIC(dd, double, TWO_PROD_DEKKER, )
+DOUBLE_DOUBLE_ARITHMETIC(dd4, v4df, TWO_PROD_DEKKER, )
+DOUBLE_DOUBLE_ARITHMETIC(dd4_fma, v4df, TWO_PROD_FMA4, KERNEL_AVX2)
+DOUBLE_DOUBLE_ARITHMETIC(dd8_fma, v8df, TWO_PROD_FMA8, KERNEL_AVX512)
+
+//The orbits of the W pixels in px + i py, for ESCAPE_KERNEL; leaves
+//their state in bailed, mzsq, iterations and escaped_at
+#define ESCAPE_ORBITS(FORMULA, VEC, LANE, MATH)                             \
+  do                                                                        \
+  {                                                                         \
+    FORMULA##_START(LANE, MATH);                                            \
+                                                                            \
+    mzsq = LANE##_SPLAT(0);                                                 \
+    active = LANE##_TRUE;                                                   \
+    bailed = LANE##_FALSE;                                                  \
+    escaped_at = LANE##_FALSE;                                              \
+    iterations = LANE##_FALSE;                                              \
+    counter = 0;                                                            \
+                                                                            \
+    while (counter < MAX_ITERATIONS)                                        \
+    {                                                                       \
+      FORMULA##_STEP(VEC, MATH);                                            \
+                                                                            \
+      /* calculate square of the modulus of z */                            \
+      mzsq_new = MATH##_NORM(x_new, y_new);                                 \
+                                                                            \
+      counter++;                                                            \
+      iterations -= active;                                                 \
+                                                                            \
+      escaped = active & LANE##_MASK(mzsq_new > four) &                     \
+                LANE##_MASK(escaped_at == 0);                               \
+      escaped_at = (escaped & counter) | (~escaped & escaped_at);           \
+                                                                            \
+      /* finished lanes are parked at z = 0; NaN finishes a lane too */     \
+      bailed |= active & ~LANE##_MASK(FORMULA##_KEEP(MATH));                \
+      mzsq = LANE##_SELECT(active, mzsq_new, mzsq);                         \
+      FORMULA##_TRACK(LANE);                                                \
+      active &= ~bailed;                                                    \
+      MATH##_PARK(LANE, x, active, x_new);                                  \
+      MATH##_PARK(LANE, y, active, y_new);                                  \
+                                                                            \
+      if (!LANE##_ANY(active))                                              \
+        break;                                                              \
+    }                                                                       \
+  } while (0)
+
+//Colors lane i of the orbits just computed into dst, and counts it. For
+//iteration deepening the last z of an interior pixel goes to the tile's
+//side table.
+#define ESCAPE_STORE(LANE, MATH, i, dst)                                    \
+  do                                                                        \
+  {                                                                         \
+    if (!LANE##_GET(bailed, i) && LANE##_GET(mzsq, i) < four)               \
+    {                                                                       \
+      (dst) = COLOR_INTERIOR;                                               \
+      render_count_pixel(&tile->counters, LANE##_GET(iterations, i), 0);    \
+      if (tile->orbit_pixels)                                               \
+      {                                                                     \
+        tile->orbit_pixels[tile->unresolved] = &(dst) - tile->pixels;       \
+        tile->orbit_re[tile->unresolved] = MATH##_Z_DOUBLE(LANE, x, i);     \
+        tile->orbit_im[tile->unresolved] = MATH##_Z_DOUBLE(LANE, y, i);     \
+        tile->unresolved++;                                                 \
+      }                                                                     \
+    }                                                                       \
+    else                                                                    \
+    {                                                                       \
+      (dst) = COLOR_EXTERIOR;                                               \
+      render_count_pixel(&tile->counters, LANE##_GET(iterations, i),        \
+                         LANE##_GET(escaped_at, i) ?                        \
+                         LANE##_GET(escaped_at, i) :                        \
+                         LANE##_GET(iterations, i));                        \
+    }                                                                       \
+  } while (0)
+
+//A tile is either the rectangle of pixels, computed a column at a time,
+//or a list of n_points points in 1/SAMPLE_SCALE pixels (the antialiasing
+//and distance estimation samples), whose colors go to pixels[0 ..
+//n_points - 1] and distances, when asked for, to distances
+#define ESCAPE_KERNEL(name, FORMULA, REAL, VEC, MASK, W, LANE, MATH,        \
+                      ATTRIBUTES)                                           \
+static ATTRIBUTES void name(RenderTile *tile)                               \
+{                                                                           \
+  RenderRequest *request = tile->request;                                   \
+  long double re_min = request->re_min;                                     \
+  long double im_max = request->im_max;                                     \
+  long double x_scale = request->x_scale*SAMPLE_SCALE;                      \
+  long double y_scale = request->y_scale*SAMPLE_SCALE;                      \
+  int bits = request->fixed_bits;                                           \
+  MATH##_Z(REAL) a = MATH##_Z_FROM(request->parameter_a);                   \
+  MATH##_Z(REAL) b = MATH##_Z_FROM(request->parameter_b);                   \
+  MATH##_Z(REAL) zero = MATH##_Z_FROM(0.0);                                 \
+  MATH##_Z(REAL) p;                                                         \
+  REAL four = MATH##_FROM(4.0);                                             \
+  REAL bailout = MATH##_BAILOUT(FORMULA##_LIMIT(MATH));                     \
+  int screen_x;                                                             \
+  int screen_y;                                                             \
+  int lanes;                                                                \
+  int counter;                                                              \
+  int i;                                                                    \
+  int k;                                                                    \
+  int n;                                                                    \
+  MATH##_Z(VEC) px;                                                         \
+  MATH##_Z(VEC) py;                                                         \
+  MATH##_Z(VEC) cr;                                                         \
+  MATH##_Z(VEC) ci;                                                         \
+  MATH##_Z(VEC) x;                                                          \
+  MATH##_Z(VEC) y;                                                          \
+  MATH##_Z(VEC) x_new;                                                      \
+  MATH##_Z(VEC) y_new;                                                      \
+  VEC dx;                                                                   \
+  VEC dy;                                                                   \
+  VEC dzsq;                                                                 \
+  VEC mzsq;                                                                 \
+  VEC mzsq_new;                                                             \
+  MASK active;                                                              \
+  MASK bailed;                                                              \
+  MASK escaped;                                                             \
+  MASK escaped_at;                                                          \
+  MASK iterations;                                                          \
+  guint32 *pixel;                                                           \
+                                                                            \
+  /* not every formula uses the parameters or a bailout, and the */         \
+  /* fixed-point and double-double types use the fixed-point view */        \
+  (void)re_min;                                                             \
+  (void)im_max;                                                             \
+  (void)x_scale;                                                            \
+  (void)y_scale;                                                            \
+  (void)bits;                                                               \
+  (void)a;                                                                  \
+  (void)b;                                                                  \
+  (void)zero;                                                               \
+  (void)bailout;                                                            \
+  (void)dx;                                                                 \
+  (void)dy;                                                                 \
+  (void)dzsq;                                                               \
+                                                                            \
+  for (k = 0; k < tile->n_points; k += W)                                   \
+  {                                                                         \
+    /* lanes past the end of the list repeat the last point */              \
+    lanes = MIN(W, tile->n_points - k);                                     \
+                                                                            \
+    for (i = 0; i < W; i++)                                                 \
+    {                                                                       \
+      n = k + MIN(i, lanes - 1);                                            \
+      p = MATH##_PIXEL_RE(tile->points[2*n]);                               \
+      MATH##_SET_LANE(LANE, px, i, p);                                      \
+      p = MATH##_PIXEL_IM(tile->points[2*n + 1]);                           \
+      MATH##_SET_LANE(LANE, py, i, p);                                      \
+    }                                                                       \
+                                                                            \
+    ESCAPE_ORBITS(FORMULA, VEC, LANE, MATH);                                \
+                                                                            \
+    for (i = 0; i < lanes; i++)                                             \
+    {                                                                       \
+      ESCAPE_STORE(LANE, MATH, i, tile->pixels[k + i]);                     \
+                                                                            \
+      if (tile->distances)                                                  \
+        tile->distances[k + i] = FORMULA##_DISTANCE(LANE, i);               \
+    }                                                                       \
+  }                                                                         \
+                                                                            \
+  if (tile->n_points > 0)                                                   \
+    return;                                                                 \
+                                                                            \
+  for (screen_x = tile->x; screen_x < tile->x + tile->width; screen_x++)    \
+  {                                                                         \
+    p = MATH##_PIXEL_RE(screen_x*SAMPLE_SCALE);                             \
+    MATH##_SET_SPLAT(LANE, px, p);                                          \
+                                                                            \
+    pixel = tile->pixels + (screen_x - tile->x);                            \
+                                                                            \
+    for (screen_y = tile->y; screen_y < tile->y + tile->height;             \
+         screen_y += W)                                                     \
+    {                                                                       \
+      /* lanes past the end of the tile repeat the last pixel */            \
+      lanes = MIN(W, tile->y + tile->height - screen_y);                    \
+                                                                            \
+      for (i = 0; i < W; i++)                                               \
+      {                                                                     \
+        n = screen_y + MIN(i, lanes - 1);                                   \
+        p = MATH##_PIXEL_IM(n*SAMPLE_SCALE);                                \
+        MATH##_SET_LANE(LANE, py, i, p);                                    \
+      }                                                                     \
+                                                                            \
+      ESCAPE_ORBITS(FORMULA, VEC, LANE, MATH);                              \
+                                                                            \
+      for (i = 0; i < lanes; i++)                                           \
+      {                                                                     \
+        ESCAPE_STORE(LANE, MATH, i, *pixel);                                \
+        pixel += tile->width;                                               \
+      }                                                                     \
+    }                                                                       \
+  }                                                                         \
+}
+
+//Mandelbrot set: z -> z*z + c from z = 0, with c the pixel.
+//|z| > 2 means c is not in the set.
+#define MANDEL_LIMIT(MATH) four
+#define MANDEL_START(LANE, MATH)                                            \
+  (MATH##_SET_SPLAT(LANE, x, zero), MATH##_SET_SPLAT(LANE, y, zero),        \
+   cr = px, ci = py)
+#define MANDEL_STEP(VEC, MATH)                                              \
+  (x_new = MATH##_SQR(x), y_new = MATH##_SQR(y),                            \
+   x_new = MATH##_SUB(x_new, y_new), x_new = MATH##_ADD(x_new, cr),         \
+   y_new = MATH##_MUL2(x, y), y_new = MATH##_ADD(y_new, ci))
+#define MANDEL_KEEP(MATH) (mzsq_new <= bailout)
+#define MANDEL_TRACK(LANE) ((void)0)
+#define MANDEL_DISTANCE(LANE, i) (-1.0)
+
+//Julia set: z -> z*z + c from the pixel, with c = a + bi. Once
+//|z| > max(2, |c|) the orbit cannot come back, so iterating further
+//would not change the color of the pixel.
+#define JULIA_LIMIT(MATH) MAX(four, MATH##_NORM(a, b))
+#define JULIA_START(LANE, MATH)                                             \
+  (x = px, y = py, MATH##_SET_SPLAT(LANE, cr, a),                           \
+   MATH##_SET_SPLAT(LANE, ci, b))
+#define JULIA_STEP(VEC, MATH) MANDEL_STEP(VEC, MATH)
+#define JULIA_KEEP(MATH) (mzsq_new <= bailout)
+#define JULIA_TRACK(LANE) ((void)0)
+#define JULIA_DISTANCE(LANE, i) (-1.0)
+
+/*
+Distance estimation for the Mandelbrot and Julia sets (double lanes
+only). The step also carries the derivative dz = dx + i dy of z along:
+
+dz -> 2 z dz + 1 from 0 (Mandelbrot, derivative with respect to c)
+dz -> 2 z dz from 1 (Julia, with respect to the starting point)
+
+Once |z| is large, the point is about d = |z| ln|z| / |dz| from the set,
+and at least d/2 from the Mandelbrot set or a connected Julia set
+(Koebe's 1/4 theorem applied to the Boettcher map). Orbits that have not
+reached DISTANCE_RADIUS after MAX_ITERATIONS have no estimate.
+*/
+#define MANDELDIST_LIMIT(MATH) (DISTANCE_RADIUS*DISTANCE_RADIUS)
+#define MANDELDIST_START(LANE, MATH)                                        \
+  (MANDEL_START(LANE, MATH), dx = LANE##_SPLAT(0), dy = LANE##_SPLAT(0),    \
+   dzsq = LANE##_SPLAT(0))
+#define MANDELDIST_STEP(VEC, MATH)                                          \
+  do                                                                        \
+  {                                                                         \
+    VEC dx_new;                                                             \
+                                                                            \
+    dx_new = 2*(x*dx - y*dy) + 1;                                           \
+    dy = 2*(x*dy + y*dx);                                                   \
+    dx = dx_new;                                                            \
+    MANDEL_STEP(VEC, MATH);                                                 \
+  } while (0)
+#define MANDELDIST_KEEP(MATH) MANDEL_KEEP(MATH)
+#define MANDELDIST_TRACK(LANE)                                              \
+  (dzsq = LANE##_SELECT(active, dx*dx + dy*dy, dzsq))
+#define MANDELDIST_DISTANCE(LANE, i)                                        \
+  (LANE##_GET(bailed, i) ?                                                  \
+   sqrt(LANE##_GET(mzsq, i)/LANE##_GET(dzsq, i))*                           \
+   0.5*log(LANE##_GET(mzsq, i))*request->x_scale : -1.0)
+
+#define JULIADIST_LIMIT(MATH)                                               \
+  MAX(DISTANCE_RADIUS*DISTANCE_RADIUS, MATH##_NORM(a, b))
+#define JULIADIST_START(LANE, MATH)                                         \
+  (JULIA_START(LANE, MATH), dx = LANE##_SPLAT(1), dy = LANE##_SPLAT(0),     \
+   dzsq = LANE##_SPLAT(1))
+#define JULIADIST_STEP(VEC, MATH)                                           \
+  do                                                                        \
+  {                                                                         \
+    VEC dx_new;                                                             \
+                                                                            \
+    dx_new = 2*(x*dx - y*dy);                                               \
+    dy = 2*(x*dy + y*dx);                                                   \
+    dx = dx_new;                                                            \
+    JULIA_STEP(VEC, MATH);                                                  \
+  } while (0)
+#define JULIADIST_KEEP(MATH) JULIA_KEEP(MATH)
+#define JULIADIST_TRACK(LANE) MANDELDIST_TRACK(LANE)
+#define JULIADIST_DISTANCE(LANE, i) MANDELDIST_DISTANCE(LANE, i)
+
+/*
+Julia/Sine set: z -> sin(z) + c from the pixel, with c = a + bi
+
+xk+1 = sin(xk) cosh(yk) + a
+yk+1 = cos(xk) sinh(yk) + b
+
+Orbits whose |Im z| exceeds JULIASIN_BAILOUT are finished: sinh() makes
+them overflow within a few iterations.
+*/
+#define JULIASIN_LIMIT(MATH) JULIASIN_BAILOUT
+#define JULIASIN_START(LANE, MATH) JULIA_START(LANE, MATH)
+#define JULIASIN_STEP(VEC, MATH)                                            \
+  do                                                                        \
+  {                                                                         \
+    VEC s;                                                                  \
+    VEC c;                                                                  \
+    VEC ch;                                                                 \
+    VEC sh;                                                                 \
+                                                                            \
+    MATH##_SINCOS(x, s, c);                                                 \
+    MATH##_COSHSINH(y, ch, sh);                                             \
+    x_new = s*ch + cr;                                                      \
+    y_new = c*sh + ci;                                                      \
+  } while (0)
+#define JULIASIN_KEEP(MATH) (MATH##_ABS(y_new) <= bailout)
+#define JULIASIN_TRACK(LANE) ((void)0)
+#define JULIASIN_DISTANCE(LANE, i) (-1.0)
+
+//User formula, through the bytecode interpreter (vector double only).
+//Mandelbrot style starts at z0(c) with c the pixel, Julia style at the
+//pixel with c = a + bi.
+#define USER_LIMIT(MATH) FORMULA_BAILOUT
+#define USER_START(LANE, MATH)                                              \
+  do                                                                        \
+  {                                                                         \
+    if (request->formula->julia_style)                                      \
+    {                                                                       \
+      JULIA_START(LANE, MATH);                                              \
+    }                                                                       \
+    else                                                                    \
+    {                                                                       \
+      cr = px;                                                              \
+      ci = py;                                                              \
+      x = VEC4(0.0);                                                        \
+      y = x;                                                                \
+      formula_run(&request->formula->start, &x, &y, &cr, &ci, &x, &y);     \
+    }                                                                       \
+  } while (0)
+#define USER_STEP(VEC, MATH)                                                \
+  formula_run(&request->formula->iterate, &x, &y, &cr, &ci, &x_new, &y_new)
+#define USER_KEEP(MATH) (mzsq_new <= bailout)
+#define USER_TRACK(LANE) ((void)0)
+#define USER_DISTANCE(LANE, i) (-1.0)
+
+ESCAPE_KERNEL(mandel_long_double, MANDEL, long double, long double,
+              long long, 1, SCALAR, LONG_DOUBLE, )
+ESCAPE_KERNEL(mandel_double, MANDEL, double, double,
+              long long, 1, SCALAR, DOUBLE, )
+ESCAPE_KERNEL(mandel_vector, MANDEL, double, v4df,
+              v4di, SIMD_WIDTH, VECTOR, VECTOR, )
+ESCAPE_KERNEL(mandel_avx2, MANDEL, double, v4df,
+              v4di, SIMD_WIDTH, VECTOR, VECTOR, KERNEL_AVX2)
+ESCAPE_KERNEL(mandel_avx512, MANDEL, double, v8df,
+              v8di, SIMD_WIDTH_AVX512, VECTOR8, VECTOR, KERNEL_AVX512)
+ESCAPE_KERNEL(mandel_dd, MANDEL, double, double,
+              long long, 1, SCALAR, DD, )
+ESCAPE_KERNEL(mandel_dd_vector, MANDEL, double, v4df,
+              v4di, SIMD_WIDTH, VECTOR, DD, )
+ESCAPE_KERNEL(mandel_dd_avx2, MANDEL, double, v4df,
+              v4di, SIMD_WIDTH, VECTOR, DD_FMA, KERNEL_AVX2)
+ESCAPE_KERNEL(mandel_dd_avx512, MANDEL, double, v8df,
+              v8di, SIMD_WIDTH_AVX512, VECTOR8, DD_FMA, KERNEL_AVX512)
+ESCAPE_KERNEL(mandel_fixed64, MANDEL, gint64, gint64,
+              long long, 1, SCALAR, FIXED64, )
+ESCAPE_KERNEL(mandel_fixed128, MANDEL, __int128, __int128,
+              long long, 1, SCALAR, FIXED128, )
+
+ESCAPE_KERNEL(julia_long_double, JULIA, long double, long double,
+              long long, 1, SCALAR, LONG_DOUBLE, )
+ESCAPE_KERNEL(julia_double, JULIA, double, double,
+              long long, 1, SCALAR, DOUBLE, )
+ESCAPE_KERNEL(julia_vector, JULIA, double, v4df,
+              v4di, SIMD_WIDTH, VECTOR, VECTOR, )
+ESCAPE_KERNEL(julia_avx2, JULIA, double, v4df,
+              v4di, SIMD_WIDTH, VECTOR, VECTOR, KERNEL_AVX2)
+ESCAPE_KERNEL(julia_avx512, JULIA, double, v8df,
+              v8di, SIMD_WIDTH_AVX512, VECTOR8, VECTOR, KERNEL_AVX512)
+ESCAPE_KERNEL(julia_dd, JULIA, double, double,
+              long long, 1, SCALAR, DD, )
+ESCAPE_KERNEL(julia_dd_vector, JULIA, double, v4df,
+              v4di, SIMD_WIDTH, VECTOR, DD, )
+ESCAPE_KERNEL(julia_dd_avx2, JULIA, double, v4df,
+              v4di, SIMD_WIDTH, VECTOR, DD_FMA, KERNEL_AVX2)
+ESCAPE_KERNEL(julia_dd_avx512, JULIA, double, v8df,
+              v8di, SIMD_WIDTH_AVX512, VECTOR8, DD_FMA, KERNEL_AVX512)
+ESCAPE_KERNEL(julia_fixed64, JULIA, gint64, gint64,
+              long long, 1, SCALAR, FIXED64, )
+ESCAPE_KERNEL(julia_fixed128, JULIA, __int128, __int128,
+              long long, 1, SCALAR, FIXED128, )
+
+ESCAPE_KERNEL(mandel_distance_double, MANDELDIST, double, double,
+              long long, 1, SCALAR, DOUBLE, )
+ESCAPE_KERNEL(mandel_distance_vector, MANDELDIST, double, v4df,
+              v4di, SIMD_WIDTH, VECTOR, VECTOR, )
+ESCAPE_KERNEL(mandel_distance_avx2, MANDELDIST, double, v4df,
+              v4di, SIMD_WIDTH, VECTOR, VECTOR, KERNEL_AVX2)
+ESCAPE_KERNEL(mandel_distance_avx512, MANDELDIST, double, v8df,
+              v8di, SIMD_WIDTH_AVX512, VECTOR8, VECTOR, KERNEL_AVX512)
+
+ESCAPE_KERNEL(julia_distance_double, JULIADIST, double, double,
+              long long, 1, SCALAR, DOUBLE, )
+ESCAPE_KERNEL(julia_distance_vector, JULIADIST, double, v4df,
+              v4di, SIMD_WIDTH, VECTOR, VECTOR, )
+ESCAPE_KERNEL(julia_distance_avx2, JULIADIST, double, v4df,
+              v4di, SIMD_WIDTH, VECTOR, VECTOR, KERNEL_AVX2)
+ESCAPE_KERNEL(julia_distance_avx512, JULIADIST, double, v8df,
+              v8di, SIMD_WIDTH_AVX512, VECTOR8, VECTOR, KERNEL_AVX512)
+
+ESCAPE_KERNEL(juliasin_long_double, JULIASIN, long double, long double,
+              long long, 1, SCALAR, LONG_DOUBLE, )
+ESCAPE_KERNEL(juliasin_double, JULIASIN, double, double,
+              long long, 1, SCALAR, DOUBLE, )
+ESCAPE_KERNEL(juliasin_vector, JULIASIN, double, v4df,
+              v4di, SIMD_WIDTH, VECTOR, VECTOR, )
+ESCAPE_KERNEL(juliasin_avx2, JULIASIN, double, v4df,
+              v4di, SIMD_WIDTH, VECTOR, VECTOR, KERNEL_AVX2)
+
+ESCAPE_KERNEL(user_vector, USER, double, v4df,
+              v4di, SIMD_WIDTH, VECTOR, VECTOR, )
+ESCAPE_KERNEL(user_avx2, USER, double, v4df,
+              v4di, SIMD_WIDTH, VECTOR, VECTOR, KERNEL_AVX2)
+
+//Continues the orbits in a tile's side table for tile->deepen more
+//iterations, in vectors of doubles like the kernels that started them,
+//SIMD_WIDTH entries at a time. Pixels that escape turn COLOR_EXTERIOR;
+//the others keep their new z.
+static void render_tile_deepen(RenderTile *tile)
+{
+  RenderRequest *request = tile->request;
+  long double re_min = request->re_min;
+  long double im_max = request->im_max;
+  long double x_scale = request->x_scale*SAMPLE_SCALE;
+  long double y_scale = request->y_scale*SAMPLE_SCALE;
+  gboolean julia = request->type == FRACTAL_JULIA;
+  double a = (double)request->parameter_a;
+  double b = (double)request->parameter_b;
+  double lane[4][SIMD_WIDTH];
+  v4df four = VEC4(4.0);
+  v4df bailout;
+  v4df cr;
+  v4df ci;
+  v4df x;
+  v4df y;
+  v4df x_new;
+  v4df y_new;
+  v4df mzsq;
+  v4df mzsq_new;
+  v4di active;
+  v4di bailed;
+  v4di iterations;
+  int lanes;
+  int counter;
+  int pixel;
+  int i;
+  int j;
+  int n;
+
+  bailout = VEC4(julia ? MAX(4.0, a*a + b*b) : 4.0);
+
+  for (j = 0; j < tile->unresolved; j += SIMD_WIDTH)
+  {
+    if (render_request_is_stale(request))
+      return;
+
+    //Lanes past the end of the table repeat the last entry
+    lanes = MIN(SIMD_WIDTH, tile->unresolved - j);
+
+    for (i = 0; i < SIMD_WIDTH; i++)
+    {
+      n = j + MIN(i, lanes - 1);
+      pixel = tile->orbit_pixels[n];
+
+      lane[0][i] = tile->orbit_re[n];
+      lane[1][i] = tile->orbit_im[n];
+      lane[2][i] = julia ? a : DOUBLE_PIXEL_RE((tile->x + pixel%tile->width)*
+                                               SAMPLE_SCALE);
+      lane[3][i] = julia ? b : DOUBLE_PIXEL_IM((tile->y + pixel/tile->width)*
+                                               SAMPLE_SCALE);
+    }
+
+    memcpy(&x, lane[0], sizeof(x));
+    memcpy(&y, lane[1], sizeof(y));
+    memcpy(&cr, lane[2], sizeof(cr));
+    memcpy(&ci, lane[3], sizeof(ci));
+
+    mzsq = VEC4(0.0);
+    active = VECTOR_TRUE;
+    bailed = VECTOR_FALSE;
+    iterations = VECTOR_FALSE;
+
+    for (counter = 0; counter < tile->deepen; counter++)
+    {
+      MANDEL_STEP(v4df, VECTOR);
+      mzsq_new = VECTOR_NORM(x_new, y_new);
+      iterations -= active;
+
+      bailed |= active & (mzsq_new > bailout);
+      mzsq = VECTOR_SELECT(active, mzsq_new, mzsq);
+      active &= ~bailed;
+      x = VECTOR_SELECT(active, x_new, x);
+      y = VECTOR_SELECT(active, y_new, y);
+
+      if (!VECTOR_ANY(active))
+        break;
+    }
+
+    for (i = 0; i < lanes; i++)
+    {
+      tile->counters.iterations += iterations[i];
+      tile->orbit_re[j + i] = x[i];
+      tile->orbit_im[j + i] = y[i];
+
+      //render_worker() drops the entry afterwards
+      if (bailed[i] || !(mzsq[i] < four[i]))
+      {
+        tile->pixels[tile->orbit_pixels[j + i]] = COLOR_EXTERIOR;
+        tile->counters.escaped++;
+      }
+    }
+  }
+}
+
+//Kernel for each escape-time fractal, precision and SIMD level. The user
+//formula interpreter only exists as vector double code, so it stands in
+//for the scalar entries and every precision. JuliaSine has no
+//double-double or fixed-point build and uses long double instead, and its
+//vector math is four wide, so AVX-512 runs the AVX2 build. Long double and
+//fixed point are scalar only.
+static const RenderKernel render_kernels[FRACTAL_COUNT][PRECISION_COUNT]
+                                        [SIMD_COUNT] =
+{
+  [FRACTAL_JULIA] =
+  {
+    [PRECISION_DOUBLE] =
+    {
+      {julia_double, "double"},
+      {julia_vector, "double x4"},
+      {julia_avx2, "double x4 AVX2"},
+      {julia_avx512, "double x8 AVX-512"}
+    },
+    [PRECISION_LONG_DOUBLE] =
+    {
+      {julia_long_double, "long double"},
+      {julia_long_double, "long double"},
+      {julia_long_double, "long double"},
+      {julia_long_double, "long double"}
+    },
+    [PRECISION_DOUBLE_DOUBLE] =
+    {
+      {julia_dd, "double-double"},
+      {julia_dd_vector, "double-double x4"},
+      {julia_dd_avx2, "double-double x4 AVX2"},
+      {julia_dd_avx512, "double-double x8 AVX-512"}
+    },
+    [PRECISION_FIXED64] =
+    {
+      {julia_fixed64, "fixed 64-bit"},
+      {julia_fixed64, "fixed 64-bit"},
+      {julia_fixed64, "fixed 64-bit"},
+      {julia_fixed64, "fixed 64-bit"}
+    },
+    [PRECISION_FIXED128] =
+    {
+      {julia_fixed128, "fixed 128-bit"},
+      {julia_fixed128, "fixed 128-bit"},
+      {julia_fixed128, "fixed 128-bit"},
+      {julia_fixed128, "fixed 128-bit"}
+    }
+  },
+
+  [FRACTAL_JULIASIN] =
+  {
+    [PRECISION_DOUBLE] =
+    {
+      {juliasin_double, "double"},
+      {juliasin_vector, "double x4"},
+      {juliasin_avx2, "double x4 AVX2"},
+      {juliasin_avx2, "double x4 AVX2"}
+    },
+    [PRECISION_LONG_DOUBLE] =
+    {
+      {juliasin_long_double, "long double"},
+      {juliasin_long_double, "long double"},
+      {juliasin_long_double, "long double"},
+      {juliasin_long_double, "long double"}
+    },
+    [PRECISION_DOUBLE_DOUBLE] =
+    {
+      {juliasin_long_double, "long double"},
+      {juliasin_long_double, "long double"},
+      {juliasin_long_double, "long double"},
+      {juliasin_long_double, "long double"}
+    },
+    [PRECISION_FIXED64] =
+    {
+      {juliasin_long_double, "long double"},
+      {juliasin_long_double, "long double"},
+      {juliasin_long_double, "long double"},
+      {juliasin_long_double, "long double"}
+    },
+    [PRECISION_FIXED128] =
+    {
+      {juliasin_long_double, "long double"},
+      {juliasin_long_double, "long double"},
+      {juliasin_long_double, "long double"},
+      {juliasin_long_double, "long double"}
+    }
+  },
+
+  [FRACTAL_MANDEL] =
+  {
+    [PRECISION_DOUBLE] =
+    {
+      {mandel_double, "double"},
+      {mandel_vector, "double x4"},
+      {mandel_avx2, "double x4 AVX2"},
+      {mandel_avx512, "double x8 AVX-512"}
+    },
+    [PRECISION_LONG_DOUBLE] =
+    {
+      {mandel_long_double, "long double"},
+      {mandel_long_double, "long double"},
+      {mandel_long_double, "long double"},
+      {mandel_long_double, "long double"}
+    },
+    [PRECISION_DOUBLE_DOUBLE] =
+    {
+      {mandel_dd, "double-double"},
+      {mandel_dd_vector, "double-double x4"},
+      {mandel_dd_avx2, "double-double x4 AVX2"},
+      {mandel_dd_avx512, "double-double x8 AVX-512"}
+    },
+    [PRECISION_FIXED64] =
+    {
+      {mandel_fixed64, "fixed 64-bit"},
+      {mandel_fixed64, "fixed 64-bit"},
+      {mandel_fixed64, "fixed 64-bit"},
+      {mandel_fixed64, "fixed 64-bit"}
+    },
+    [PRECISION_FIXED128] =
+    {
+      {mandel_fixed128, "fixed 128-bit"},
+      {mandel_fixed128, "fixed 128-bit"},
+      {mandel_fixed128, "fixed 128-bit"},
+      {mandel_fixed128, "fixed 128-bit"}
+    }
+  },
+
+  [FRACTAL_FORMULA] =
+  {
+    [PRECISION_DOUBLE] =
+    {
+      {user_vector, "double x4"},
+      {user_vector, "double x4"},
+      {user_avx2, "double x4 AVX2"},
+      {user_avx2, "double x4 AVX2"}
+    },
+    [PRECISION_LONG_DOUBLE] =
+    {
+      {user_vector, "double x4"},
+      {user_vector, "double x4"},
+      {user_avx2, "double x4 AVX2"},
+      {user_avx2, "double x4 AVX2"}
+    },
+    [PRECISION_DOUBLE_DOUBLE] =
+    {
+      {user_vector, "double x4"},
+      {user_vector, "double x4"},
+      {user_avx2, "double x4 AVX2"},
+      {user_avx2, "double x4 AVX2"}
+    },
+    [PRECISION_FIXED64] =
+    {
+      {user_vector, "double x4"},
+      {user_vector, "double x4"},
+      {user_avx2, "double x4 AVX2"},
+      {user_avx2, "double x4 AVX2"}
+    },
+    [PRECISION_FIXED128] =
+    {
+      {user_vector, "double x4"},
+      {user_vector, "double x4"},
+      {user_avx2, "double x4 AVX2"},
+      {user_avx2, "double x4 AVX2"}
+    }
+  }
+};
+
+//Distance estimation kernels for each SIMD level, at double precision
+static const RenderKernel distance_kernels[FRACTAL_COUNT][SIMD_COUNT] =
+{
+  [FRACTAL_JULIA] =
+  {
+    {julia_distance_double, "double, distance"},
+    {julia_distance_vector, "double x4, distance"},
+    {julia_distance_avx2, "double x4 AVX2, distance"},
+    {julia_distance_avx512, "double x8 AVX-512, distance"}
+  },
+  [FRACTAL_MANDEL] =
+  {
+    {mandel_distance_double, "double, distance"},
+    {mandel_distance_vector, "double x4, distance"},
+    {mandel_distance_avx2, "double x4 AVX2, distance"},
+    {mandel_distance_avx512, "double x8 AVX-512, distance"}
+  }
+};
+
+//The kernel that computes the tiles of a request, or NULL for the
+//attractors
+static const RenderKernel *render_kernel(FractalType type,
+                                         RenderPrecision precision,
+                                         RenderSimd simd)
+{
+  if (render_kernels[type][precision][simd].run == NULL)
+    return NULL;
+
+  return &render_kernels[type][precision][simd];
+}
+
+//The distance estimation kernel of a request, or NULL when it is off or
+//there is none for the fractal and precision
+static const RenderKernel *render_distance_kernel(RenderRequest *request)
+{
+  if (!request->distance || request->precision != PRECISION_DOUBLE ||
+      distance_kernels[request->type][request->simd].run == NULL)
+    return NULL;
+
+  return &distance_kernels[request->type][request->simd];
+}
+
+//Picks the widest vector kernels the CPU runs; the AVX-512 builds do
+//twice the pixels of the AVX2 ones per instruction. FRACTAL_SIMD=scalar,
+//vector, avx2 or avx512 overrides the choice, for comparing them.
+static void render_init_simd(void)
+{
+  const gchar *name;
+  int i;
+
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+  {
+    render_simd_best = SIMD_AVX2;
+    if (__builtin_cpu_supports("avx512f"))
+      render_simd_best = SIMD_AVX512;
+  }
+#endif
+
+  render_simd = render_simd_best;
+
+  name = g_getenv("FRACTAL_SIMD");
+  if (name == NULL)
+    return;
+
+  for (i = 0; i < SIMD_COUNT; i++)
+  {
+    if (g_ascii_strcasecmp(name, simd_names[i]) == 0)
+      break;
+  }
+
+  if (i == SIMD_COUNT || i > render_simd_best)
+    g_warning("FRACTAL_SIMD=%s is not available, using %s",
+              name, simd_names[render_simd]);
+  else
+    render_simd = i;
+}
+
+//Sets the view to a Mandelbrot view such as those of benchmark_views
+static void set_benchmark_view(const BenchmarkView *view)
+{
+  view_type = FRACTAL_MANDEL;
+  view_julia_style = FALSE;
+  view_zoom = view->zoom;
+  view_center_re = fixed128_from(view->re, VIEW_BITS);
+  view_center_im = fixed128_from(view->im, VIEW_BITS);
+}
+
+//Renders a fractal at the current view with one kernel on the render
+//threads, one sample per pixel, and waits for the whole image. Attractors
+//are drawn as COLOR_INTERIOR points on COLOR_EXTERIOR.
+static guint32 *render_image(FractalType type, RenderPrecision precision,
+                             RenderSimd simd)
+{
+  RenderRequest *request;
+  guint32 *image;
+
+  request = render_request_new(type, precision);
+  request->simd = simd;
+  image = render_request_image(request);
+  render_request_unref(request);
+
+  return image;
+}
+
+//Renders a request as render_image() does, with one sample per pixel
+//whatever the menu says, and returns the image
+static guint32 *render_request_image(RenderRequest *request)
+{
+  RenderTile *tile;
+  guint32 *image;
+  gboolean finished;
+
+  request->antialias = FALSE;
+  request->distance = FALSE;
+  request->inverse = FALSE;
+  image = g_new(guint32, request->width*request->height);
+
+  render_request_queue(request, image);
+
+  //As in render_flush(), tiles_pending is read before the results are
+  //drained
+  do
+  {
+    finished = g_atomic_int_get(&request->tiles_pending) == 0;
+
+    while ((tile = g_async_queue_timeout_pop(render_request_results(request),
+                                             finished ? 0 : 1000)) != NULL)
+    {
+      render_image_add_tile(image, tile);
+      render_tile_free(tile);
+    }
+  }
+  while (!finished);
+
+  return image;
+}
+
+//Queues all of a request on the render threads, without symmetry, for an
+//image of its size: escape-time fractals as tiles, the 3D Lorenz view as
+//a single one, and attractors as an orbit over a COLOR_EXTERIOR image
+static void render_request_queue(RenderRequest *request, guint32 *image)
+{
+  GPtrArray *queue;
+  int i;
+
+  if (render_kernel(request->type, request->precision, request->simd))
+  {
+    queue = g_ptr_array_new();
+    render_queue_tiles(request, queue, 0, request->width, 0, request->height);
+    render_push_tiles(queue);
+  }
+  else if (request->type == FRACTAL_LORENZ_3D)
+  {
+    lorenz_3d_setup(request, request->height);
+    request->tiles_pending = 1;
+    g_thread_pool_push(render_pool,
+                       render_tile_new(request, 0, 0, request->width,
+                                       request->height), NULL);
+  }
+  else
+  {
+    for (i = 0; i < request->width*request->height; i++)
+      image[i] = COLOR_EXTERIOR;
+
+    request->tiles_pending = 1;
+    g_thread_pool_push(render_pool, render_tile_new(request, 0, 0, 0, 0),
+                       NULL);
+  }
+}
+
+//Copies a finished tile or attractor batch into an image of the size of
+//its request
+static void render_image_add_tile(guint32 *image, RenderTile *tile)
+{
+  RenderRequest *request = tile->request;
+  int x;
+  int y;
+  int i;
+
+  if (tile->pixels)
+  {
+    for (y = 0; y < tile->height; y++)
+      memcpy(image + (tile->y + y)*request->width + tile->x,
+             tile->pixels + y*tile->width,
+             tile->width*sizeof(guint32));
+  }
+  else
+  {
+    for (i = 0; i < tile->n_points; i++)
+    {
+      x = tile->points[2*i];
+      y = tile->points[2*i + 1];
+
+      if (x >= 0 && x < request->width && y >= 0 && y < request->height)
+        image[y*request->width + x] = COLOR_INTERIOR;
+    }
+  }
+}
+
+//--benchmark: renders each view of benchmark_views at each precision on
+//the render threads. Prints the time and the number of pixels that differ
+//from the fixed 128-bit image, which has the most fraction bits.
+static int run_benchmark(void)
+{
+  const BenchmarkView *view;
+  guint32 *images[PRECISION_COUNT];
+  gint64 times[PRECISION_COUNT];
+  gint64 start;
+  gchar *name;
+  int pixels = DAWIDTH*DAHEIGHT;
+  int differ;
+  guint v;
+  int p;
+  int i;
+
+  g_print("%-12s %-14s %-24s %10s %10s %8s\n",
+          "view", "precision", "kernel", "ms", "Mpixel/s", "differ");
+
+  for (v = 0; v < G_N_ELEMENTS(benchmark_views); v++)
+  {
+    view = &benchmark_views[v];
+    set_benchmark_view(view);
+
+    for (p = 0; p < PRECISION_COUNT; p++)
+    {
+      start = g_get_monotonic_time();
+      images[p] = render_image(FRACTAL_MANDEL, p, render_simd);
+      times[p] = g_get_monotonic_time() - start;
+    }
+
+    name = g_strdup_printf("%s x%.0Le", view->name, view->zoom);
+
+    for (p = 0; p < PRECISION_COUNT; p++)
+    {
+      differ = 0;
+      for (i = 0; i < pixels; i++)
+        differ += images[p][i] != images[PRECISION_FIXED128][i];
+
+      g_print("%-12s %-14s %-24s %10.1f %10.2f %8d\n",
+              name, precision_names[p],
+              render_kernel(FRACTAL_MANDEL, p, render_simd)->name,
+              times[p]/1000.0, (gdouble)pixels/MAX(times[p], 1), differ);
+    }
+
+    for (p = 0; p < PRECISION_COUNT; p++)
+      g_free(images[p]);
+    g_free(name);
+  }
+
+  return 0;
+}
+
+//A fixed-point number with VIEW_BITS fraction bits as a reference number
+static ReferenceNumber reference_from_fixed(__int128 v)
+{
+  ReferenceNumber r;
+  unsigned __int128 m;
+  int shift = REFERENCE_FRACTION_BITS - VIEW_BITS;
+  int i;
+
+  r.negative = v < 0;
+  m = r.negative ? -(unsigned __int128)v : (unsigned __int128)v;
+
+  //m << shift, a limb at a time
+  for (i = 0; i < REFERENCE_LIMBS; i++)
+  {
+    if (64*i + 63 < shift)
+      r.limb[i] = 0;
+    else if (64*i <= shift)
+      r.limb[i] = (guint64)(m << (shift - 64*i));
+    else if (64*i - shift < 128)
+      r.limb[i] = (guint64)(m >> (64*i - shift));
+    else
+      r.limb[i] = 0;
+  }
+
+  return r;
+}
+
+static ReferenceNumber reference_add(ReferenceNumber a, ReferenceNumber b)
+{
+  ReferenceNumber r;
+  unsigned __int128 t;
+  guint64 borrow;
+  int i;
+
+  if (a.negative == b.negative)
+  {
+    r.negative = a.negative;
+    t = 0;
+    for (i = 0; i < REFERENCE_LIMBS; i++)
+    {
+      t += (unsigned __int128)a.limb[i] + b.limb[i];
+      r.limb[i] = (guint64)t;
+      t >>= 64;
+    }
+
+    return r;
+  }
+
+  //Signs differ: take the smaller magnitude from the larger
+  for (i = REFERENCE_LIMBS - 1; i > 0 && a.limb[i] == b.limb[i]; i--)
+    ;
+  if (a.limb[i] < b.limb[i])
+  {
+    r = a;
+    a = b;
+    b = r;
+  }
+
+  r.negative = a.negative;
+  borrow = 0;
+  for (i = 0; i < REFERENCE_LIMBS; i++)
+  {
+    t = (unsigned __int128)a.limb[i] - b.limb[i] - borrow;
+    r.limb[i] = (guint64)t;
+    borrow = (guint64)(t >> 64) & 1;
+  }
+
+  return r;
+}
+
+static ReferenceNumber reference_sub(ReferenceNumber a, ReferenceNumber b)
+{
+  b.negative = !b.negative;
+
+  return reference_add(a, b);
+}
+
+//Schoolbook product, cut back to REFERENCE_FRACTION_BITS. The dropped
+//bits are far below those of any kernel.
+static ReferenceNumber reference_mul(ReferenceNumber a, ReferenceNumber b)
+{
+  guint64 product[2*REFERENCE_LIMBS] = {0};
+  ReferenceNumber r;
+  unsigned __int128 t;
+  int i;
+  int j;
+
+  for (i = 0; i < REFERENCE_LIMBS; i++)
+  {
+    t = 0;
+    for (j = 0; j < REFERENCE_LIMBS; j++)
+    {
+      t += (unsigned __int128)a.limb[i]*b.limb[j] + product[i + j];
+      product[i + j] = (guint64)t;
+      t >>= 64;
+    }
+    product[i + REFERENCE_LIMBS] = (guint64)t;
+  }
+
+  r.negative = a.negative != b.negative;
+  for (i = 0; i < REFERENCE_LIMBS; i++)
+    r.limb[i] = product[i + REFERENCE_LIMBS - 1];
+
+  return r;
+}
+
+//Whether a non-negative reference number is greater than n
+static gboolean reference_exceeds(ReferenceNumber a, guint64 n)
+{
+  int i;
+
+  if (a.limb[REFERENCE_LIMBS - 1] != n)
+    return a.limb[REFERENCE_LIMBS - 1] > n;
+
+  for (i = 0; i < REFERENCE_LIMBS - 1; i++)
+  {
+    if (a.limb[i] != 0)
+      return TRUE;
+  }
+
+  return FALSE;
+}
+
+//Whether re + i*im (VIEW_BITS fraction bits) is an interior point of the
+//Mandelbrot set as the kernels decide it: |z| <= 2 for MAX_ITERATIONS
+//iterations. The orbit stays below |z| = 6, well within the integer limb.
+static gboolean reference_mandel(__int128 re, __int128 im)
+{
+  ReferenceNumber cr;
+  ReferenceNumber ci;
+  ReferenceNumber x;
+  ReferenceNumber y;
+  ReferenceNumber xx;
+  ReferenceNumber yy;
+  ReferenceNumber xy;
+  int i;
+
+  cr = reference_from_fixed(re);
+  ci = reference_from_fixed(im);
+  x = reference_from_fixed(0);
+  y = x;
+  xx = x;
+  yy = x;
+
+  for (i = 0; i < MAX_ITERATIONS; i++)
+  {
+    xy = reference_mul(x, y);
+    x = reference_add(reference_sub(xx, yy), cr);
+    y = reference_add(reference_add(xy, xy), ci);
+
+    xx = reference_mul(x, x);
+    yy = reference_mul(y, y);
+    if (reference_exceeds(reference_add(xx, yy), 4))
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+//--self-test: renders the views of benchmark_views with the double-double
+//kernel of each SIMD level the CPU runs and with fixed 128-bit, and checks
+//a grid of their pixels against reference_mandel(). Fails when a kernel
+//gets more than 1% of the samples wrong.
+static int run_self_test(void)
+{
+  const BenchmarkView *view;
+  const RenderKernel *kernel;
+  RenderRequest *request;
+  RenderPrecision precision;
+  RenderSimd simd;
+  gboolean *reference;
+  guint32 *image;
+  gchar *name;
+  gboolean failed = FALSE;
+  int columns = (DAWIDTH + SELF_TEST_SPACING - 1)/SELF_TEST_SPACING;
+  int rows = (DAHEIGHT + SELF_TEST_SPACING - 1)/SELF_TEST_SPACING;
+  int samples = columns*rows;
+  int wrong;
+  int sx;
+  int sy;
+  guint v;
+  int k;
+  int i;
+
+  reference = g_new(gboolean, samples);
+
+  g_print("%-12s %-24s %8s %8s\n", "view", "kernel", "samples", "wrong");
+
+  for (v = 0; v < G_N_ELEMENTS(benchmark_views); v++)
+  {
+    view = &benchmark_views[v];
+    set_benchmark_view(view);
+    name = g_strdup_printf("%s x%.0Le", view->name, view->zoom);
+
+    //The pixels' coordinates, as the double-double and fixed-point
+    //kernels take them
+    request = render_request_new(FRACTAL_MANDEL, PRECISION_FIXED128);
+    for (i = 0; i < samples; i++)
+    {
+      sx = (i % columns)*SELF_TEST_SPACING;
+      sy = (i/columns)*SELF_TEST_SPACING;
+      reference[i] =
+        reference_mandel(fixed_view_point(request->view_re_min,
+                                          request->view_step_x,
+                                          sx*SAMPLE_SCALE, VIEW_BITS),
+                         fixed_view_point(request->view_im_max,
+                                          -request->view_step_y,
+                                          sy*SAMPLE_SCALE, VIEW_BITS));
+    }
+    render_request_unref(request);
+
+    //Double-double at SIMD_SCALAR .. render_simd_best, then fixed 128-bit
+    for (k = 0; k <= render_simd_best + 1; k++)
+    {
+      precision = k <= render_simd_best ? PRECISION_DOUBLE_DOUBLE :
+                                          PRECISION_FIXED128;
+      simd = k <= render_simd_best ? k : SIMD_SCALAR;
+      kernel = render_kernel(FRACTAL_MANDEL, precision, simd);
+      image = render_image(FRACTAL_MANDEL, precision, simd);
+
+      wrong = 0;
+      for (i = 0; i < samples; i++)
+      {
+        sx = (i % columns)*SELF_TEST_SPACING;
+        sy = (i/columns)*SELF_TEST_SPACING;
+        wrong += (image[sy*DAWIDTH + sx] == COLOR_INTERIOR) != reference[i];
+      }
+
+      g_print("%-12s %-24s %8d %8d%s\n", name, kernel->name, samples, wrong,
+              wrong*100 > samples ? "  FAILED" : "");
+      failed |= wrong*100 > samples;
+
+      g_free(image);
+    }
+
+    g_free(name);
+  }
+
+  g_free(reference);
+
+  return failed ? 1 : 0;
+}
+
+//Scales an image down to the --check cells: the mean of the red, green
+//and blue of the pixels of each, as 0 (COLOR_INTERIOR) to 15
+//(COLOR_EXTERIOR or brighter), rounded
+static void check_cells(const guint32 *image, guint8 *cells)
+{
+  const gint64 full = (gint64)3*(COLOR_EXTERIOR & 0xff)*
+                      CHECK_SCALE*CHECK_SCALE;
+  gint64 *sums;
+  guint32 pixel;
+  int x;
+  int y;
+  int i;
+
+  sums = g_new0(gint64, CHECK_ROWS*CHECK_COLUMNS);
+
+  for (y = 0; y < DAHEIGHT; y++)
+  {
+    for (x = 0; x < DAWIDTH; x++)
+    {
+      pixel = image[y*DAWIDTH + x];
+      sums[(y/CHECK_SCALE)*CHECK_COLUMNS + x/CHECK_SCALE] +=
+        ((pixel >> 16) & 0xff) + ((pixel >> 8) & 0xff) + (pixel & 0xff);
+    }
+  }
+
+  for (i = 0; i < CHECK_ROWS*CHECK_COLUMNS; i++)
+    cells[i] = MIN(15, (sums[i]*15*2 + full)/(full*2));
+
+  g_free(sums);
+}
+
+//Renders a --check case at one precision CHECK_RUNS times, compares the
+//image with the golden one cell by cell and the best time with the
+//baseline, and prints the result. A time missing from the baseline is
+//added to it. Returns FALSE on a failure.
+static gboolean check_case(const CheckCase *check, RenderPrecision precision,
+                           GKeyFile *baseline, gboolean *recorded)
+{
+  const RenderKernel *kernel;
+  guint32 *image = NULL;
+  gchar *key;
+  gint64 start;
+  gint64 best = G_MAXINT64;
+  gdouble milliseconds;
+  gdouble recorded_milliseconds = 0;
+  gboolean slower = FALSE;
+  guint8 cells[CHECK_ROWS*CHECK_COLUMNS];
+  int golden;
+  int differ = 0;
+  int i;
+
+  kernel = render_kernel(check->type, precision, render_simd);
+
+  for (i = 0; i < CHECK_RUNS; i++)
+  {
+    g_free(image);
+    start = g_get_monotonic_time();
+    image = render_image(check->type, precision, render_simd);
+    best = MIN(best, g_get_monotonic_time() - start);
+  }
+  milliseconds = best/1000.0;
+
+  check_cells(image, cells);
+  for (i = 0; i < CHECK_ROWS*CHECK_COLUMNS; i++)
+  {
+    golden = g_ascii_xdigit_value(check->cells[i]);
+    if (ABS(cells[i] - golden) > 1)
+      differ++;
+  }
+  g_free(image);
+
+  if (baseline)
+  {
+    key = g_strdup_printf("%s %s", fractal_names[check->type],
+                          kernel ? kernel->name : "orbit");
+    g_strdelimit(key, " ", '_');
+
+    if (g_key_file_has_key(baseline, "baseline", key, NULL))
+    {
+      recorded_milliseconds = g_key_file_get_double(baseline, "baseline",
+                                                    key, NULL);
+      slower = milliseconds > recorded_milliseconds*
+                              (100 + check_max_slowdown)/100;
+    }
+    else
+    {
+      g_key_file_set_double(baseline, "baseline", key, milliseconds);
+      *recorded = TRUE;
+    }
+
+    g_free(key);
+  }
+
+  g_print("%-12s %-24s %8d %10.1f %10.1f%s%s\n", fractal_names[check->type],
+          kernel ? kernel->name : "orbit", differ, milliseconds,
+          recorded_milliseconds,
+          differ > CHECK_TOLERANCE*CHECK_ROWS*CHECK_COLUMNS ? "  DIFFERS"
+                                                            : "",
+          slower ? "  SLOWER" : "");
+
+  return differ <= CHECK_TOLERANCE*CHECK_ROWS*CHECK_COLUMNS && !slower;
+}
+
+//--check: renders each of check_cases with every kernel of the fractal at
+//the SIMD level in use (the attractors once) and checks them with
+//check_case()
+static int run_check(void)
+{
+  const CheckCase *check;
+  const RenderKernel *kernel;
+  const RenderKernel *other;
+  GKeyFile *baseline = NULL;
+  GError *error = NULL;
+  gboolean recorded = FALSE;
+  gboolean failed = FALSE;
+  guint c;
+  int p;
+  int q;
+
+  if (check_baseline)
+  {
+    baseline = g_key_file_new();
+
+    if (g_file_test(check_baseline, G_FILE_TEST_EXISTS) &&
+        !g_key_file_load_from_file(baseline, check_baseline,
+                                   G_KEY_FILE_NONE, &error))
+    {
+      g_printerr("%s\n", error->message);
+      g_error_free(error);
+      g_key_file_free(baseline);
+      return 1;
+    }
+  }
+
+  g_print("%-12s %-24s %8s %10s %10s\n",
+          "fractal", "kernel", "differ", "ms", "baseline");
+
+  for (c = 0; c < G_N_ELEMENTS(check_cases); c++)
+  {
+    check = &check_cases[c];
+    parameter_a = check->parameter_a;
+    parameter_b = check->parameter_b;
+    view_type = FRACTAL_COUNT;
+
+    for (p = 0; p < PRECISION_COUNT; p++)
+    {
+      //Precisions without a kernel of their own fall back on another's
+      kernel = render_kernel(check->type, p, render_simd);
+      for (q = 0; q < p; q++)
+      {
+        other = render_kernel(check->type, q, render_simd);
+        if (other == kernel || (other && kernel && other->run == kernel->run))
+          break;
+      }
+
+      if (q == p)
+        failed |= !check_case(check, p, baseline, &recorded);
+    }
+  }
+
+  if (recorded && !g_key_file_save_to_file(baseline, check_baseline, &error))
+  {
+    g_printerr("%s\n", error->message);
+    g_error_free(error);
+    failed = TRUE;
+  }
+
+  if (baseline)
+    g_key_file_free(baseline);
+
+  return failed ? 1 : 0;
+}
+
+//Zoom video
+
+//The fastest precision that still tells the pixels of a keyframe at
+//this magnification apart, from --benchmark
+static RenderPrecision zoom_video_precision(long double zoom)
+{
+  if (zoom < 1e10)
+    return PRECISION_DOUBLE;
+  if (zoom < 1e13)
+    return PRECISION_LONG_DOUBLE;
+  if (zoom < 1e27)
+    return PRECISION_DOUBLE_DOUBLE;
+
+  return PRECISION_FIXED128;
+}
+
+//Blends two RGB24 colors, weight/256 of the way from a to b
+static inline guint32 zoom_video_blend(guint32 a, guint32 b, guint32 weight)
+{
+  guint32 rb;
+  guint32 g;
+
+  rb = ((a & 0xff00ff)*(256 - weight) + (b & 0xff00ff)*weight) >> 8;
+  g = ((a & 0x00ff00)*(256 - weight) + (b & 0x00ff00)*weight) >> 8;
+
+  return (rb & 0xff00ff) | (g & 0x00ff00);
+}
+
+//Scales the keyframe into the frame with bilinear interpolation, about
+//their common center. A frame pixel is x_ratio (y_ratio) keyframe pixels
+//wide (high). The columns and weights are worked out once per frame, and
+//the blending is done in 8-bit fixed point.
+static void zoom_video_resample(const guint32 *keyframe, int key_width,
+                                int key_height, guint32 *frame, int width,
+                                int height, double x_ratio, double y_ratio)
+{
+  const guint32 *row0;
+  const guint32 *row1;
+  guint32 *out;
+  int *columns;
+  guint32 *x_weights;
+  guint32 y_weight;
+  double position;
+  int row;
+  int x;
+  int y;
+
+  columns = g_new(int, width);
+  x_weights = g_new(guint32, width);
+
+  for (x = 0; x < width; x++)
+  {
+    position = CLAMP(key_width/2 + (x - width/2)*x_ratio, 0, key_width - 2);
+    columns[x] = (int)position;
+    x_weights[x] = (guint32)((position - columns[x])*256);
+  }
+
+  for (y = 0; y < height; y++)
+  {
+    position = CLAMP(key_height/2 + (y - height/2)*y_ratio,
+                     0, key_height - 2);
+    row = (int)position;
+    y_weight = (guint32)((position - row)*256);
+    row0 = keyframe + row*key_width;
+    row1 = row0 + key_width;
+    out = frame + y*width;
+
+    for (x = 0; x < width; x++)
+      out[x] = zoom_video_blend(
+                 zoom_video_blend(row0[columns[x]], row0[columns[x] + 1],
+                                  x_weights[x]),
+                 zoom_video_blend(row1[columns[x]], row1[columns[x] + 1],
+                                  x_weights[x]),
+                 y_weight);
+  }
+
+  g_free(x_weights);
+  g_free(columns);
+}
+
+//--zoom-video: zooms from the initial view of the Mandelbrot set into
+//--zoom-center, by the same factor from one frame to the next. Keyframe k
+//shows the view at zoom 2^k with ZOOM_VIDEO_SCALE times the pixels, and
+//the frames with zooms from 2^k up to 2^(k+1) are scaled down from it,
+//by no more than ZOOM_VIDEO_SCALE times, so no frame is blown up. Only
+//the current keyframe is kept.
+static int run_zoom_video(const gchar *directory)
+{
+  BenchmarkView view = {"zoom", 0.0, 0.0, 1.0};
+  RenderRequest *request = NULL;
+  cairo_surface_t *image;
+  cairo_status_t status;
+  gchar **center;
+  gchar *filename;
+  guint32 *keyframe = NULL;
+  guint32 *frame;
+  long double zoom;
+  long double key_zoom = 0;
+  gint64 render_time = 0;
+  gint64 write_time = 0;
+  gint64 start;
+  double x_ratio;
+  double y_ratio;
+  int width = DAWIDTH;
+  int height = DAHEIGHT;
+  int keyframes = 0;
+  int key;
+  int i;
+
+  center = g_strsplit(zoom_video_center ? zoom_video_center
+                                        : ZOOM_VIDEO_CENTER, ",", 2);
+  if (center[0] == NULL || center[1] == NULL || zoom_video_depth < 1 ||
+      zoom_video_frames < 2)
+  {
+    g_printerr("--zoom-center must be RE,IM, --zoom-depth at least 1 and "
+               "--zoom-frames at least 2\n");
+    g_strfreev(center);
+    return 1;
+  }
+  view.re = g_ascii_strtod(center[0], NULL);
+  view.im = g_ascii_strtod(center[1], NULL);
+  g_strfreev(center);
+
+  if (g_mkdir_with_parents(directory, 0755) != 0)
+  {
+    g_printerr("Cannot create %s: %s\n", directory, g_strerror(errno));
+    return 1;
+  }
+
+  frame = g_new(guint32, width*height);
+
+  for (i = 0; i < zoom_video_frames; i++)
+  {
+    zoom = powl(zoom_video_depth, (long double)i/(zoom_video_frames - 1));
+    key = (int)floorl(log2l(zoom));
+
+    if (keyframe == NULL || ldexpl(1.0, key) != key_zoom)
+    {
+      g_free(keyframe);
+      if (request)
+        render_request_unref(request);
+
+      start = g_get_monotonic_time();
+      key_zoom = ldexpl(1.0, key);
+      view.zoom = key_zoom;
+      set_benchmark_view(&view);
+
+      //The same view as a frame at key_zoom, with more pixels
+      request = render_request_new(FRACTAL_MANDEL,
+                                   zoom_video_precision(key_zoom));
+      request->width = ZOOM_VIDEO_SCALE*width;
+      request->height = ZOOM_VIDEO_SCALE*height;
+      request->fixed_bits = render_fixed_bits(request->precision);
+      render_set_view(request);
+      keyframe = render_request_image(request);
+
+      render_time += g_get_monotonic_time() - start;
+      keyframes++;
+    }
+
+    //Pixel (x, y) of the frame is the point (x - width/2)/x_scale right
+    //of the center, and the same goes for the keyframe
+    start = g_get_monotonic_time();
+    x_ratio = (double)(request->x_scale/((width/5)*zoom));
+    y_ratio = (double)(request->y_scale/((height/3)*zoom));
+
+    zoom_video_resample(keyframe, request->width, request->height,
+                        frame, width, height, x_ratio, y_ratio);
+
+    image = cairo_image_surface_create_for_data((unsigned char *)frame,
+                                                CAIRO_FORMAT_RGB24,
+                                                width, height, width*4);
+    filename = g_strdup_printf("%s/frame%05d.png", directory, i);
+    status = cairo_surface_write_to_png(image, filename);
+    cairo_surface_destroy(image);
+    write_time += g_get_monotonic_time() - start;
+
+    if (status != CAIRO_STATUS_SUCCESS)
+    {
+      g_printerr("Cannot write %s: %s\n", filename,
+                 cairo_status_to_string(status));
+      g_free(filename);
+      break;
+    }
+    g_free(filename);
+  }
+
+  g_print("%d frames to zoom %.3g from %d keyframes: %.2f s rendering, "
+          "%.2f s resampling and writing\n",
+          i, zoom_video_depth, keyframes, render_time/1e6, write_time/1e6);
+
+  if (request)
+    render_request_unref(request);
+  g_free(keyframe);
+  g_free(frame);
+  return i == zoom_video_frames ? 0 : 1;
+}
+
+//Render jobs
+
+//Adds the actions of the render job queue to the application, which
+//exports them on D-Bus. Runs on "startup", once, so that the actions are
+//there when the application is started only to activate one of them.
+static void render_jobs_init(GApplication *app, gpointer data)
+{
+  GSimpleAction *action;
+
+  render_jobs = g_ptr_array_new();
+
+  action = g_simple_action_new("render", G_VARIANT_TYPE_VARDICT);
+  g_signal_connect(action, "activate", G_CALLBACK(render_job_activate), NULL);
+  g_action_map_add_action(G_ACTION_MAP(app), G_ACTION(action));
+  g_object_unref(action);
+
+  action = g_simple_action_new("cancel", G_VARIANT_TYPE_UINT32);
+  g_signal_connect(action, "activate", G_CALLBACK(render_job_cancel), NULL);
+  g_action_map_add_action(G_ACTION_MAP(app), G_ACTION(action));
+  g_object_unref(action);
+
+  render_jobs_action = g_simple_action_new_stateful("jobs", NULL,
+                         g_variant_new_array(G_VARIANT_TYPE("(ussd)"),
+                                             NULL, 0));
+  g_signal_connect(render_jobs_action, "change-state",
+                   G_CALLBACK(render_jobs_change_state), NULL);
+  g_action_map_add_action(G_ACTION_MAP(app), G_ACTION(render_jobs_action));
+}
+
+//Queues a job from the options of the "render" action; see the comments
+//at the top for them
+static void render_job_activate(GSimpleAction *action, GVariant *parameter,
+                                gpointer data)
+{
+  RenderJob *job;
+  RenderRequest *request;
+  Formula *formula = NULL;
+  FractalType type = FRACTAL_MANDEL;
+  RenderPrecision precision = render_precision;
+  __int128 center_re;
+  __int128 center_im;
+  const gchar *output;
+  const gchar *name;
+  const gchar *start = "0";
+  gboolean julia_style = FALSE;
+  GError *error = NULL;
+  double a = parameter_a;
+  double b = parameter_b;
+  double re;
+  double im;
+  double zoom = 1.0;
+  gint priority = 0;
+  int width = DAWIDTH;
+  int height = DAHEIGHT;
+  int i;
+
+  if (!g_variant_lookup(parameter, "output", "&s", &output))
+  {
+    g_printerr("render: no output\n");
+    return;
+  }
+
+  if (g_variant_lookup(parameter, "fractal", "&s", &name))
+  {
+    for (i = 0; i < FRACTAL_COUNT && strcmp(name, fractal_names[i]); i++)
+      ;
+    if (i == FRACTAL_COUNT)
+    {
+      g_printerr("render: no fractal %s\n", name);
+      return;
+    }
+    type = i;
+  }
+
+  if (g_variant_lookup(parameter, "precision", "&s", &name))
+  {
+    for (i = 0; i < PRECISION_COUNT && strcmp(name, precision_names[i]); i++)
+      ;
+    if (i == PRECISION_COUNT)
+    {
+      g_printerr("render: no precision %s\n", name);
+      return;
+    }
+    precision = i;
+  }
+
+  g_variant_lookup(parameter, "a", "d", &a);
+  g_variant_lookup(parameter, "b", "d", &b);
+  g_variant_lookup(parameter, "zoom", "d", &zoom);
+  g_variant_lookup(parameter, "width", "i", &width);
+  g_variant_lookup(parameter, "height", "i", &height);
+  g_variant_lookup(parameter, "priority", "i", &priority);
+
+  if (width < 5 || height < 3 || width > 16384 || height > 16384 ||
+      !(zoom > 0))
+  {
+    g_printerr("render: bad size or zoom\n");
+    return;
+  }
+
+  if (g_variant_lookup(parameter, "formula", "&s", &name))
+  {
+    g_variant_lookup(parameter, "start", "&s", &start);
+    g_variant_lookup(parameter, "julia-style", "b", &julia_style);
+
+    formula = formula_new(name, start, julia_style, &error);
+    if (formula == NULL)
+    {
+      g_printerr("render: %s\n", error->message);
+      g_error_free(error);
+      return;
+    }
+    type = FRACTAL_FORMULA;
+  }
+  else if (type == FRACTAL_FORMULA)
+  {
+    g_printerr("render: no formula\n");
+    return;
+  }
+
+  request = render_request_alloc(type, precision, width, height);
+  request->parameter_a = a;
+  request->parameter_b = b;
+  request->formula = formula;
+  request->results = g_async_queue_new();
+
+  render_initial_center(request, &center_re, &center_im);
+  if (g_variant_lookup(parameter, "re", "d", &re))
+    center_re = fixed128_from(re, VIEW_BITS);
+  if (g_variant_lookup(parameter, "im", "d", &im))
+    center_im = fixed128_from(im, VIEW_BITS);
+  render_set_center(request, center_re, center_im, zoom);
+
+  job = g_new0(RenderJob, 1);
+  job->id = ++render_job_last_id;
+  job->priority = priority;
+  job->output = g_strdup(output);
+  job->request = request;
+  g_ptr_array_add(render_jobs, job);
+
+  //Released once the job is over, so that a client can start the
+  //application only to render
+  g_application_hold(g_application_get_default());
+
+  g_queue_insert_sorted(&render_job_queue, job, render_job_compare, NULL);
+  render_job_next();
+  render_jobs_publish();
+}
+
+//Cancels a job by id, whether it is waiting or running
+static void render_job_cancel(GSimpleAction *action, GVariant *parameter,
+                              gpointer data)
+{
+  RenderJob *job = NULL;
+  guint id;
+  guint i;
+
+  id = g_variant_get_uint32(parameter);
+  for (i = 0; i < render_jobs->len && job == NULL; i++)
+    if (((RenderJob *)g_ptr_array_index(render_jobs, i))->id == id)
+      job = g_ptr_array_index(render_jobs, i);
+
+  if (job == NULL)
+    return;
+
+  if (job->state == RENDER_JOB_QUEUED)
+  {
+    g_queue_remove(&render_job_queue, job);
+    render_request_unref(job->request);
+    job->request = NULL;
+    job->state = RENDER_JOB_CANCELLED;
+    render_jobs_prune();
+    g_application_release(g_application_get_default());
+  }
+  else if (job->state == RENDER_JOB_RUNNING)
+  {
+    //render_job_flush() still collects what is in flight, and retires it
+    g_atomic_int_set(&job->request->cancelled, TRUE);
+    job->state = RENDER_JOB_CANCELLED;
+  }
+  else
+  {
+    return;
+  }
+
+  render_jobs_publish();
+}
+
+//The job list is read only for clients
+static void render_jobs_change_state(GSimpleAction *action, GVariant *value,
+                                     gpointer data)
+{
+}
+
+//Higher priority first, then the order they came in
+static gint render_job_compare(gconstpointer a, gconstpointer b,
+                               gpointer data)
+{
+  const RenderJob *job_a = a;
+  const RenderJob *job_b = b;
+
+  if (job_a->priority != job_b->priority)
+    return job_b->priority - job_a->priority;
+
+  return job_a->id - job_b->id;
+}
+
+//Starts the next job unless one is running
+static void render_job_next(void)
+{
+  RenderJob *job;
+
+  if (render_job_running || g_queue_is_empty(&render_job_queue))
+    return;
+
+  job = g_queue_pop_head(&render_job_queue);
+  job->state = RENDER_JOB_RUNNING;
+  job->image = g_new(guint32, job->request->width*job->request->height);
+  render_job_running = job;
+
+  render_request_queue(job->request, job->image);
+  job->tiles = job->request->tiles_pending;
+
+  if (render_job_flush_id == 0)
+    render_job_flush_id = g_timeout_add(16, render_job_flush, NULL);
+}
+
+//Collects the tiles of the running job as render_flush() does for the
+//window, and writes the image once they are all in
+static gboolean render_job_flush(gpointer data)
+{
+  RenderJob *job = render_job_running;
+  RenderRequest *request = job->request;
+  RenderTile *tile;
+  cairo_surface_t *image;
+  cairo_status_t status;
+  gboolean finished;
+
+  finished = g_atomic_int_get(&request->tiles_pending) == 0;
+
+  while ((tile = g_async_queue_try_pop(request->results)) != NULL)
+  {
+    if (!render_request_is_stale(request))
+      render_image_add_tile(job->image, tile);
+    render_tile_free(tile);
+  }
+
+  if (!finished)
+  {
+    render_jobs_publish();
+    return G_SOURCE_CONTINUE;
+  }
+
+  if (job->state == RENDER_JOB_RUNNING)
+  {
+    image = cairo_image_surface_create_for_data((guchar *)job->image,
+                                                CAIRO_FORMAT_RGB24,
+                                                request->width,
+                                                request->height,
+                                                request->width*4);
+    status = cairo_surface_write_to_png(image, job->output);
+    cairo_surface_destroy(image);
+
+    if (status == CAIRO_STATUS_SUCCESS)
+    {
+      job->state = RENDER_JOB_DONE;
+    }
+    else
+    {
+      g_printerr("%s: %s\n", job->output, cairo_status_to_string(status));
+      job->state = RENDER_JOB_FAILED;
+    }
+  }
+
+  g_free(job->image);
+  job->image = NULL;
+  render_request_unref(request);
+  job->request = NULL;
+  render_job_running = NULL;
+  render_jobs_prune();
+  g_application_release(g_application_get_default());
+
+  render_job_next();
+  render_jobs_publish();
+
+  if (render_job_running)
+    return G_SOURCE_CONTINUE;
+
+  render_job_flush_id = 0;
+  return G_SOURCE_REMOVE;
+}
+
+//Sets the state of the "jobs" action, which D-Bus clients read, from the
+//job list
+static void render_jobs_publish(void)
+{
+  GVariantBuilder builder;
+  RenderJob *job;
+  double progress;
+  guint i;
+
+  g_variant_builder_init(&builder, G_VARIANT_TYPE("a(ussd)"));
+
+  for (i = 0; i < render_jobs->len; i++)
+  {
+    job = g_ptr_array_index(render_jobs, i);
+
+    if (job->state == RENDER_JOB_DONE)
+      progress = 1.0;
+    else if (job->state == RENDER_JOB_RUNNING && job->tiles > 0)
+      progress = 1.0 - (double)g_atomic_int_get(&job->request->tiles_pending)/
+                       job->tiles;
+    else
+      progress = 0.0;
+
+    g_variant_builder_add(&builder, "(ussd)", job->id, job->output,
+                          render_job_state_names[job->state], progress);
+  }
+
+  g_simple_action_set_state(render_jobs_action,
+                            g_variant_builder_end(&builder));
+}
+
+//Drops the oldest jobs that are over beyond RENDER_JOBS_HISTORY of them
+static void render_jobs_prune(void)
+{
+  RenderJob *job;
+  guint over = 0;
+  guint i;
+
+  for (i = render_jobs->len; i-- > 0;)
+  {
+    job = g_ptr_array_index(render_jobs, i);
+    if (job->state == RENDER_JOB_QUEUED || job == render_job_running)
+      continue;
+
+    if (++over > RENDER_JOBS_HISTORY)
+    {
+      g_ptr_array_remove_index(render_jobs, i);
+      g_free(job->output);
+      g_free(job);
+    }
+  }
+}
+
+//Retires the running job and drops the waiting ones, before the render
+//threads are shut down. The application is gone by then, so there is no
+//hold to release.
+static void render_jobs_cancel_all(void)
+{
+  RenderJob *job;
+
+  if (render_jobs == NULL)
+    return;
+
+  while ((job = g_queue_pop_head(&render_job_queue)) != NULL)
+  {
+    render_request_unref(job->request);
+    job->request = NULL;
+  }
+
+  if (render_job_running)
+    g_atomic_int_set(&render_job_running->request->cancelled, TRUE);
+}
+
+//UI benchmark
+
+//--ui-benchmark: takes over event dispatch to time the synthetic events
+//and starts injecting them
+static void ui_benchmark_start(GtkWidget *drawing_area)
+{
+  ui_benchmark->drawing_area = drawing_area;
+  ui_benchmark->handled_latency = g_array_new(FALSE, FALSE, sizeof(gint64));
+  ui_benchmark->frame_latency = g_array_new(FALSE, FALSE, sizeof(gint64));
+
+  gdk_event_handler_set(ui_benchmark_event, NULL, NULL);
+  g_signal_connect(gtk_widget_get_frame_clock(drawing_area), "after-paint",
+                   G_CALLBACK(ui_benchmark_after_paint), NULL);
+  g_timeout_add(UI_BENCHMARK_INTERVAL, ui_benchmark_tick, NULL);
+}
+
+//Queues a pointer event on the drawing area as if it came from the
+//display server
+static void ui_benchmark_put(GdkEventType type, int x, int y, guint button)
+{
+  GdkDisplay *display;
+  GdkWindow *window;
+  GdkEvent *event;
+
+  display = gdk_display_get_default();
+  window = gtk_widget_get_window(ui_benchmark->drawing_area);
+  event = gdk_event_new(type);
+
+  if (type == GDK_MOTION_NOTIFY)
+  {
+    event->motion.window = g_object_ref(window);
+    event->motion.send_event = TRUE;
+    event->motion.time = GDK_CURRENT_TIME;
+    event->motion.x = x;
+    event->motion.y = y;
+  }
+  else
+  {
+    event->button.window = g_object_ref(window);
+    event->button.send_event = TRUE;
+    event->button.time = GDK_CURRENT_TIME;
+    event->button.x = x;
+    event->button.y = y;
+    event->button.button = button;
+  }
+
+  gdk_event_set_device(event,
+      gdk_seat_get_pointer(gdk_display_get_default_seat(display)));
+  gdk_display_put_event(display, event);
+  gdk_event_free(event);
+}
+
+//Timeout: keeps a render in flight and queues the next event once the
+//last one has reached the screen. Clicks alternate between zooming in
+//and out, so the view stays near the initial one.
+static gboolean ui_benchmark_tick(gpointer data)
+{
+  int x;
+  int y;
+
+  if (render_flush_id == 0)
+    render_start(ui_benchmark->drawing_area, FRACTAL_MANDEL);
+
+  if (ui_benchmark->queued_time != 0)
+    return G_SOURCE_CONTINUE;
+
+  if (ui_benchmark->events == UI_BENCHMARK_EVENTS)
+  {
+    ui_benchmark_finish();
+    return G_SOURCE_REMOVE;
+  }
+
+  x = g_random_int_range(0, DAWIDTH);
+  y = g_random_int_range(0, DAHEIGHT);
+  ui_benchmark->events++;
+  ui_benchmark->queued_time = g_get_monotonic_time();
+
+  if (ui_benchmark->events % UI_BENCHMARK_CLICK == 0)
+  {
+    ui_benchmark->clicks++;
+    ui_benchmark_put(GDK_BUTTON_PRESS, x, y,
+                     ui_benchmark->clicks % 2 ? GDK_BUTTON_PRIMARY
+                                              : GDK_BUTTON_SECONDARY);
+    ui_benchmark_put(GDK_BUTTON_RELEASE, x, y,
+                     ui_benchmark->clicks % 2 ? GDK_BUTTON_PRIMARY
+                                              : GDK_BUTTON_SECONDARY);
+  }
+  else
+  {
+    ui_benchmark_put(GDK_MOTION_NOTIFY, x, y, 0);
+  }
+
+  return G_SOURCE_CONTINUE;
+}
+
+//Event handler while the benchmark runs: dispatches every event as GTK
+//would, and times the first synthetic one after each is queued. The
+//frame that follows is forced, since a motion event draws nothing.
+static void ui_benchmark_event(GdkEvent *event, gpointer data)
+{
+  gboolean timed;
+
+  timed = (event->type == GDK_MOTION_NOTIFY ||
+           event->type == GDK_BUTTON_PRESS) &&
+          event->any.send_event && ui_benchmark->queued_time != 0 &&
+          ui_benchmark->handled_time == 0;
+
+  gtk_main_do_event(event);
+
+  if (timed)
+  {
+    ui_benchmark->handled_time = g_get_monotonic_time();
+    gtk_widget_queue_draw(ui_benchmark->drawing_area);
+  }
+}
+
+//Frame clock callback: the frame painted after the outstanding event was
+//handled completes it
+static void ui_benchmark_after_paint(GdkFrameClock *clock, gpointer data)
+{
+  gint64 latency;
+
+  if (ui_benchmark->handled_time == 0)
+    return;
+
+  latency = ui_benchmark->handled_time - ui_benchmark->queued_time;
+  g_array_append_val(ui_benchmark->handled_latency, latency);
+  latency = g_get_monotonic_time() - ui_benchmark->queued_time;
+  g_array_append_val(ui_benchmark->frame_latency, latency);
+
+  ui_benchmark->queued_time = 0;
+  ui_benchmark->handled_time = 0;
+}
+
+static gint ui_benchmark_compare(gconstpointer a, gconstpointer b)
+{
+  gint64 latency_a = *(const gint64 *)a;
+  gint64 latency_b = *(const gint64 *)b;
+
+  return (latency_a > latency_b) - (latency_a < latency_b);
+}
+
+//Prints the percentiles of a latency array, which it sorts
+static void ui_benchmark_print(const gchar *name, GArray *latency)
+{
+  const int percents[] = {50, 90, 99, 100};
+  guint i;
+
+  g_array_sort(latency, ui_benchmark_compare);
+
+  g_print("%-10s", name);
+  for (i = 0; i < G_N_ELEMENTS(percents); i++)
+    g_print(" %8.2f",
+            g_array_index(latency, gint64,
+                          (latency->len - 1)*percents[i]/100)/1000.0);
+  g_print("\n");
+}
+
+//Prints the results and quits; main() returns 1 when the frame latency is
+//over budget
+static void ui_benchmark_finish(void)
+{
+  GArray *frame_latency = ui_benchmark->frame_latency;
+  gint64 p99;
+
+  g_print("%d events, %d of them clicks, latency in ms\n",
+          ui_benchmark->events, ui_benchmark->clicks);
+  g_print("%-10s %8s %8s %8s %8s\n", "", "p50", "p90", "p99", "max");
+  ui_benchmark_print("handled", ui_benchmark->handled_latency);
+  ui_benchmark_print("frame", frame_latency);
+
+  p99 = g_array_index(frame_latency, gint64,
+                      (frame_latency->len - 1)*99/100);
+  ui_benchmark->failed = p99 > UI_BENCHMARK_BUDGET*1000;
+  if (ui_benchmark->failed)
+    g_print("FAILED: 99th percentile frame latency over %d ms\n",
+            UI_BENCHMARK_BUDGET);
+
+  g_application_quit(g_application_get_default());
+}
+
+//Julia preview
+
+//Shows the Julia set of the point under (x, y) of a Mandelbrot image:
+//from the kept previews if it is there, otherwise rendered in place of
+//the one rendering before it
+static void julia_preview_update(GtkWidget *widget, int x, int y)
+{
+  RenderRequest *request = current_request;
+  JuliaPreview *preview;
+  __int128 center_re;
+  __int128 center_im;
+  GList *link;
+  double c_re;
+  double c_im;
+
+  if (request == NULL || request->type != FRACTAL_MANDEL ||
+      x < 0 || x >= request->width || y < 0 || y >= request->height)
+  {
+    julia_preview_hide(widget);
+    return;
+  }
+
+  c_re = (double)(request->re_min + x/request->x_scale);
+  c_im = (double)(request->im_max - y/request->y_scale);
+
+  //The inset goes on the other side from the pointer
+  julia_preview_left = x > request->width/2;
+
+  for (link = julia_preview_cache.head; link; link = link->next)
+  {
+    preview = link->data;
+    if (preview->c_re == c_re && preview->c_im == c_im)
+    {
+      g_queue_unlink(&julia_preview_cache, link);
+      g_queue_push_head_link(&julia_preview_cache, link);
+
+      if (julia_preview_wanted)
+        g_atomic_int_set(&julia_preview_wanted->request->cancelled, TRUE);
+      julia_preview_wanted = NULL;
+      julia_preview_shown = preview;
+      gtk_widget_queue_draw(widget);
+      return;
+    }
+  }
+
+  if (julia_preview_wanted)
+    g_atomic_int_set(&julia_preview_wanted->request->cancelled, TRUE);
+
+  preview = g_new0(JuliaPreview, 1);
+  preview->c_re = c_re;
+  preview->c_im = c_im;
+  preview->pixels = g_new(guint32, JULIA_PREVIEW_WIDTH*JULIA_PREVIEW_HEIGHT);
+
+  //A request of its own, beside the window's: as fast as the kernels go,
+  //and sorted with the tiles of the current render
+  request = render_request_alloc(FRACTAL_JULIA, PRECISION_DOUBLE,
+                                 JULIA_PREVIEW_WIDTH, JULIA_PREVIEW_HEIGHT);
+  request->parameter_a = c_re;
+  request->parameter_b = c_im;
+  request->results = g_async_queue_new();
+  request->generation = g_atomic_int_get(&render_generation);
+  render_initial_center(request, &center_re, &center_im);
+  render_set_center(request, center_re, center_im, 1.0);
+  preview->request = request;
+
+  render_request_queue(request, preview->pixels);
+  julia_previews_pending = g_list_prepend(julia_previews_pending, preview);
+  julia_preview_wanted = preview;
+
+  if (julia_preview_flush_id == 0)
+    julia_preview_flush_id = g_timeout_add(16, julia_preview_flush, widget);
+}
+
+//Takes the inset away and retires the preview rendering for it
+static void julia_preview_hide(GtkWidget *widget)
+{
+  if (julia_preview_wanted)
+    g_atomic_int_set(&julia_preview_wanted->request->cancelled, TRUE);
+  julia_preview_wanted = NULL;
+
+  if (julia_preview_shown)
+  {
+    julia_preview_shown = NULL;
+    gtk_widget_queue_draw(widget);
+  }
+}
+
+//Collects the tiles of the previews rendering. Finished ones are kept,
+//and shown if the pointer is still waiting for them; retired ones are
+//dropped once nothing of theirs is in flight.
+static gboolean julia_preview_flush(gpointer data)
+{
+  GtkWidget *widget = data;
+  JuliaPreview *preview;
+  JuliaPreview *oldest;
+  RenderRequest *request;
+  RenderTile *tile;
+  GList *link;
+  GList *next;
+  gboolean finished;
+
+  for (link = julia_previews_pending; link; link = next)
+  {
+    next = link->next;
+    preview = link->data;
+    request = preview->request;
+
+    finished = g_atomic_int_get(&request->tiles_pending) == 0;
+
+    while ((tile = g_async_queue_try_pop(request->results)) != NULL)
+    {
+      if (!render_request_is_stale(request))
+        render_image_add_tile(preview->pixels, tile);
+      render_tile_free(tile);
+    }
+
+    if (!finished)
+      continue;
+
+    julia_previews_pending = g_list_delete_link(julia_previews_pending, link);
+
+    if (render_request_is_stale(request))
+    {
+      render_request_unref(request);
+      g_free(preview->pixels);
+      g_free(preview);
+      continue;
+    }
+
+    render_request_unref(request);
+    preview->request = NULL;
+
+    g_queue_push_head(&julia_preview_cache, preview);
+    if (julia_preview_cache.length > JULIA_PREVIEW_CACHE)
+    {
+      oldest = g_queue_pop_tail(&julia_preview_cache);
+      if (oldest == julia_preview_shown)
+        julia_preview_shown = NULL;
+      g_free(oldest->pixels);
+      g_free(oldest);
+    }
+
+    if (preview == julia_preview_wanted)
+    {
+      julia_preview_wanted = NULL;
+      julia_preview_shown = preview;
+      gtk_widget_queue_draw(widget);
+    }
+  }
+
+  if (julia_previews_pending)
+    return G_SOURCE_CONTINUE;
+
+  julia_preview_flush_id = 0;
+  return G_SOURCE_REMOVE;
+}
+
+//Draws the inset over the image, at its bottom corner away from the
+//pointer
+static void julia_preview_draw(cairo_t *cr)
+{
+  RenderRequest *request = current_request;
+  cairo_surface_t *image;
+  int x;
+  int y;
+
+  if (julia_preview_shown == NULL || request == NULL ||
+      request->type != FRACTAL_MANDEL)
+    return;
+
+  x = julia_preview_left ? JULIA_PREVIEW_MARGIN :
+      request->width - JULIA_PREVIEW_WIDTH - JULIA_PREVIEW_MARGIN;
+  y = request->height - JULIA_PREVIEW_HEIGHT - JULIA_PREVIEW_MARGIN;
+
+  image = cairo_image_surface_create_for_data(
+            (guchar *)julia_preview_shown->pixels, CAIRO_FORMAT_RGB24,
+            JULIA_PREVIEW_WIDTH, JULIA_PREVIEW_HEIGHT,
+            JULIA_PREVIEW_WIDTH*sizeof(guint32));
+
+  cairo_set_source_rgb(cr, 1.0, 1.0, 1.0);
+  cairo_rectangle(cr, x - 1, y - 1, JULIA_PREVIEW_WIDTH + 2,
+                  JULIA_PREVIEW_HEIGHT + 2);
+  cairo_fill(cr);
+
+  cairo_set_source_surface(cr, image, x, y);
+  cairo_paint(cr);
+  cairo_surface_destroy(image);
+}
+
+//Canvas
+
+//Key of the canvas tile in column x and row y of tiles
+static gint64 canvas_tile_key(int x, int y)
+{
+  return ((gint64)y << 32) | x;
+}
+
+//Opens the canvas window on the fractal of the main window, at the same
+//precision and options, or brings it to the front when it is open. The
+//view is the main window's when it shows the same fractal and the
+//initial view otherwise, at canvas_size/DAWIDTH times the resolution.
+static void canvas_open(GtkWidget *drawing_area)
+{
+  Canvas *canvas;
+  RenderRequest *request;
+  GtkWidget *grid;
+  gchar *title;
+
+  if (canvas_window)
+  {
+    gtk_window_present(GTK_WINDOW(canvas_window->window));
+    return;
+  }
+
+  canvas = g_new0(Canvas, 1);
+  canvas->type = current_request ? current_request->type : FRACTAL_MANDEL;
+  canvas->precision = render_precision;
+  if (render_kernel(canvas->type, canvas->precision, render_simd) == NULL)
+    canvas->type = FRACTAL_MANDEL;
+  canvas->parameter_a = (long double)parameter_a;
+  canvas->parameter_b = (long double)parameter_b;
+  if (canvas->type == FRACTAL_FORMULA)
+    canvas->formula = formula_copy(current_formula);
+  canvas->antialias = render_antialias;
+  canvas->show_samples = render_show_samples;
+  canvas->distance = render_distance;
+  canvas->width = canvas_size;
+  canvas->height = canvas_size*3/5;
+  canvas->results = g_async_queue_new();
+  canvas->tiles = g_hash_table_new(g_int64_hash, g_int64_equal);
+
+  if (current_request && current_request->type == canvas->type &&
+      view_type == canvas->type)
+  {
+    canvas->center_re = view_center_re;
+    canvas->center_im = view_center_im;
+    canvas->zoom = view_zoom;
+  }
+  else
+  {
+    request = canvas_request_new(canvas);
+    render_initial_center(request, &canvas->center_re, &canvas->center_im);
+    render_request_unref(request);
+    canvas->zoom = 1.0;
+  }
+
+  //The image is far wider than a GtkScrolledWindow can hold as a child
+  //widget, so the scrollbars' adjustments move a window-sized drawing
+  //area over it instead. Start at the center.
+  canvas->hadjustment = gtk_adjustment_new((canvas->width - DAWIDTH)/2, 0,
+                                           canvas->width, TILE_SIZE,
+                                           DAWIDTH, DAWIDTH);
+  canvas->vadjustment = gtk_adjustment_new((canvas->height - DAHEIGHT)/2, 0,
+                                           canvas->height, TILE_SIZE,
+                                           DAHEIGHT, DAHEIGHT);
+  g_signal_connect(canvas->hadjustment, "value-changed",
+                   G_CALLBACK(canvas_moved), canvas);
+  g_signal_connect(canvas->vadjustment, "value-changed",
+                   G_CALLBACK(canvas_moved), canvas);
+
+  canvas->drawing_area = gtk_drawing_area_new();
+  gtk_widget_set_hexpand(canvas->drawing_area, TRUE);
+  gtk_widget_set_vexpand(canvas->drawing_area, TRUE);
+  gtk_widget_add_events(canvas->drawing_area, GDK_SCROLL_MASK |
+                                              GDK_BUTTON_PRESS_MASK |
+                                              GDK_BUTTON1_MOTION_MASK);
+  g_signal_connect(canvas->drawing_area, "draw",
+                   G_CALLBACK(canvas_draw), canvas);
+  g_signal_connect(canvas->drawing_area, "size-allocate",
+                   G_CALLBACK(canvas_size_allocate), canvas);
+  g_signal_connect(canvas->drawing_area, "scroll-event",
+                   G_CALLBACK(canvas_scroll), canvas);
+  g_signal_connect(canvas->drawing_area, "button-press-event",
+                   G_CALLBACK(canvas_button_press), canvas);
+  g_signal_connect(canvas->drawing_area, "motion-notify-event",
+                   G_CALLBACK(canvas_motion), canvas);
+
+  grid = gtk_grid_new();
+  gtk_grid_attach(GTK_GRID(grid), canvas->drawing_area, 0, 0, 1, 1);
+  gtk_grid_attach(GTK_GRID(grid),
+                  gtk_scrollbar_new(GTK_ORIENTATION_VERTICAL,
+                                    canvas->vadjustment), 1, 0, 1, 1);
+  gtk_grid_attach(GTK_GRID(grid),
+                  gtk_scrollbar_new(GTK_ORIENTATION_HORIZONTAL,
+                                    canvas->hadjustment), 0, 1, 1, 1);
+
+  canvas->window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
+  title = g_strdup_printf("%s canvas %dX%d", fractal_names[canvas->type],
+                          canvas->width, canvas->height);
+  gtk_window_set_title(GTK_WINDOW(canvas->window), title);
+  g_free(title);
+  gtk_window_set_icon(GTK_WINDOW(canvas->window), app_icon());
+  gtk_window_set_default_size(GTK_WINDOW(canvas->window),
+                              DAWIDTH, DAHEIGHT);
+  gtk_window_set_transient_for(GTK_WINDOW(canvas->window),
+                               GTK_WINDOW(gtk_widget_get_toplevel(
+                                            drawing_area)));
+  gtk_window_set_destroy_with_parent(GTK_WINDOW(canvas->window), TRUE);
+  g_signal_connect(canvas->window, "destroy",
+                   G_CALLBACK(canvas_destroy), canvas);
+  gtk_container_add(GTK_CONTAINER(canvas->window), grid);
+
+  canvas_window = canvas;
+  gtk_widget_show_all(canvas->window);
+}
+
+//A request for tiles of the canvas image, which delivers them to the
+//canvas's results. Its generation sorts its tiles with those of the
+//main window's render.
+static RenderRequest *canvas_request_new(Canvas *canvas)
+{
+  RenderRequest *request;
+
+  request = render_request_alloc(canvas->type, canvas->precision,
+                                 canvas->width, canvas->height);
+  request->parameter_a = canvas->parameter_a;
+  request->parameter_b = canvas->parameter_b;
+  if (canvas->formula)
+    request->formula = formula_copy(canvas->formula);
+  request->antialias = canvas->antialias;
+  request->show_samples = canvas->show_samples;
+  request->distance = canvas->distance;
+  request->distance_fill = canvas->type == FRACTAL_MANDEL ||
+                           (canvas->type == FRACTAL_JULIA &&
+                            render_julia_connected(request->parameter_a,
+                                                   request->parameter_b));
+  request->results = g_async_queue_ref(canvas->results);
+  request->generation = g_atomic_int_get(&render_generation);
+  render_set_center(request, canvas->center_re, canvas->center_im,
+                    canvas->zoom);
+
+  return request;
+}
+
+//Part of the canvas image the drawing area shows
+static void canvas_visible(Canvas *canvas, GdkRectangle *visible)
+{
+  visible->x = (int)gtk_adjustment_get_value(canvas->hadjustment);
+  visible->y = (int)gtk_adjustment_get_value(canvas->vadjustment);
+  visible->width = MIN(gtk_widget_get_allocated_width(canvas->drawing_area),
+                       canvas->width - visible->x);
+  visible->height = MIN(gtk_widget_get_allocated_height(
+                          canvas->drawing_area),
+                        canvas->height - visible->y);
+}
+
+//Queues the tiles within CANVAS_PREFETCH tiles of the part shown that are
+//neither rendered nor rendering. When that range has changed, the tiles
+//still queued for the last one are retired first, so that the render
+//threads only work near what is shown; those already on a thread are
+//kept by canvas_flush() if they are still wanted.
+static void canvas_update(Canvas *canvas)
+{
+  GdkRectangle visible;
+  GdkRectangle wanted;
+  GHashTableIter iter;
+  GPtrArray *tiles;
+  CanvasTile *tile;
+  gint64 key;
+  int columns;
+  int rows;
+  int x;
+  int y;
+
+  canvas_visible(canvas, &visible);
+  if (visible.width <= 0 || visible.height <= 0)
+    return;
+
+  columns = (canvas->width + TILE_SIZE - 1)/TILE_SIZE;
+  rows = (canvas->height + TILE_SIZE - 1)/TILE_SIZE;
+  wanted.x = MAX(visible.x/TILE_SIZE - CANVAS_PREFETCH, 0);
+  wanted.y = MAX(visible.y/TILE_SIZE - CANVAS_PREFETCH, 0);
+  wanted.width = MIN((visible.x + visible.width - 1)/TILE_SIZE +
+                     CANVAS_PREFETCH + 1, columns) - wanted.x;
+  wanted.height = MIN((visible.y + visible.height - 1)/TILE_SIZE +
+                      CANVAS_PREFETCH + 1, rows) - wanted.y;
+
+  if (canvas->request && gdk_rectangle_equal(&wanted, &canvas->wanted))
+    return;
+  canvas->wanted = wanted;
+
+  if (canvas->request)
+  {
+    g_atomic_int_set(&canvas->request->cancelled, TRUE);
+    render_request_unref(canvas->request);
+
+    g_hash_table_iter_init(&iter, canvas->tiles);
+    while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&tile))
+    {
+      if (tile->pixels == NULL)
+      {
+        g_hash_table_iter_remove(&iter);
+        g_free(tile);
+      }
+    }
+    canvas->pending = 0;
+  }
+
+  //The tiles in view come first, then the margin around them
+  canvas->request = canvas_request_new(canvas);
+  canvas->request->focus_x = visible.x + visible.width/2;
+  canvas->request->focus_y = visible.y + visible.height/2;
+  tiles = g_ptr_array_new();
+
+  for (y = wanted.y; y < wanted.y + wanted.height; y++)
+  {
+    for (x = wanted.x; x < wanted.x + wanted.width; x++)
+    {
+      key = canvas_tile_key(x, y);
+      if (g_hash_table_contains(canvas->tiles, &key))
+        continue;
+
+      tile = g_new0(CanvasTile, 1);
+      tile->key = key;
+      tile->x = x*TILE_SIZE;
+      tile->y = y*TILE_SIZE;
+      tile->width = MIN(TILE_SIZE, canvas->width - tile->x);
+      tile->height = MIN(TILE_SIZE, canvas->height - tile->y);
+      g_hash_table_insert(canvas->tiles, &tile->key, tile);
+      canvas->pending++;
+
+      g_ptr_array_add(tiles, render_tile_new(canvas->request,
+                                             tile->x, tile->y,
+                                             tile->width, tile->height));
+    }
+  }
+
+  canvas->request->tiles_pending = tiles->len;
+  render_push_tiles(tiles);
+
+  if (canvas->pending > 0 && canvas->flush_id == 0)
+    canvas->flush_id = g_timeout_add(16, canvas_flush, canvas);
+
+  canvas_show_memory(canvas);
+}
+
+//Moves the tiles the render threads have finished into the canvas
+static gboolean canvas_flush(gpointer data)
+{
+  Canvas *canvas = data;
+  CanvasTile *tile;
+  RenderTile *rendered;
+  GdkRectangle *wanted = &canvas->wanted;
+  gboolean redraw = FALSE;
+  gint64 key;
+  int x;
+  int y;
+
+  while ((rendered = g_async_queue_try_pop(canvas->results)) != NULL)
+  {
+    x = rendered->x/TILE_SIZE;
+    y = rendered->y/TILE_SIZE;
+    key = canvas_tile_key(x, y);
+    tile = g_hash_table_lookup(canvas->tiles, &key);
+
+    //A tile of a retired request that was already rendering, and is
+    //still wanted
+    if (tile == NULL && x >= wanted->x && x < wanted->x + wanted->width &&
+        y >= wanted->y && y < wanted->y + wanted->height)
+    {
+      tile = g_new0(CanvasTile, 1);
+      tile->key = key;
+      tile->x = rendered->x;
+      tile->y = rendered->y;
+      tile->width = rendered->width;
+      tile->height = rendered->height;
+      g_hash_table_insert(canvas->tiles, &tile->key, tile);
+      canvas->pending++;
+    }
+
+    if (tile && tile->pixels == NULL)
+    {
+      tile->pixels = rendered->pixels;
+      rendered->pixels = NULL;
+      g_queue_push_head(&canvas->finished, tile);
+      tile->link = canvas->finished.head;
+      canvas->pending--;
+      redraw = TRUE;
+    }
+
+    render_tile_free(rendered);
+  }
+
+  if (redraw)
+  {
+    canvas_evict(canvas);
+    canvas_show_memory(canvas);
+    gtk_widget_queue_draw(canvas->drawing_area);
+  }
 
-  width = DAWIDTH;
-  height = DAHEIGHT;
+  if (canvas->pending > 0)
+    return G_SOURCE_CONTINUE;
 
-  init_x = 0.1;
-  init_y = 0.0;
-  init_z = 0.0;
+  canvas->flush_id = 0;
+  return G_SOURCE_REMOVE;
+}
 
-  x = init_x;
-  y = init_y;
-  z = init_z;
+//Drops the tiles drawn longest ago once there are more than
+//CANVAS_CACHE_TILES, or twice the tiles wanted if that is more
+static void canvas_evict(Canvas *canvas)
+{
+  CanvasTile *tile;
+  guint limit;
 
-  while (counter < max_count && closing == FALSE)
-  {
-    x_new = x + h * a * (y - x);
-    y_new = y + h * (x * (b - z) - y);
-    z_new = z + h * (x * y - c * z);
+  limit = MAX(CANVAS_CACHE_TILES,
+              2*canvas->wanted.width*canvas->wanted.height);
 
-    x = x_new;
-    y = y_new;
-    z = z_new;
+  while (canvas->finished.length > limit)
+  {
+    tile = g_queue_pop_tail(&canvas->finished);
+    g_hash_table_remove(canvas->tiles, &tile->key);
+    g_free(tile->pixels);
+    g_free(tile);
+  }
+}
 
-    //x = (screen_x/(1000/5) - 2.5);
-    //d_screen_x = (x + 2.5)*(width/5);
+//Puts the tiles and memory the canvas holds in its window's title
+static void canvas_show_memory(Canvas *canvas)
+{
+  gchar *title;
+  gint64 bytes = 0;
+  GList *link;
+  CanvasTile *tile;
 
-    //x = d_screen_x/10 - 50.0
-    d_screen_y = (y + 50.0)*10;
-    screen_y = (int)d_screen_y;
+  for (link = canvas->finished.head; link; link = link->next)
+  {
+    tile = link->data;
+    bytes += sizeof(CanvasTile) + tile->width*tile->height*sizeof(guint32);
+  }
 
-    //y = -(d_screen_y/(600/3) - 1.5);
-    //d_screen_y = (-y + 1.5)*(height/3);
+  title = g_strdup_printf("%s canvas %dX%d: %u tiles, %.1f MB, "
+                          "%d rendering",
+                          fractal_names[canvas->type], canvas->width,
+                          canvas->height, canvas->finished.length,
+                          bytes/1e6, canvas->pending);
+  gtk_window_set_title(GTK_WINDOW(canvas->window), title);
+  g_free(title);
+}
 
-    //y = -(d_screen_y/6 - 50.0);
-    d_screen_z = (-z + 50.0)*6;
-    screen_z = (int)d_screen_z;
+//Draws the tiles rendered in the part shown over a dark background
+static gboolean canvas_draw(GtkWidget *widget, cairo_t *cr, gpointer data)
+{
+  Canvas *canvas = data;
+  CanvasTile *tile;
+  GdkRectangle visible;
+  cairo_surface_t *image;
+  gint64 key;
+  int x;
+  int y;
 
-    cairo_set_source_rgb (cr, 0, 0, 0);
-    cairo_set_line_width (cr, 0.5);
-    cairo_set_line_cap (cr, CAIRO_LINE_CAP_ROUND);
-    cairo_move_to (cr, screen_y, screen_z);
-    cairo_close_path (cr);
-    cairo_stroke (cr);
+  cairo_set_source_rgb(cr, 0.2, 0.2, 0.2);
+  cairo_paint(cr);
 
-    gtk_widget_queue_draw_area(drawing_area, screen_y, screen_z, 1, 1);
+  canvas_visible(canvas, &visible);
 
-    while (gtk_events_pending())
+  for (y = visible.y/TILE_SIZE;
+       y*TILE_SIZE < visible.y + visible.height; y++)
+  {
+    for (x = visible.x/TILE_SIZE;
+         x*TILE_SIZE < visible.x + visible.width; x++)
     {
-      gtk_main_iteration();
+      key = canvas_tile_key(x, y);
+      tile = g_hash_table_lookup(canvas->tiles, &key);
+      if (tile == NULL || tile->pixels == NULL)
+        continue;
+
+      image = cairo_image_surface_create_for_data(
+                (guchar *)tile->pixels, CAIRO_FORMAT_RGB24,
+                tile->width, tile->height, tile->width*sizeof(guint32));
+      cairo_set_source_surface(cr, image, tile->x - visible.x,
+                               tile->y - visible.y);
+      cairo_paint(cr);
+      cairo_surface_destroy(image);
+
+      g_queue_unlink(&canvas->finished, tile->link);
+      g_queue_push_head_link(&canvas->finished, tile->link);
     }
+  }
 
-    counter++;
+  return FALSE;
+}
+
+//Makes a page of the scrollbars the size of the drawing area
+static void canvas_size_allocate(GtkWidget *widget,
+                                 GdkRectangle *allocation, gpointer data)
+{
+  Canvas *canvas = data;
+
+  gtk_adjustment_configure(canvas->hadjustment,
+                           gtk_adjustment_get_value(canvas->hadjustment),
+                           0, canvas->width, TILE_SIZE,
+                           allocation->width, allocation->width);
+  gtk_adjustment_configure(canvas->vadjustment,
+                           gtk_adjustment_get_value(canvas->vadjustment),
+                           0, canvas->height, TILE_SIZE,
+                           allocation->height, allocation->height);
+
+  canvas_update(canvas);
+}
+
+static void canvas_moved(GtkAdjustment *adjustment, gpointer data)
+{
+  Canvas *canvas = data;
+
+  canvas_update(canvas);
+  gtk_widget_queue_draw(canvas->drawing_area);
+}
+
+//The wheel scrolls by a tile, sideways with shift
+static gboolean canvas_scroll(GtkWidget *widget, GdkEventScroll *event,
+                              gpointer data)
+{
+  Canvas *canvas = data;
+  GtkAdjustment *adjustment;
+  gdouble dx = 0.0;
+  gdouble dy = 0.0;
+
+  if (event->direction == GDK_SCROLL_SMOOTH)
+    gdk_event_get_scroll_deltas((GdkEvent *)event, &dx, &dy);
+  else if (event->direction == GDK_SCROLL_UP)
+    dy = -1.0;
+  else if (event->direction == GDK_SCROLL_DOWN)
+    dy = 1.0;
+  else if (event->direction == GDK_SCROLL_LEFT)
+    dx = -1.0;
+  else
+    dx = 1.0;
+
+  if (event->state & GDK_SHIFT_MASK)
+  {
+    dx += dy;
+    dy = 0.0;
   }
 
-  cairo_destroy (cr);
+  adjustment = canvas->hadjustment;
+  gtk_adjustment_set_value(adjustment, gtk_adjustment_get_value(adjustment) +
+                                       dx*TILE_SIZE);
+  adjustment = canvas->vadjustment;
+  gtk_adjustment_set_value(adjustment, gtk_adjustment_get_value(adjustment) +
+                                       dy*TILE_SIZE);
+
+  return TRUE;
 }
 
-static void lorenz_xz(GtkWidget* drawing_area)
+//Dragging with the left button moves the image with the pointer
+static gboolean canvas_button_press(GtkWidget *widget,
+                                    GdkEventButton *event, gpointer data)
 {
-  closing = FALSE;
+  Canvas *canvas = data;
 
-  cairo_t *cr;
+  canvas->drag_x = event->x + gtk_adjustment_get_value(canvas->hadjustment);
+  canvas->drag_y = event->y + gtk_adjustment_get_value(canvas->vadjustment);
 
-  cr = cairo_create (surface);
+  return TRUE;
+}
 
-  int width;
-  int height;
-  long double x;
-  long double y;
-  long double z;
-  long double init_x;
-  long double init_y;
-  long double init_z;
-  long double x_new;
-  long double y_new;
-  long double z_new;
-  long double d_screen_x;
-  long double d_screen_y;
-  long double d_screen_z;
-  int screen_x;
-  int screen_y;
-  int screen_z;
-  int counter;
-  int max_count;
+static gboolean canvas_motion(GtkWidget *widget, GdkEventMotion *event,
+                              gpointer data)
+{
+  Canvas *canvas = data;
 
-  long double h = 0.01;
-  long double a = 10.0;
-  long double b = 28.0;
-  long double c = 8.0 / 3.0;
+  gtk_adjustment_set_value(canvas->hadjustment, canvas->drag_x - event->x);
+  gtk_adjustment_set_value(canvas->vadjustment, canvas->drag_y - event->y);
 
-  counter = 0;
-  max_count = 100000;
+  return TRUE;
+}
 
-  width = DAWIDTH;
-  height = DAHEIGHT;
+//Retires the canvas's tiles and lets go of everything it holds. Tiles
+//already on a render thread end up in results, which they keep alive.
+static void canvas_destroy(GtkWidget *widget, gpointer data)
+{
+  Canvas *canvas = data;
+  RenderTile *rendered;
+  GHashTableIter iter;
+  CanvasTile *tile;
 
-  init_x = 0.1;
-  init_y = 0.0;
-  init_z = 0.0;
+  if (canvas->request)
+  {
+    g_atomic_int_set(&canvas->request->cancelled, TRUE);
+    render_request_unref(canvas->request);
+  }
 
-  x = init_x;
-  y = init_y;
-  z = init_z;
+  if (canvas->flush_id)
+    g_source_remove(canvas->flush_id);
 
-  while (counter < max_count && closing == FALSE)
+  while ((rendered = g_async_queue_try_pop(canvas->results)) != NULL)
+    render_tile_free(rendered);
+  g_async_queue_unref(canvas->results);
+
+  g_hash_table_iter_init(&iter, canvas->tiles);
+  while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&tile))
   {
-    x_new = x + h * a * (y - x);
-    y_new = y + h * (x * (b - z) - y);
-    z_new = z + h * (x * y - c * z);
+    g_free(tile->pixels);
+    g_free(tile);
+  }
+  g_hash_table_destroy(canvas->tiles);
+  g_queue_clear(&canvas->finished);
 
-    x = x_new;
-    y = y_new;
-    z = z_new;
+  if (canvas->formula)
+    formula_free(canvas->formula);
 
-    //x = (screen_x/(1000/5) - 2.5);
-    //d_screen_x = (x + 2.5)*(width/5);
+  g_free(canvas);
+  canvas_window = NULL;
+}
 
-    //x = d_screen_x/10 - 50.0
-    d_screen_x = (x + 50.0)*10;
-    screen_x = (int)d_screen_x;
+//Saving
 
-    //y = -(d_screen_y/(600/3) - 1.5);
-    //d_screen_y = (-y + 1.5)*(height/3);
+//Format of a file name by its extension, or -1 for none of them
+static int image_format_from_name(const gchar *filename)
+{
+  int format;
 
-    //y = -(d_screen_y/6 - 50.0);
-    d_screen_z = (-z + 50.0)*6;
-    screen_z = (int)d_screen_z;
+  for (format = 0; format < IMAGE_FORMATS; format++)
+    if (g_str_has_suffix(filename, image_format_extensions[format]))
+      return format;
 
-    cairo_set_source_rgb (cr, 0, 0, 0);
-    cairo_set_line_width (cr, 0.5);
-    cairo_set_line_cap (cr, CAIRO_LINE_CAP_ROUND);
-    cairo_move_to (cr, screen_x, screen_z);
-    cairo_close_path (cr);
-    cairo_stroke (cr);
+  return -1;
+}
 
-    gtk_widget_queue_draw_area(drawing_area, screen_x, screen_z, 1, 1);
+//Saves the image shown to filename without holding up the GTK thread:
+//only the copy of the pixels and the render statistics are made here,
+//encoding and writing the file are left to a GTask thread. The
+//application is held until the file is written.
+static void image_save_start(const gchar *filename, ImageFormat format)
+{
+  ImageSave *save;
+  GTask *task;
+  cairo_surface_t *image;
+  cairo_t *cr;
+  guint32 crc;
+  int n;
+  int k;
 
-    while (gtk_events_pending())
+  if (png_crc_table[1] == 0)
+  {
+    for (n = 0; n < 256; n++)
     {
-      gtk_main_iteration();
+      crc = n;
+      for (k = 0; k < 8; k++)
+        crc = crc & 1 ? 0xedb88320 ^ (crc >> 1) : crc >> 1;
+      png_crc_table[n] = crc;
     }
+  }
 
-    counter++;
+  trace_begin("save_snapshot");
+
+  save = g_new0(ImageSave, 1);
+  save->filename = g_strdup(filename);
+  save->format = format;
+  save->width = DAWIDTH;
+  save->height = DAHEIGHT;
+  save->pixels = g_new(guint32, (gsize)save->width*save->height);
+  save->start_time = g_get_monotonic_time();
+
+  //surface is only an image surface with --shm-output, so it is painted
+  //into one over the copy rather than read directly
+  image = cairo_image_surface_create_for_data((guchar *)save->pixels,
+                                              CAIRO_FORMAT_RGB24,
+                                              save->width, save->height,
+                                              save->width*sizeof(guint32));
+  cr = cairo_create(image);
+  cairo_set_source_surface(cr, surface, 0, 0);
+  cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+  cairo_paint(cr);
+  cairo_destroy(cr);
+  cairo_surface_flush(image);
+  cairo_surface_destroy(image);
+
+  trace_end("save_snapshot");
+
+  save_render_stats(filename);
+
+  image_saves = g_list_append(image_saves, save);
+  if (image_save_progress_id == 0)
+    image_save_progress_id = g_timeout_add(SAVE_PROGRESS_INTERVAL,
+                                           image_save_progress, NULL);
+
+  //Closing the window does not end the program before the file is written
+  g_application_hold(g_application_get_default());
+
+  task = g_task_new(NULL, NULL, image_save_done, save);
+  g_task_set_task_data(task, save, NULL);
+  g_task_run_in_thread(task, image_save_thread);
+  g_object_unref(task);
+}
+
+//Encodes a save and writes its file, on a GTask thread
+static void image_save_thread(GTask *task, gpointer source,
+                              gpointer task_data, GCancellable *cancellable)
+{
+  ImageSave *save = task_data;
+  GByteArray *out;
+  GError *error = NULL;
+
+  trace_begin("save_encode");
+
+  out = g_byte_array_new();
+  switch (save->format)
+  {
+    case IMAGE_FORMAT_PNG:
+      png_encode(save, out, &error);
+      break;
+    case IMAGE_FORMAT_PPM:
+      ppm_encode(save, out);
+      break;
+    default:
+      qoi_encode(save, out);
+      break;
   }
 
-  cairo_destroy (cr);
+  trace_end("save_encode");
+
+  if (error == NULL)
+  {
+    trace_begin("save_write");
+    g_file_set_contents(save->filename, (const gchar *)out->data, out->len,
+                        &error);
+    trace_end("save_write");
+  }
+  save->bytes = out->len;
+  g_byte_array_unref(out);
+
+  if (error)
+    g_task_return_error(task, error);
+  else
+    g_task_return_boolean(task, TRUE);
 }
 
-//Generates and displays Julia set
-static void julia(GtkWidget* drawing_area)
+//Reports a finished save in the status bar, back on the GTK thread
+static void image_save_done(GObject *source, GAsyncResult *result,
+                            gpointer data)
 {
-  closing = FALSE;
+  ImageSave *save = data;
+  GError *error = NULL;
+  gchar *text;
+  guint context;
 
-  cairo_t *cr;
+  image_saves = g_list_remove(image_saves, save);
 
-  cr = cairo_create (surface);
+  if (g_task_propagate_boolean(G_TASK(result), &error))
+  {
+    text = g_strdup_printf("Saved %s: %.1f MB in %.0f ms", save->filename,
+                           save->bytes/1e6,
+                           (g_get_monotonic_time() - save->start_time)/1e3);
+  }
+  else
+  {
+    text = g_strdup_printf("Could not save %s: %s", save->filename,
+                           error->message);
+    g_warning("%s", text);
+    g_error_free(error);
+  }
 
-  int width = DAWIDTH;
-  int height = DAHEIGHT;
-  int screen_x;
-  int screen_y;
-  long double d_screen_x;
-  long double a;
-  long double d_screen_y;
-  long double b;
-  long double mzsq;
-  int counter;
-  long double x_new;
-  long double y_new;
-  long double x;
-  long double y;
-  long double z_re;
-  long double z_im;
+  if (status_bar)
+  {
+    context = gtk_statusbar_get_context_id(GTK_STATUSBAR(status_bar),
+                                           "save");
+    gtk_statusbar_remove_all(GTK_STATUSBAR(status_bar), context);
+    gtk_statusbar_push(GTK_STATUSBAR(status_bar), context, text);
+  }
+
+  g_free(text);
+  image_save_free(save);
+
+  g_application_release(g_application_get_default());
+}
+
+//Shows how far the saves in progress have got
+static gboolean image_save_progress(gpointer data)
+{
+  GString *text;
+  GList *link;
+  ImageSave *save;
+  gint bands;
+  guint context;
+
+  if (image_saves == NULL)
+  {
+    image_save_progress_id = 0;
+    return G_SOURCE_REMOVE;
+  }
+
+  text = g_string_new(NULL);
+  for (link = image_saves; link; link = link->next)
+  {
+    save = link->data;
+    bands = g_atomic_int_get(&save->bands);
+    g_string_append_printf(text, "%sSaving %s: %d%%",
+                           link == image_saves ? "" : ", ", save->filename,
+                           bands ? 100*g_atomic_int_get(&save->bands_done)/
+                                   bands : 0);
+  }
+
+  if (status_bar)
+  {
+    context = gtk_statusbar_get_context_id(GTK_STATUSBAR(status_bar),
+                                           "save");
+    gtk_statusbar_remove_all(GTK_STATUSBAR(status_bar), context);
+    gtk_statusbar_push(GTK_STATUSBAR(status_bar), context, text->str);
+  }
+  g_string_free(text, TRUE);
+
+  return G_SOURCE_CONTINUE;
+}
+
+static void image_save_free(ImageSave *save)
+{
+  g_free(save->filename);
+  g_free(save->pixels);
+  g_free(save->png_bands);
+  g_free(save);
+}
+
+//CRC-32 of PNG chunks, continued from crc over length more bytes (start
+//from 0)
+static guint32 png_crc(guint32 crc, const guint8 *data, gsize length)
+{
+  gsize i;
+
+  crc = ~crc;
+  for (i = 0; i < length; i++)
+    crc = png_crc_table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+
+  return ~crc;
+}
 
-  a = (long double)parameter_a;
-  b = (long double)parameter_b;
+//Adler-32 of zlib streams, continued from adler (start from 1). The sums
+//are reduced every 5552 bytes, the most that cannot overflow 32 bits.
+static guint32 adler32(guint32 adler, const guint8 *data, gsize length)
+{
+  guint32 a = adler & 0xffff;
+  guint32 b = adler >> 16;
+  gsize block;
+  gsize i;
 
-  for (screen_x = 1; screen_x < width && closing == FALSE; screen_x++)
+  while (length > 0)
   {
-    //transforms int screen_x to a long double value in the complex plane
-    d_screen_x = (long double)screen_x;
-    z_re = d_screen_x/(width/5) - 2.0;
-    //x = d_screen_x/(width/5) - 2.0;
+    block = MIN(length, 5552);
+    for (i = 0; i < block; i++)
+    {
+      a += data[i];
+      b += a;
+    }
+    a %= 65521;
+    b %= 65521;
+    data += block;
+    length -= block;
+  }
 
-    for (screen_y = 1; screen_y < height && closing == FALSE; screen_y++)
+  return (b << 16) | a;
+}
+
+//Adler-32 of two runs of bytes one after the other, from those of each
+//and the length of the second (as zlib's adler32_combine())
+static guint32 adler32_combine(guint32 adler1, guint32 adler2,
+                               gsize length2)
+{
+  const guint32 base = 65521;
+  guint32 remainder;
+  guint32 sum1;
+  guint32 sum2;
+
+  remainder = length2 % base;
+  sum1 = adler1 & 0xffff;
+  sum2 = (guint32)(((guint64)remainder*sum1) % base);
+  sum1 += (adler2 & 0xffff) + base - 1;
+  sum2 += (adler1 >> 16) + (adler2 >> 16) + base - remainder;
+  if (sum1 >= base)
+    sum1 -= base;
+  if (sum1 >= base)
+    sum1 -= base;
+  if (sum2 >= base << 1)
+    sum2 -= base << 1;
+  if (sum2 >= base)
+    sum2 -= base;
+
+  return sum1 | (sum2 << 16);
+}
+
+//Appends a PNG chunk: its length, type, data and CRC
+static void png_append_chunk(GByteArray *out, const gchar *type,
+                             const guint8 *data, gsize length)
+{
+  guint8 word[4];
+  guint32 crc;
+
+  word[0] = length >> 24;
+  word[1] = length >> 16;
+  word[2] = length >> 8;
+  word[3] = length;
+  g_byte_array_append(out, word, 4);
+  g_byte_array_append(out, (const guint8 *)type, 4);
+  g_byte_array_append(out, data, length);
+
+  crc = png_crc(png_crc((guint32)0, (const guint8 *)type, 4), data, length);
+  word[0] = crc >> 24;
+  word[1] = crc >> 16;
+  word[2] = crc >> 8;
+  word[3] = crc;
+  g_byte_array_append(out, word, 4);
+}
+
+//Filters the rows of a band and deflates them into its IDAT chunk. Every
+//row is filtered by Up, the difference from the row above, which only
+//needs the pixels, so the bands do not depend on each other. Each band
+//but the last ends with a sync flush, on a byte boundary and without the
+//final block flag, so that the bands put one after another make a single
+//deflate stream.
+static void png_band_encode(ImageSave *save, PngBand *band)
+{
+  GConverter *compressor;
+  GConverterResult result;
+  GConverterFlags flags;
+  guint8 *rows;
+  guint8 *p;
+  guint32 *line;
+  guint32 *above;
+  guint32 v;
+  guint32 u;
+  gsize capacity;
+  gsize done;
+  gsize size;
+  gsize read;
+  gsize written;
+  guint32 crc;
+  int x;
+  int y;
+
+  band->length = (gsize)band->rows*(1 + 3*save->width);
+  rows = g_malloc(band->length);
+  p = rows;
+  for (y = band->first_row; y < band->first_row + band->rows; y++)
+  {
+    line = save->pixels + (gsize)y*save->width;
+    above = line - save->width;
+    *p++ = 2;
+    for (x = 0; x < save->width; x++)
     {
-      //transforms int screen_y to a long double value in the complex plane
-      d_screen_y = (long double)screen_y;
-      z_im = -(d_screen_y/(height/3) - 1.5);
-      //y = -(d_screen_y/(height/3) - 1.5);
+      v = line[x];
+      u = y > 0 ? above[x] : 0;
+      p[0] = (v >> 16) - (u >> 16);
+      p[1] = (v >> 8) - (u >> 8);
+      p[2] = v - u;
+      p += 3;
+    }
+  }
+  band->adler = adler32(1, rows, band->length);
+
+  //Deflate never grows the data by more than a few bytes per 16 KB
+  //block, so the chunk is sized once for the worst case
+  capacity = band->length + band->length/8 + 64;
+  band->chunk = g_byte_array_sized_new(capacity + 12);
+  g_byte_array_set_size(band->chunk, capacity + 8);
+
+  compressor = G_CONVERTER(
+      g_zlib_compressor_new(G_ZLIB_COMPRESSOR_FORMAT_RAW, SAVE_PNG_LEVEL));
+  flags = band->first_row + band->rows == save->height
+          ? G_CONVERTER_INPUT_AT_END : G_CONVERTER_FLUSH;
+  done = 0;
+  size = 0;
+  do
+  {
+    result = g_converter_convert(compressor, rows + done,
+                                 band->length - done,
+                                 band->chunk->data + 8 + size,
+                                 capacity - size, flags, &read, &written,
+                                 &band->error);
+    done += read;
+    size += written;
+  } while (result == G_CONVERTER_CONVERTED);
+  g_object_unref(compressor);
+  g_free(rows);
+
+  if (result == G_CONVERTER_ERROR)
+    return;
+
+  p = band->chunk->data;
+  p[0] = size >> 24;
+  p[1] = size >> 16;
+  p[2] = size >> 8;
+  p[3] = size;
+  memcpy(p + 4, "IDAT", 4);
+  crc = png_crc((guint32)0, p + 4, size + 4);
+  p += size + 8;
+  p[0] = crc >> 24;
+  p[1] = crc >> 16;
+  p[2] = crc >> 8;
+  p[3] = crc;
+  g_byte_array_set_size(band->chunk, size + 12);
+}
 
+//Takes bands of a PNG save until there are none left
+static gpointer png_band_thread(gpointer data)
+{
+  ImageSave *save = data;
+  int band;
 
-      x = z_re;
-      y = z_im;
-      mzsq = 0.0;
-      counter = 0;
+  for (;;)
+  {
+    band = g_atomic_int_add(&save->bands_next, 1);
+    if (band >= save->bands)
+      break;
 
-      while (counter < 100 && closing == FALSE)
-      {
-      //loop to iterate function F(z) = z*z + c
+    trace_begin("png_band");
+    png_band_encode(save, &save->png_bands[band]);
+    trace_end("png_band");
 
-        x_new = x*x - y*y + a;
-        y_new = 2.00*x*y + b;
+    g_atomic_int_inc(&save->bands_done);
+  }
 
-        //calculate square of the modulus of z
-        mzsq = x_new*x_new + y_new*y_new;
+  return NULL;
+}
 
-        x = x_new;
-        y = y_new;
+//Encodes a save as an RGB PNG. The bands are deflated by as many threads
+//as there are processors, this one included, and written as one IDAT
+//chunk each, between one with the zlib header and one with the Adler-32
+//of the whole stream, combined from those of the bands.
+static gboolean png_encode(ImageSave *save, GByteArray *out,
+                           GError **error)
+{
+  const guint8 signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+  const guint8 zlib_header[2] = {0x78, 0x01};
+  guint8 header[13];
+  guint8 trailer[4];
+  GThread **threads;
+  PngBand *band;
+  guint32 adler;
+  int processors;
+  int bands;
+  int i;
+
+  processors = g_get_num_processors();
+  bands = MAX(1, MIN(processors*SAVE_BANDS_PER_THREAD,
+                     save->height/SAVE_BAND_ROWS));
+  save->png_bands = g_new0(PngBand, bands);
+  for (i = 0; i < bands; i++)
+  {
+    save->png_bands[i].first_row = (gint64)save->height*i/bands;
+    save->png_bands[i].rows = (gint64)save->height*(i + 1)/bands -
+                              save->png_bands[i].first_row;
+  }
+  g_atomic_int_set(&save->bands, bands);
 
-        counter++;
-      }
+  threads = g_new(GThread *, processors);
+  for (i = 1; i < MIN(processors, bands); i++)
+    threads[i] = g_thread_new("png", png_band_thread, save);
+  png_band_thread(save);
+  for (i = 1; i < MIN(processors, bands); i++)
+    g_thread_join(threads[i]);
+  g_free(threads);
 
-      //Test to determine if c is a member of the Julia
-      //set and color the screen pixels according to whether
-      //the value of c is included in the set.
+  for (i = 0; i < bands; i++)
+  {
+    band = &save->png_bands[i];
+    if (band->error && *error == NULL)
+      g_propagate_error(error, band->error);
+    else if (band->error)
+      g_error_free(band->error);
+  }
+  if (*error)
+  {
+    for (i = 0; i < bands; i++)
+      if (save->png_bands[i].chunk)
+        g_byte_array_unref(save->png_bands[i].chunk);
+    return FALSE;
+  }
 
-      if (mzsq < 4.0)
-      {
-        cairo_set_source_rgb (cr, 0, 0, 0);
-        cairo_set_line_width (cr, 2.0);
-        cairo_set_line_cap (cr, CAIRO_LINE_CAP_ROUND);
-        cairo_move_to (cr, screen_x, screen_y);
-        cairo_close_path (cr);
+  g_byte_array_append(out, signature, 8);
+
+  header[0] = save->width >> 24;
+  header[1] = save->width >> 16;
+  header[2] = save->width >> 8;
+  header[3] = save->width;
+  header[4] = save->height >> 24;
+  header[5] = save->height >> 16;
+  header[6] = save->height >> 8;
+  header[7] = save->height;
+  header[8] = 8;
+  header[9] = 2;
+  header[10] = 0;
+  header[11] = 0;
+  header[12] = 0;
+  png_append_chunk(out, "IHDR", header, 13);
+
+  png_append_chunk(out, "IDAT", zlib_header, 2);
+  adler = 1;
+  for (i = 0; i < bands; i++)
+  {
+    band = &save->png_bands[i];
+    g_byte_array_append(out, band->chunk->data, band->chunk->len);
+    g_byte_array_unref(band->chunk);
+    adler = adler32_combine(adler, band->adler, band->length);
+  }
+  trailer[0] = adler >> 24;
+  trailer[1] = adler >> 16;
+  trailer[2] = adler >> 8;
+  trailer[3] = adler;
+  png_append_chunk(out, "IDAT", trailer, 4);
 
-        cairo_stroke (cr);
-      }
+  png_append_chunk(out, "IEND", NULL, 0);
 
-      else
-      {
-        cairo_set_source_rgb (cr, 0.5, 0.5, 0.5);
-        cairo_set_line_width (cr, 2.0);
-        cairo_set_line_cap (cr, CAIRO_LINE_CAP_ROUND);
-        cairo_move_to (cr, screen_x, screen_y);
-        cairo_close_path (cr);
+  return TRUE;
+}
+
+//Encodes a save as a binary PPM, the rows as they are in RGB
+static void ppm_encode(ImageSave *save, GByteArray *out)
+{
+  gchar *header;
+  guint8 *p;
+  guint32 *line;
+  guint32 v;
+  gsize length;
+  int x;
+  int y;
+
+  header = g_strdup_printf("P6\n%d %d\n255\n", save->width, save->height);
+  length = strlen(header);
+  g_byte_array_set_size(out, length + (gsize)3*save->width*save->height);
+  memcpy(out->data, header, length);
+  g_free(header);
+
+  g_atomic_int_set(&save->bands, save->height);
+  p = out->data + length;
+  for (y = 0; y < save->height; y++)
+  {
+    line = save->pixels + (gsize)y*save->width;
+    for (x = 0; x < save->width; x++)
+    {
+      v = line[x];
+      p[0] = v >> 16;
+      p[1] = v >> 8;
+      p[2] = v;
+      p += 3;
+    }
+    g_atomic_int_inc(&save->bands_done);
+  }
+}
 
-        cairo_stroke (cr);
+//Encodes a save as a QOI image with 3 channels, by the specification at
+//qoiformat.org: runs of the last pixel, the index of recently seen ones,
+//small differences from the last one, or the pixel in full
+static void qoi_encode(ImageSave *save, GByteArray *out)
+{
+  guint32 index[64];
+  guint8 *p;
+  guint32 *line;
+  guint32 pixel;
+  guint32 last;
+  int run;
+  int hash;
+  int x;
+  int y;
+  gint8 dr;
+  gint8 dg;
+  gint8 db;
+
+  //At most 4 bytes a pixel, between a 14-byte header and 8-byte end
+  g_byte_array_set_size(out, 22 + (gsize)4*save->width*save->height);
+  p = out->data;
+  memcpy(p, "qoif", 4);
+  p[4] = save->width >> 24;
+  p[5] = save->width >> 16;
+  p[6] = save->width >> 8;
+  p[7] = save->width;
+  p[8] = save->height >> 24;
+  p[9] = save->height >> 16;
+  p[10] = save->height >> 8;
+  p[11] = save->height;
+  p[12] = 3;
+  p[13] = 0;
+  p += 14;
+
+  //Pixels are kept as opaque ARGB, so that black matches the initial
+  //last pixel and not the zeroed index
+  memset(index, 0, sizeof(index));
+  last = 0xff000000;
+  run = 0;
+  g_atomic_int_set(&save->bands, save->height);
+  for (y = 0; y < save->height; y++)
+  {
+    line = save->pixels + (gsize)y*save->width;
+    for (x = 0; x < save->width; x++)
+    {
+      pixel = line[x] | 0xff000000;
+      if (pixel == last)
+      {
+        run++;
+        if (run == 62)
+        {
+          *p++ = 0xc0 | (run - 1);
+          run = 0;
+        }
+        continue;
+      }
+      if (run > 0)
+      {
+        *p++ = 0xc0 | (run - 1);
+        run = 0;
       }
-      gtk_widget_queue_draw_area(drawing_area, screen_x, screen_y, 1, 1);
 
-      while (gtk_events_pending())
+      hash = (((pixel >> 16) & 0xff)*3 + ((pixel >> 8) & 0xff)*5 +
+              (pixel & 0xff)*7 + 255*11) % 64;
+      if (index[hash] == pixel)
       {
-        gtk_main_iteration();
+        *p++ = hash;
       }
+      else
+      {
+        index[hash] = pixel;
+        dr = ((pixel >> 16) & 0xff) - ((last >> 16) & 0xff);
+        dg = ((pixel >> 8) & 0xff) - ((last >> 8) & 0xff);
+        db = (pixel & 0xff) - (last & 0xff);
+        if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 &&
+            db >= -2 && db <= 1)
+        {
+          *p++ = 0x40 | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2);
+        }
+        else if (dg >= -32 && dg <= 31 && dr - dg >= -8 && dr - dg <= 7 &&
+                 db - dg >= -8 && db - dg <= 7)
+        {
+          *p++ = 0x80 | (dg + 32);
+          *p++ = (dr - dg + 8) << 4 | (db - dg + 8);
+        }
+        else
+        {
+          p[0] = 0xfe;
+          p[1] = pixel >> 16;
+          p[2] = pixel >> 8;
+          p[3] = pixel;
+          p += 4;
+        }
+      }
+      last = pixel;
     }
+    g_atomic_int_inc(&save->bands_done);
+  }
+  if (run > 0)
+    *p++ = 0xc0 | (run - 1);
+
+  memset(p, 0, 7);
+  p[7] = 1;
+  p += 8;
+  g_byte_array_set_size(out, p - out->data);
+}
+
+//Shared-memory output
+
+//Makes the memfd buffer of --shm-output and listens on its socket
+static gboolean shm_output_open(const gchar *path)
+{
+  ShmOutput *output;
+  struct sockaddr_un address;
+  int stride;
+
+  if (strlen(path) >= sizeof(address.sun_path))
+  {
+    g_printerr("%s: socket path too long\n", path);
+    return FALSE;
+  }
+
+  output = g_new0(ShmOutput, 1);
+  output->path = g_strdup(path);
+  output->clients = g_array_new(FALSE, FALSE, sizeof(int));
+  output->listen_fd = -1;
+
+  stride = cairo_format_stride_for_width(CAIRO_FORMAT_RGB24, DAWIDTH);
+  output->size = SHM_OUTPUT_OFFSET + (gsize)stride*DAHEIGHT;
+
+  //Sealed at its size, so clients can map it without fearing SIGBUS
+  output->memfd = memfd_create("fractal7", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+  if (output->memfd < 0 || ftruncate(output->memfd, output->size) < 0 ||
+      fcntl(output->memfd, F_ADD_SEALS,
+            F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) < 0)
+    goto fail;
+
+  output->map = mmap(NULL, output->size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                     output->memfd, 0);
+  if (output->map == MAP_FAILED)
+  {
+    output->map = NULL;
+    goto fail;
   }
-  cairo_destroy (cr);
 
-  //gtk_widget_queue_draw(drawing_area);
+  output->header = (ShmOutputHeader *)output->map;
+  output->header->magic = SHM_OUTPUT_MAGIC;
+  output->header->version = SHM_OUTPUT_VERSION;
+  output->header->width = DAWIDTH;
+  output->header->height = DAHEIGHT;
+  output->header->stride = stride;
+  output->header->format = CAIRO_FORMAT_RGB24;
+  output->header->offset = SHM_OUTPUT_OFFSET;
+
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  strcpy(address.sun_path, path);
+  unlink(path);
+
+  output->listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC |
+                                      SOCK_NONBLOCK, 0);
+  if (output->listen_fd < 0 ||
+      bind(output->listen_fd, (struct sockaddr *)&address,
+           sizeof(address)) < 0 ||
+      listen(output->listen_fd, 8) < 0)
+    goto fail;
+
+  g_unix_fd_add(output->listen_fd, G_IO_IN, shm_output_accept, output);
+  shm_output = output;
+
+  return TRUE;
+
+fail:
+  g_printerr("%s: %s\n", path, g_strerror(errno));
+  shm_output = output;
+  shm_output_close();
+
+  return FALSE;
 }
 
-//Generates and displays Julia/Sine set
+//Hands a new client the buffer's fd along with the current sequence
+static gboolean shm_output_accept(gint fd, GIOCondition condition,
+                                  gpointer data)
+{
+  ShmOutput *output = data;
+  struct msghdr message;
+  struct iovec iov;
+  struct cmsghdr *cmsg;
+  char control[CMSG_SPACE(sizeof(int))];
+  guint64 sequence;
+  int client;
+
+  client = accept4(fd, NULL, NULL, SOCK_CLOEXEC | SOCK_NONBLOCK);
+  if (client < 0)
+    return G_SOURCE_CONTINUE;
+
+  sequence = __atomic_load_n(&output->header->sequence, __ATOMIC_ACQUIRE);
+  iov.iov_base = &sequence;
+  iov.iov_len = sizeof(sequence);
+
+  memset(&message, 0, sizeof(message));
+  memset(control, 0, sizeof(control));
+  message.msg_iov = &iov;
+  message.msg_iovlen = 1;
+  message.msg_control = control;
+  message.msg_controllen = sizeof(control);
+
+  cmsg = CMSG_FIRSTHDR(&message);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+  memcpy(CMSG_DATA(cmsg), &output->memfd, sizeof(int));
+
+  if (sendmsg(client, &message, MSG_NOSIGNAL) == sizeof(sequence))
+    g_array_append_val(output->clients, client);
+  else
+    close(client);
+
+  return G_SOURCE_CONTINUE;
+}
 
-/*
-xk+1 = sin(xk) cosh(yk)
-yk+1 = cos(xk) sinh(yk)
-*/
-static void juliasin(GtkWidget* drawing_area)
+//Marks the pixels as being written: the sequence goes odd
+static void shm_output_begin(void)
 {
-  closing = FALSE;
+  if (shm_output == NULL)
+    return;
 
-  cairo_t *cr;
+  __atomic_add_fetch(&shm_output->header->sequence, 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+}
 
-  cr = cairo_create (surface);
+//Marks the pixels as consistent again and tells the clients. A client
+//that has not read the last notifications misses this one, which only
+//says the same; one that has gone away is dropped.
+static void shm_output_end(void)
+{
+  ShmOutputHeader *header;
+  RenderRequest *request = current_request;
+  guint64 sequence;
+  guint i;
+  int client;
 
-  int width = DAWIDTH;
-  int height = DAHEIGHT;
-  int screen_x;
-  int screen_y;
-  long double d_screen_x;
-  long double a;
-  long double d_screen_y;
-  long double b;
-  long double mzsq;
-  int counter;
-  long double x_new;
-  long double y_new;
-  long double x;
-  long double y;
-  long double z_re;
-  long double z_im;
+  if (shm_output == NULL)
+    return;
 
-  a = (long double)parameter_a;
-  b = (long double)parameter_b;
+  header = shm_output->header;
+  if (request)
+  {
+    header->generation = request->generation;
+    header->finished = render_flush_id == 0 && !render_stats.stopped;
+  }
+  sequence = __atomic_add_fetch(&header->sequence, 1, __ATOMIC_RELEASE);
 
-  for (screen_x = 1; screen_x < width && closing == FALSE; screen_x++)
+  for (i = 0; i < shm_output->clients->len; )
   {
-    //transforms int screen_x to a long double value in the complex plane
-    d_screen_x = (long double)screen_x;
-    z_re = d_screen_x/(width/5) - 2.0;
-    //x = d_screen_x/(width/5) - 2.0;
+    client = g_array_index(shm_output->clients, int, i);
 
-    while (gtk_events_pending())
+    if (send(client, &sequence, sizeof(sequence),
+             MSG_NOSIGNAL | MSG_DONTWAIT) < 0 && errno != EAGAIN)
     {
-      gtk_main_iteration();
+      close(client);
+      g_array_remove_index_fast(shm_output->clients, i);
     }
-
-    for (screen_y = 1; screen_y < height && closing == FALSE; screen_y++)
+    else
     {
-      //transforms int screen_y to a long double value in the complex plane
-      d_screen_y = (long double)screen_y;
-      z_im = -(d_screen_y/(height/3) - 1.5);
-      //y = -(d_screen_y/(height/3) - 1.5);
-
-      x = z_re;
-      y = z_im;
-
-      mzsq = 0.0;
-      counter = 0;
-
-      while (gtk_events_pending())
-      {
-        gtk_main_iteration();
-      }
+      i++;
+    }
+  }
+}
 
-      while (counter < 100 && closing == FALSE)
-      {
-        //loop to iterate function F(z) = z*z + c
+//Closes the clients and the socket; the buffer goes with the last mapping
+static void shm_output_close(void)
+{
+  ShmOutput *output = shm_output;
+  guint i;
 
-        /*
-        x_new = x*x - y*y + a;
-        y_new = 2.00*x*y + b;
-        */
+  if (output == NULL)
+    return;
 
-        x_new = sin(x)*cosh(y) + a;
+  for (i = 0; i < output->clients->len; i++)
+    close(g_array_index(output->clients, int, i));
+  g_array_free(output->clients, TRUE);
 
-        y_new = cos(x)*sinh(y) + b;
+  if (output->listen_fd >= 0)
+  {
+    close(output->listen_fd);
+    unlink(output->path);
+  }
+  if (output->map)
+    munmap(output->map, output->size);
+  if (output->memfd >= 0)
+    close(output->memfd);
+
+  g_free(output->path);
+  g_free(output);
+  shm_output = NULL;
+}
 
+//Startup
 
-        //calculate square of the modulus of z
-        mzsq = x_new*x_new + y_new*y_new;
+//The application icon, decoded from icon_png the first time it is needed.
+//It is kept for the life of the program; callers do not unref it.
+static GdkPixbuf *app_icon(void)
+{
+  GInputStream *stream;
 
-        x = x_new;
-        y = y_new;
+  if (icon_pixbuf)
+    return icon_pixbuf;
 
-        counter++;
-      }
+  stream = g_memory_input_stream_new_from_data(icon_png, sizeof(icon_png),
+                                               NULL);
+  icon_pixbuf = gdk_pixbuf_new_from_stream(stream, NULL, NULL);
+  g_object_unref(stream);
 
-      //Test to determine if c is a member of the Julia
-      //set and color the screen pixels according to whether
-      //the value of c is included in the set.
+  return icon_pixbuf;
+}
 
-      if (mzsq < 4.0)
-      {
-        cairo_set_source_rgb (cr, 0, 0, 0);
-        cairo_set_line_width (cr, 2.0);
-        cairo_set_line_cap (cr, CAIRO_LINE_CAP_ROUND);
-        cairo_move_to (cr, screen_x, screen_y);
-        cairo_close_path (cr);
+//A file of the kept session, in the user's cache directory
+static gchar *session_filename(const gchar *name)
+{
+  return g_build_filename(g_get_user_cache_dir(), "fractal7", name, NULL);
+}
 
-        cairo_stroke (cr);
-      }
+//Restores the fractal, parameters, precision and view of the last run,
+//if any, before the widgets are made from them
+static void session_load(void)
+{
+  GKeyFile *key_file;
+  gchar *filename;
+  gchar *name;
+  int i;
 
-      else
-      {
-        cairo_set_source_rgb (cr, 0.5, 0.5, 0.5);
-        cairo_set_line_width (cr, 2.0);
-        cairo_set_line_cap (cr, CAIRO_LINE_CAP_ROUND);
-        cairo_move_to (cr, screen_x, screen_y);
-        cairo_close_path (cr);
+  key_file = g_key_file_new();
+  filename = session_filename("session.ini");
 
-        cairo_stroke (cr);
-      }
-      gtk_widget_queue_draw_area(drawing_area, screen_x, screen_y, 1, 1);
+  if (g_key_file_load_from_file(key_file, filename, G_KEY_FILE_NONE, NULL))
+  {
+    name = g_key_file_get_string(key_file, "session", "fractal", NULL);
+    for (i = 0; name && i < FRACTAL_FORMULA; i++)
+    {
+      if (strcmp(name, fractal_names[i]) == 0)
+        session_type = i;
+    }
+    g_free(name);
 
-      while (gtk_events_pending())
-      {
-        gtk_main_iteration();
-      }
+    name = g_key_file_get_string(key_file, "session", "precision", NULL);
+    for (i = 0; name && i < PRECISION_COUNT; i++)
+    {
+      if (strcmp(name, precision_names[i]) == 0)
+        render_precision = i;
     }
+    g_free(name);
+  }
+
+  if (session_type != FRACTAL_COUNT)
+  {
+    parameter_a = g_key_file_get_double(key_file, "session", "a", NULL);
+    parameter_b = g_key_file_get_double(key_file, "session", "b", NULL);
+    lorenz_yaw = g_key_file_get_double(key_file, "session", "yaw", NULL);
+    lorenz_pitch = g_key_file_get_double(key_file, "session", "pitch", NULL);
+
+    //The view as render_set_view() would have left it for this fractal
+    view_type = session_type;
+    view_julia_style = FALSE;
+    view_zoom = g_key_file_get_double(key_file, "session", "zoom", NULL);
+    view_center_re = (__int128)((unsigned __int128)
+      g_key_file_get_uint64(key_file, "session", "center-re-hi", NULL) << 64 |
+      g_key_file_get_uint64(key_file, "session", "center-re-lo", NULL));
+    view_center_im = (__int128)((unsigned __int128)
+      g_key_file_get_uint64(key_file, "session", "center-im-hi", NULL) << 64 |
+      g_key_file_get_uint64(key_file, "session", "center-im-lo", NULL));
+
+    if (!(view_zoom > 0))
+      view_type = FRACTAL_COUNT;
   }
-  cairo_destroy (cr);
 
-  //gtk_widget_queue_draw(drawing_area);
+  g_free(filename);
+  g_key_file_free(key_file);
 }
 
-//Generates and displays Mandelbrot set
-static void mandel(GtkWidget* drawing_area)
+//Fills the new drawing area: with the image kept from the last run when
+//there is one, which then stands for a finished render of the kept view,
+//otherwise by rendering the kept fractal, or the Mandelbrot set
+static void session_show(GtkWidget *drawing_area)
 {
-  closing = FALSE;
-
+  cairo_surface_t *image = NULL;
   cairo_t *cr;
+  gchar *filename;
 
-  cr = cairo_create (surface);
-
-  int width = DAWIDTH;
-  int height = DAHEIGHT;
-  int screen_x;
-  int screen_y;
-  long double d_screen_x;
-  long double a;
-  long double d_screen_y;
-  long double b;
-  long double mzsq;
-  int counter;
-  long double x_new;
-  long double y_new;
-  long double x;
-  long double y;
-
-  for (screen_x = 1; screen_x < width && closing == FALSE; screen_x++)
+  if (session_type != FRACTAL_COUNT)
   {
-    d_screen_x = (long double)screen_x;
-    a = d_screen_x/(width/5) - 2.5;
-
-    //transforms m to a value in the complex plane with the origin placed
-    //somewhat ofset from the center of the window, to provide a good image
-    //of the set
+    filename = session_filename("session.png");
+    image = cairo_image_surface_create_from_png(filename);
+    g_free(filename);
 
-    for (screen_y = 1; screen_y < height && closing == FALSE; screen_y++)
+    if (cairo_surface_status(image) != CAIRO_STATUS_SUCCESS ||
+        cairo_image_surface_get_width(image) != DAWIDTH ||
+        cairo_image_surface_get_height(image) != DAHEIGHT)
     {
-      d_screen_y = (long double)screen_y;
-      b = -(d_screen_y/(height/3) - 1.5);
-      //transforms n to a value in the complex plane
-
-      x = 0.0;
-      y = 0.0;
-      mzsq = 0.0;
-      counter = 0;
+      cairo_surface_destroy(image);
+      image = NULL;
+    }
+  }
 
-      while (counter < 100 && closing == FALSE)
-      {
-      //loop to iterate function z = z*z + c
+  if (image == NULL)
+  {
+    if (session_type == FRACTAL_LORENZ_3D)
+      lorenz_3d_vertices();
+    render_start(drawing_area, session_type != FRACTAL_COUNT ?
+                               session_type : FRACTAL_MANDEL);
+    return;
+  }
 
-        x_new = x*x - y*y + a;
-        y_new = 2.00*x*y + b;
-        //calculate square of the modulus of z
-        mzsq = x_new*x_new + y_new*y_new;
+  cr = cairo_create(surface);
+  cairo_set_source_surface(cr, image, 0, 0);
+  cairo_paint(cr);
+  cairo_destroy(cr);
+  cairo_surface_destroy(image);
 
-        x = x_new;
-        y = y_new;
+  //Zoom clicks and drags work from this request; nothing is queued for it
+  current_request = render_request_new(session_type, render_precision);
+  startup_image = "kept image";
+}
 
-        counter++;
-      }
+//Keeps the fractal, parameters and view for the next run, with the image
+//when its render finished. Formulas are not kept, nor are the runs of
+//the benchmarks.
+static void session_save(GtkWidget *widget, gpointer data)
+{
+  RenderRequest *request = current_request;
+  GKeyFile *key_file;
+  cairo_surface_t *image;
+  cairo_t *cr;
+  gchar *directory;
+  gchar *filename;
+  GError *error = NULL;
+
+  if (request == NULL || request->type == FRACTAL_FORMULA || ui_benchmark ||
+      startup_benchmark)
+    return;
+
+  directory = g_build_filename(g_get_user_cache_dir(), "fractal7", NULL);
+  g_mkdir_with_parents(directory, 0700);
+  g_free(directory);
+
+  key_file = g_key_file_new();
+  g_key_file_set_string(key_file, "session", "fractal",
+                        fractal_names[request->type]);
+  g_key_file_set_string(key_file, "session", "precision",
+                        precision_names[request->precision]);
+  g_key_file_set_double(key_file, "session", "a", parameter_a);
+  g_key_file_set_double(key_file, "session", "b", parameter_b);
+  g_key_file_set_double(key_file, "session", "yaw", lorenz_yaw);
+  g_key_file_set_double(key_file, "session", "pitch", lorenz_pitch);
+  g_key_file_set_double(key_file, "session", "zoom", (double)view_zoom);
+  g_key_file_set_uint64(key_file, "session", "center-re-hi",
+                        (guint64)((unsigned __int128)view_center_re >> 64));
+  g_key_file_set_uint64(key_file, "session", "center-re-lo",
+                        (guint64)view_center_re);
+  g_key_file_set_uint64(key_file, "session", "center-im-hi",
+                        (guint64)((unsigned __int128)view_center_im >> 64));
+  g_key_file_set_uint64(key_file, "session", "center-im-lo",
+                        (guint64)view_center_im);
+
+  filename = session_filename("session.ini");
+  if (!g_key_file_save_to_file(key_file, filename, &error))
+  {
+    g_printerr("%s: %s\n", filename, error->message);
+    g_error_free(error);
+  }
+  g_free(filename);
+  g_key_file_free(key_file);
 
-      //Test to determine if c is a member of the Mandelbrot
-      //set and color the screen pixels according to whether or not
-      //the value of c is included in the set.
+  //A render still running or stopped leaves a partial image, which is
+  //not kept; the next run renders the view again
+  filename = session_filename("session.png");
+  if (render_flush_id == 0 && !render_stats.stopped && surface)
+  {
+    image = cairo_image_surface_create(CAIRO_FORMAT_RGB24,
+                                       request->width, request->height);
+    cr = cairo_create(image);
+    cairo_set_source_surface(cr, surface, 0, 0);
+    cairo_paint(cr);
+    cairo_destroy(cr);
+    cairo_surface_write_to_png(image, filename);
+    cairo_surface_destroy(image);
+  }
+  else
+  {
+    g_remove(filename);
+  }
+  g_free(filename);
+}
 
-      if (mzsq < 4.0)
-      {
-        cairo_set_source_rgb (cr, 0, 0, 0);
-        cairo_set_line_width (cr, 2.0);
-        cairo_set_line_cap (cr, CAIRO_LINE_CAP_ROUND);
-        cairo_move_to (cr, screen_x, screen_y);
-        cairo_close_path (cr);
+//Called after each frame until the first one with an image in it, from
+//the kept session or the first tile of a render. With --startup-benchmark
+//it prints the time since main() started and quits.
+static void startup_painted(void)
+{
+  double elapsed;
 
-        cairo_stroke (cr);
-      }
+  if (startup_time == 0 || startup_image == NULL)
+    return;
 
-      else
-      {
-        cairo_set_source_rgb (cr, 0.5, 0.5, 0.5);
-        cairo_set_line_width (cr, 2.0);
-        cairo_set_line_cap (cr, CAIRO_LINE_CAP_ROUND);
-        cairo_move_to (cr, screen_x, screen_y);
-        cairo_close_path (cr);
+  elapsed = (g_get_monotonic_time() - startup_time)/1000.0;
+  startup_time = 0;
 
-        cairo_stroke (cr);
-      }
-      gtk_widget_queue_draw_area(drawing_area, screen_x, screen_y, 1, 1);
+  if (!startup_benchmark)
+    return;
 
-      while (gtk_events_pending())
-      {
-        gtk_main_iteration();
-      }
-    }
-  }
-  cairo_destroy (cr);
+  g_print("first image after %.1f ms (%s)\n", elapsed, startup_image);
+  startup_failed = elapsed > STARTUP_BUDGET;
+  if (startup_failed)
+    g_print("FAILED: over %d ms\n", STARTUP_BUDGET);
 
-  //gtk_widget_queue_draw(drawing_area);
+  g_application_quit(g_application_get_default());
 }
 
 //Makes a neutral surface to draw on
@@ -794,7 +9527,9 @@ static void clear_surface (void)
 //to clear and redraw surface
 static void clear_drawing_area (GtkWidget* drawing_area)
 {
+  shm_output_begin();
   clear_surface();
+  shm_output_end();
 
   gtk_widget_queue_draw(drawing_area);
 }
@@ -806,14 +9541,29 @@ static gboolean configure_event (GtkWidget *widget,
   if (surface)
     cairo_surface_destroy (surface);
 
-  surface = gdk_window_create_similar_surface (gtk_widget_get_window (widget),
-                                               CAIRO_CONTENT_COLOR,
-                                               gtk_widget_get_allocated_width (widget),
-                                               gtk_widget_get_allocated_height (widget));
+  //With --shm-output the image is drawn straight into the shared buffer
+  if (shm_output)
+    surface = cairo_image_surface_create_for_data (shm_output->map +
+                                                   SHM_OUTPUT_OFFSET,
+                                                   CAIRO_FORMAT_RGB24,
+                                                   DAWIDTH, DAHEIGHT,
+                                                   shm_output->header->stride);
+  else
+    surface = gdk_window_create_similar_surface (gtk_widget_get_window (widget),
+                                                 CAIRO_CONTENT_COLOR,
+                                                 gtk_widget_get_allocated_width (widget),
+                                                 gtk_widget_get_allocated_height (widget));
 
   //Initialize the surface
+  shm_output_begin ();
   clear_surface ();
 
+  //The first time, show the last session at once
+  if (!session_started && !ui_benchmark)
+    session_show(widget);
+  session_started = TRUE;
+  shm_output_end ();
+
   //Returns TRUE so no additional processing by system takes place
   return TRUE;
 }
@@ -827,7 +9577,8 @@ static gboolean delete_event(GtkWidget *widget,
      * GTK will emit the "destroy" signal. Returning TRUE means
      * you don't want the window to be destroyed.
     */
-  closing = TRUE;
+  session_save(widget, NULL);
+  render_cancel();
 
   return FALSE;
 }
@@ -836,41 +9587,152 @@ static gboolean delete_event(GtkWidget *widget,
 //Calls henon(drawing_area) and includes GtkButton* button parameter
 static void henondraw (GtkWidget *drawing_area, GtkButton* button)
 {
-  henon(drawing_area);
+  trace_begin("henondraw");
+  render_start(drawing_area, FRACTAL_HENON);
+  trace_end("henondraw");
 }
 
 //Calls lorenz_xy(drawing area) and includes GtkButton* button parameter
 static void lorenz_xydraw(GtkWidget* drawing_area, GtkButton* button)
 {
-  lorenz_xy(drawing_area);
+  trace_begin("lorenz_xydraw");
+  render_start(drawing_area, FRACTAL_LORENZ_XY);
+  trace_end("lorenz_xydraw");
 }
 
 static void lorenz_yzdraw(GtkWidget* drawing_area, GtkButton* button)
 {
-  lorenz_yz(drawing_area);
+  trace_begin("lorenz_yzdraw");
+  render_start(drawing_area, FRACTAL_LORENZ_YZ);
+  trace_end("lorenz_yzdraw");
 }
 
 static void lorenz_xzdraw(GtkWidget* drawing_area, GtkButton* button)
 {
-  lorenz_xz(drawing_area);
+  trace_begin("lorenz_xzdraw");
+  render_start(drawing_area, FRACTAL_LORENZ_XZ);
+  trace_end("lorenz_xzdraw");
+}
+
+//Draws the 3D Lorenz view, computing the trajectory the first time
+static void lorenz_3ddraw(GtkWidget* drawing_area, GtkButton* button)
+{
+  trace_begin("lorenz_3ddraw");
+  lorenz_3d_vertices();
+  render_start(drawing_area, FRACTAL_LORENZ_3D);
+  trace_end("lorenz_3ddraw");
 }
 
 //Calls julia(drawing_area) and includes GtkButton* button parameter
 static void juliadraw (GtkWidget *drawing_area, GtkButton* button)
 {
-  julia(drawing_area);
+  trace_begin("juliadraw");
+  render_start(drawing_area, FRACTAL_JULIA);
+  trace_end("juliadraw");
 }
 
 //Calls juliasin(drawing_area) and includes GtkButton* button parameter
 static void juliasindraw (GtkWidget *drawing_area, GtkButton* button)
 {
-  juliasin(drawing_area);
+  trace_begin("juliasindraw");
+  render_start(drawing_area, FRACTAL_JULIASIN);
+  trace_end("juliasindraw");
 }
 
 //Calls mandel(drawing_area) and includes GtkButton* button parameter
 static void mandeldraw (GtkWidget *drawing_area, GtkButton* button)
 {
-  mandel(drawing_area);
+  trace_begin("mandeldraw");
+  render_start(drawing_area, FRACTAL_MANDEL);
+  trace_end("mandeldraw");
+}
+
+//Asks for a user formula, compiles it and renders it. The dialog stays
+//open until the formula parses or is cancelled.
+static void formuladraw(GtkWidget *drawing_area, GtkButton* button)
+{
+  GtkWidget *dialog;
+  GtkWidget *grid;
+  GtkWidget *formula_entry;
+  GtkWidget *start_entry;
+  GtkWidget *julia_check;
+  GtkWidget *message;
+  Formula *formula = NULL;
+  GError *error = NULL;
+
+  dialog = gtk_dialog_new_with_buttons("Formula",
+            GTK_WINDOW(gtk_widget_get_toplevel(drawing_area)),
+            GTK_DIALOG_MODAL | GTK_DIALOG_DESTROY_WITH_PARENT,
+            "_Cancel", GTK_RESPONSE_CANCEL,
+            "_Render", GTK_RESPONSE_ACCEPT,
+            NULL);
+  gtk_dialog_set_default_response(GTK_DIALOG(dialog), GTK_RESPONSE_ACCEPT);
+
+  formula_entry = gtk_entry_new();
+  gtk_entry_set_text(GTK_ENTRY(formula_entry),
+                     current_formula ? current_formula->text : "z^3 + c");
+  gtk_entry_set_activates_default(GTK_ENTRY(formula_entry), TRUE);
+
+  start_entry = gtk_entry_new();
+  gtk_entry_set_text(GTK_ENTRY(start_entry),
+                     current_formula ? current_formula->start_text : "0");
+  gtk_entry_set_activates_default(GTK_ENTRY(start_entry), TRUE);
+
+  julia_check = gtk_check_button_new_with_label(
+                  "Julia style: start at the pixel, c = a + bi");
+  gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(julia_check),
+                               current_formula &&
+                               current_formula->julia_style);
+
+  grid = gtk_grid_new();
+  gtk_grid_set_row_spacing(GTK_GRID(grid), 5);
+  gtk_grid_set_column_spacing(GTK_GRID(grid), 5);
+  gtk_container_set_border_width(GTK_CONTAINER(grid), 5);
+  gtk_grid_attach(GTK_GRID(grid), gtk_label_new("z ->"), 0, 0, 1, 1);
+  gtk_grid_attach(GTK_GRID(grid), formula_entry, 1, 0, 1, 1);
+  gtk_grid_attach(GTK_GRID(grid), gtk_label_new("z0 ="), 0, 1, 1, 1);
+  gtk_grid_attach(GTK_GRID(grid), start_entry, 1, 1, 1, 1);
+  gtk_grid_attach(GTK_GRID(grid), julia_check, 0, 2, 2, 1);
+  gtk_grid_attach(GTK_GRID(grid),
+                  gtk_label_new("+ - * / ^, sin cos sinh cosh exp log conj,"
+                                " i, pi"), 0, 3, 2, 1);
+
+  gtk_container_add(GTK_CONTAINER(
+                      gtk_dialog_get_content_area(GTK_DIALOG(dialog))), grid);
+  gtk_widget_show_all(dialog);
+
+  while (gtk_dialog_run(GTK_DIALOG(dialog)) == GTK_RESPONSE_ACCEPT)
+  {
+    formula = formula_new(gtk_entry_get_text(GTK_ENTRY(formula_entry)),
+                          gtk_entry_get_text(GTK_ENTRY(start_entry)),
+                          gtk_toggle_button_get_active(
+                            GTK_TOGGLE_BUTTON(julia_check)),
+                          &error);
+    if (formula)
+      break;
+
+    message = gtk_message_dialog_new(GTK_WINDOW(dialog),
+                GTK_DIALOG_DESTROY_WITH_PARENT,
+                GTK_MESSAGE_ERROR,
+                GTK_BUTTONS_OK,
+                "%s", error->message);
+    gtk_dialog_run(GTK_DIALOG(message));
+    gtk_widget_destroy(message);
+    g_clear_error(&error);
+  }
+
+  gtk_widget_destroy(dialog);
+
+  if (formula == NULL)
+    return;
+
+  if (current_formula)
+    formula_free(current_formula);
+  current_formula = formula;
+
+  trace_begin("formuladraw");
+  render_start(drawing_area, FRACTAL_FORMULA);
+  trace_end("formuladraw");
 }
 
 //sets surface as source for cairo context cr and paints
@@ -884,7 +9746,124 @@ static void do_drawing(cairo_t *cr)
 static gboolean on_draw_event(GtkWidget *widget, cairo_t *cr,
     gpointer user_data)
 {
+  trace_begin("on_draw_event");
   do_drawing(cr);
+  julia_preview_draw(cr);
+  trace_end("on_draw_event");
+
+  if (startup_time)
+    startup_painted();
+
+  return FALSE;
+}
+
+//Zoom on the escape-time fractals: left click zooms in on the point
+//clicked, right click zooms back out around the same center, and middle
+//click returns to the initial view
+static gboolean button_press_event(GtkWidget *widget, GdkEventButton *event,
+                                   gpointer data)
+{
+  RenderRequest *request = current_request;
+  FractalType type;
+  int x = (int)event->x;
+  int y = (int)event->y;
+
+  //A drag turning the 3D Lorenz view starts
+  if (event->type == GDK_BUTTON_PRESS && event->button == 1 &&
+      request && request->type == FRACTAL_LORENZ_3D)
+  {
+    lorenz_drag_x = x;
+    lorenz_drag_y = y;
+    return TRUE;
+  }
+
+  if (event->type != GDK_BUTTON_PRESS || request == NULL ||
+      !render_kernel(request->type, request->precision, request->simd) ||
+      x < 0 || x >= request->width || y < 0 || y >= request->height)
+    return FALSE;
+
+  type = request->type;
+
+  if (event->button == 1 && (event->state & GDK_SHIFT_MASK) &&
+      request->inverse)
+  {
+    julia_drag(widget, x, y);
+    return TRUE;
+  }
+
+  if (event->button == 1)
+  {
+    view_center_re = request->view_re_min + x*request->view_step_x;
+    view_center_im = request->view_im_max - y*request->view_step_y;
+    view_zoom *= VIEW_ZOOM_STEP;
+  }
+  else if (event->button == 3)
+  {
+    view_zoom = MAX(1.0, view_zoom/VIEW_ZOOM_STEP);
+  }
+  else if (event->button == 2)
+  {
+    view_type = FRACTAL_COUNT;
+  }
+  else
+  {
+    return FALSE;
+  }
+
+  render_start(widget, type);
+
+  return TRUE;
+}
+
+//Dragging turns the 3D Lorenz view, and shift-dragging over a Julia set
+//drawn by inverse iteration moves c along with the pointer. Otherwise,
+//while a render is in flight, the tiles around the pointer go first, and
+//with Julia preview on the inset follows the pointer.
+static gboolean motion_notify_event(GtkWidget *widget, GdkEventMotion *event,
+                                    gpointer data)
+{
+  RenderRequest *request = current_request;
+  int x = (int)event->x;
+  int y = (int)event->y;
+
+  if ((event->state & GDK_SHIFT_MASK) && (event->state & GDK_BUTTON1_MASK) &&
+      request && request->inverse &&
+      x >= 0 && x < request->width && y >= 0 && y < request->height)
+  {
+    julia_drag(widget, x, y);
+    return TRUE;
+  }
+
+  if ((event->state & GDK_BUTTON1_MASK) && request &&
+      request->type == FRACTAL_LORENZ_3D)
+  {
+    lorenz_yaw += (x - lorenz_drag_x)*LORENZ_3D_DRAG;
+    lorenz_pitch += (y - lorenz_drag_y)*LORENZ_3D_DRAG;
+    lorenz_drag_x = x;
+    lorenz_drag_y = y;
+
+    //The view may have come from the kept image, drawn without the
+    //trajectory
+    lorenz_3d_vertices();
+    render_start(widget, FRACTAL_LORENZ_3D);
+    return TRUE;
+  }
+
+  if (render_flush_id != 0)
+    render_set_focus((int)event->x, (int)event->y);
+
+  if (render_julia_preview)
+    julia_preview_update(widget, x, y);
+
+  return FALSE;
+}
+
+//...and once the pointer leaves the drawing area, those at the center
+static gboolean leave_notify_event(GtkWidget *widget,
+                                   GdkEventCrossing *event, gpointer data)
+{
+  render_set_focus(-1, -1);
+  julia_preview_hide(widget);
 
   return FALSE;
 }
@@ -907,9 +9886,75 @@ static void enter_button_b_clicked(GtkWidget *button, gpointer data)
   parameter_b = gtk_spin_button_get_value(parameter_b_spin);
 }
 
+//Callback for the Precision menu; takes effect with the next render
+static void precision_toggled(GtkCheckMenuItem *item, gpointer data)
+{
+  if (gtk_check_menu_item_get_active(item))
+    render_precision = GPOINTER_TO_INT(data);
+}
+
+//Callbacks for the antialiasing items of the Precision menu; they take
+//effect with the next render as well
+static void antialias_toggled(GtkCheckMenuItem *item, gpointer data)
+{
+  render_antialias = gtk_check_menu_item_get_active(item);
+}
+
+static void show_samples_toggled(GtkCheckMenuItem *item, gpointer data)
+{
+  render_show_samples = gtk_check_menu_item_get_active(item);
+}
+
+static void distance_toggled(GtkCheckMenuItem *item, gpointer data)
+{
+  render_distance = gtk_check_menu_item_get_active(item);
+}
+
+static void inverse_toggled(GtkCheckMenuItem *item, gpointer data)
+{
+  render_inverse = gtk_check_menu_item_get_active(item);
+}
+
+static void julia_preview_toggled(GtkCheckMenuItem *item, gpointer data)
+{
+  render_julia_preview = gtk_check_menu_item_get_active(item);
+
+  if (!render_julia_preview)
+    julia_preview_hide(data);
+}
+
+//Doubles the iteration limit of the finished render, continuing only the
+//pixels still undecided
+static void more_iterations_activated(GtkMenuItem *item, gpointer data)
+{
+  if (render_flush_id == 0)
+    render_deepen(data);
+}
+
+static void auto_deepen_toggled(GtkCheckMenuItem *item, gpointer data)
+{
+  render_auto_deepen = gtk_check_menu_item_get_active(item);
+
+  if (render_auto_deepen && render_flush_id == 0 && render_deepen_wanted())
+    render_deepen(data);
+}
+
 static void stop_function(void)
 {
-  closing = TRUE;
+  render_cancel();
+  render_stats_show();
+}
+
+//Sets c of the Julia set drawn by inverse iteration to the point under
+//(x, y) and draws it again; the view stays where it is
+static void julia_drag(GtkWidget *widget, int x, int y)
+{
+  RenderRequest *request = current_request;
+
+  parameter_a = (double)(request->re_min + x/request->x_scale);
+  parameter_b = (double)(request->im_max - y/request->y_scale);
+
+  render_start(widget, FRACTAL_JULIA);
 }
 
 //callback function for quit_menu_item
@@ -917,7 +9962,7 @@ static gboolean close_app(GtkWidget *widget,
                              GdkEvent  *event,
                              gpointer   data )
 {
-  closing = TRUE;
+  render_cancel();
 
   gtk_widget_destroy(data);
 
@@ -958,58 +10003,71 @@ static void open_function(GtkButton* button, gpointer user_data)
 	gtk_widget_destroy (dialog);
 }
 
+//Asks for a file name and saves the image in the format of the filter
+//chosen, unless the name has the extension of another; the save itself
+//goes on in the background (image_save_start())
 static void save_function(GtkButton* button, gpointer user_data)
 {
   gchar *filename;
-  cairo_t *cr;
-  GtkWidget *image;
-	GtkWidget *toplevel;
-	GtkFileFilter *filter;
+  gchar *pattern;
+  GtkWidget *toplevel;
+  GtkWidget *dialog;
+  GtkFileFilter *filter;
+  int format;
 
-  cr = cairo_create (surface);
-  image = GTK_WIDGET (user_data);
-  toplevel = gtk_widget_get_toplevel (image);
-  GtkWidget *dialog =
-  gtk_file_chooser_dialog_new("Save image",
-                              GTK_WINDOW(toplevel),
-                              GTK_FILE_CHOOSER_ACTION_SAVE,
-                              GTK_STOCK_CANCEL, GTK_RESPONSE_CANCEL,
-                              GTK_STOCK_SAVE, GTK_RESPONSE_ACCEPT,
-                              NULL);
+  trace_begin("save_function");
 
-  gtk_file_chooser_set_do_overwrite_confirmation (GTK_FILE_CHOOSER (dialog), TRUE);
+  toplevel = gtk_widget_get_toplevel(GTK_WIDGET(user_data));
+  dialog = gtk_file_chooser_dialog_new("Save image",
+                                       GTK_WINDOW(toplevel),
+                                       GTK_FILE_CHOOSER_ACTION_SAVE,
+                                       GTK_STOCK_CANCEL, GTK_RESPONSE_CANCEL,
+                                       GTK_STOCK_SAVE, GTK_RESPONSE_ACCEPT,
+                                       NULL);
 
-  filter = gtk_file_filter_new ();
-  gtk_file_filter_add_pattern(filter,"*.png");
-  gtk_file_filter_set_name(filter,"PNG (Portable Network Graphics)");
-  gtk_file_chooser_add_filter(GTK_FILE_CHOOSER(dialog), filter);
+  gtk_file_chooser_set_do_overwrite_confirmation(GTK_FILE_CHOOSER(dialog),
+                                                 TRUE);
 
+  for (format = 0; format < IMAGE_FORMATS; format++)
+  {
+    filter = gtk_file_filter_new();
+    pattern = g_strconcat("*", image_format_extensions[format], NULL);
+    gtk_file_filter_add_pattern(filter, pattern);
+    gtk_file_filter_set_name(filter, image_format_names[format]);
+    g_object_set_data(G_OBJECT(filter), "format", GINT_TO_POINTER(format));
+    gtk_file_chooser_add_filter(GTK_FILE_CHOOSER(dialog), filter);
+    g_free(pattern);
+  }
 
-	if (gtk_dialog_run(GTK_DIALOG(dialog)) == GTK_RESPONSE_ACCEPT)
-	{
-	  filename = gtk_file_chooser_get_filename (GTK_FILE_CHOOSER (dialog));
+  if (gtk_dialog_run(GTK_DIALOG(dialog)) == GTK_RESPONSE_ACCEPT)
+  {
+    filename = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(dialog));
     filter = gtk_file_chooser_get_filter(GTK_FILE_CHOOSER(dialog));
 
-    if (strncmp(gtk_file_filter_get_name(filter),"PNG", 3) == 0)
+    format = image_format_from_name(filename);
+    if (format < 0)
     {
-      if (strcmp(filename+strlen(filename)-4, ".png") != 0)
-      {
-        filename = (gchar *) g_realloc(filename,sizeof(gchar)*(strlen(filename)+4));
-        strcat(filename,".png");
-      }
-		}
-    cairo_surface_write_to_png(surface,filename);
+      format = filter ? GPOINTER_TO_INT(g_object_get_data(G_OBJECT(filter),
+                                                          "format"))
+                      : IMAGE_FORMAT_PNG;
+      pattern = filename;
+      filename = g_strconcat(pattern, image_format_extensions[format], NULL);
+      g_free(pattern);
+    }
+
+    image_save_start(filename, format);
     g_free(filename);
-	}
-  cairo_destroy(cr);
-	gtk_widget_destroy (dialog);
+  }
+  gtk_widget_destroy(dialog);
+
+  trace_end("save_function");
 }
 
 
 void show_about(GtkWidget *widget, gpointer window)
 {
 
-  GdkPixbuf *pixbuf = gdk_pixbuf_new_from_file("/home/foustja/C/lorenz.png", NULL);
+  GdkPixbuf *pixbuf = app_icon();
 
   GtkWidget *dialog = gtk_about_dialog_new();
 
@@ -1034,8 +10092,6 @@ void show_about(GtkWidget *widget, gpointer window)
   //gtk_about_dialog_set_authors (GTK_ABOUT_DIALOG(dialog),
                                 //people);
 
-  g_object_unref(pixbuf), pixbuf = NULL;
-
   gtk_dialog_run(GTK_DIALOG (dialog));
   gtk_widget_destroy(dialog);
 }
@@ -1118,13 +10174,11 @@ static void activate (GtkApplication *app, gpointer user_data)
 
   GtkWidget *vbox_top;
   GtkWidget *vbox_bottom;
+  GtkWidget *statusbar;
     GtkWidget *vbox_outer;
   GtkWidget *vbox;
   GtkWidget *hbox;
 
-  GdkPixbuf *icon;
-  gchar *icon_filename;
-  icon_filename = "/home/foustja/C/lorenz.png";
 
   GtkWidget *menubar;
 
@@ -1136,7 +10190,9 @@ static void activate (GtkApplication *app, gpointer user_data)
   GtkWidget *lorenz_xy_menu_item;
   GtkWidget *lorenz_yz_menu_item;
   GtkWidget *lorenz_xz_menu_item;
+  GtkWidget *lorenz_3d_menu_item;
   GtkWidget *mandel_menu_item;
+  GtkWidget *formula_draw_menu_item;
   GtkWidget *clear_menu_item;
   GtkWidget *stop_menu_item;
   GtkWidget *quit_menu_item;
@@ -1147,25 +10203,43 @@ static void activate (GtkApplication *app, gpointer user_data)
   GtkWidget *reference_menu_item;
   GtkWidget *parameter_menu_item;
 
+  GtkWidget *precision_menu;
+  GtkWidget *precision_menu_item;
+  GtkWidget *precision_item;
+  GSList *precision_group = NULL;
+  GtkWidget *antialias_item;
+  GtkWidget *show_samples_item;
+  GtkWidget *distance_item;
+  GtkWidget *inverse_item;
+  GtkWidget *julia_preview_item;
+  GtkWidget *more_iterations_item;
+  GtkWidget *auto_deepen_item;
+  int i;
+
   GtkWidget *file_menu;
   GtkWidget *file_menu_item;
   GtkWidget *open_menu_item;
   GtkWidget *save_menu_item;
+  GtkWidget *canvas_menu_item;
 
 
 
-  window = gtk_application_window_new (app);
+  //The widgets start from the last session's parameters
+  session_load();
 
-  icon = gdk_pixbuf_new_from_file(icon_filename, NULL);
+  window = gtk_application_window_new (app);
 
   gtk_window_set_position(GTK_WINDOW(window), GTK_WIN_POS_CENTER);
   gtk_window_set_default_size(GTK_WINDOW(window), WINWIDTH, WINHEIGHT);
   gtk_window_set_title(GTK_WINDOW(window),
                        "GTK window for fractal generation 1200X800");
-  gtk_window_set_icon(GTK_WINDOW(window), icon);
+  gtk_window_set_icon(GTK_WINDOW(window), app_icon());
 
   drawing_area = gtk_drawing_area_new ();
   gtk_widget_set_size_request (drawing_area, DAWIDTH, DAHEIGHT);
+  gtk_widget_add_events (drawing_area, GDK_BUTTON_PRESS_MASK |
+                                       GDK_POINTER_MOTION_MASK |
+                                       GDK_LEAVE_NOTIFY_MASK);
 
   button_henon  =    gtk_button_new_with_label("Henon");
   button_lorenz_xy = gtk_button_new_with_label("lorenz - xy");
@@ -1190,9 +10264,9 @@ static void activate (GtkApplication *app, gpointer user_data)
   parameter_a_label = gtk_label_new("parameter a");
   parameter_b_label = gtk_label_new("parameter b");
 
-  adj_a = (GtkAdjustment *) gtk_adjustment_new (-0.5, -99.0, 99.0, 0.00001,
+  adj_a = (GtkAdjustment *) gtk_adjustment_new (parameter_a, -99.0, 99.0, 0.00001,
 					      0.00001, 0.0);
-  adj_b = (GtkAdjustment *) gtk_adjustment_new (-0.99998, -99.0, 99.0, 0.00001,
+  adj_b = (GtkAdjustment *) gtk_adjustment_new (parameter_b, -99.0, 99.0, 0.00001,
                 0.00001, 0.0);
 
   parameter_a_spin = gtk_spin_button_new (adj_a, 0.0, 5);
@@ -1207,15 +10281,18 @@ static void activate (GtkApplication *app, gpointer user_data)
   formula_menu = gtk_menu_new();
   info_menu =    gtk_menu_new();
   file_menu =    gtk_menu_new();
+  precision_menu = gtk_menu_new();
 
   formula_menu_item =    gtk_menu_item_new_with_label("Fractals");
   henon_menu_item =      gtk_menu_item_new_with_label("Henon");
   lorenz_xy_menu_item =  gtk_menu_item_new_with_label("lorenz - xy");
   lorenz_yz_menu_item =  gtk_menu_item_new_with_label("lorenz - yz");
   lorenz_xz_menu_item =  gtk_menu_item_new_with_label("lorenz - xz");
+  lorenz_3d_menu_item =  gtk_menu_item_new_with_label("lorenz - 3D");
   julia_menu_item  =     gtk_menu_item_new_with_label("Julia");
   juliasin_menu_item =   gtk_menu_item_new_with_label("JuliaSine");
   mandel_menu_item =     gtk_menu_item_new_with_label("Mandelbrot");
+  formula_draw_menu_item = gtk_menu_item_new_with_label("Formula...");
   clear_menu_item  =     gtk_menu_item_new_with_label("Clear screen");
   stop_menu_item  =      gtk_menu_item_new_with_label("Stop");
   quit_menu_item =       gtk_menu_item_new_with_label("Quit");
@@ -1223,7 +10300,9 @@ static void activate (GtkApplication *app, gpointer user_data)
   file_menu_item =       gtk_menu_item_new_with_label("File");
   open_menu_item =      gtk_menu_item_new_with_label("Open");
   save_menu_item =      gtk_menu_item_new_with_label("Save");
+  canvas_menu_item =    gtk_menu_item_new_with_label("Canvas...");
 
+  precision_menu_item =  gtk_menu_item_new_with_label("Precision");
   info_menu_item =       gtk_menu_item_new_with_label("Info");
   about_menu_item =      gtk_menu_item_new_with_label("About");
   reference_menu_item =  gtk_menu_item_new_with_label("Reference");
@@ -1238,9 +10317,12 @@ static void activate (GtkApplication *app, gpointer user_data)
   gtk_menu_shell_append(GTK_MENU_SHELL(formula_menu), lorenz_xy_menu_item);
   gtk_menu_shell_append(GTK_MENU_SHELL(formula_menu), lorenz_yz_menu_item);
   gtk_menu_shell_append(GTK_MENU_SHELL(formula_menu), lorenz_xz_menu_item);
+  gtk_menu_shell_append(GTK_MENU_SHELL(formula_menu), lorenz_3d_menu_item);
   gtk_menu_shell_append(GTK_MENU_SHELL(formula_menu), julia_menu_item);
   gtk_menu_shell_append(GTK_MENU_SHELL(formula_menu), juliasin_menu_item);
   gtk_menu_shell_append(GTK_MENU_SHELL(formula_menu), mandel_menu_item);
+  gtk_menu_shell_append(GTK_MENU_SHELL(formula_menu),
+                        formula_draw_menu_item);
   gtk_menu_shell_append(GTK_MENU_SHELL(formula_menu), clear_menu_item);
   gtk_menu_shell_append(GTK_MENU_SHELL(formula_menu), stop_menu_item);
   gtk_menu_shell_append(GTK_MENU_SHELL(formula_menu), quit_menu_item);
@@ -1250,6 +10332,76 @@ static void activate (GtkApplication *app, gpointer user_data)
 
   gtk_menu_shell_append(GTK_MENU_SHELL(file_menu), open_menu_item);
   gtk_menu_shell_append(GTK_MENU_SHELL(file_menu), save_menu_item);
+  gtk_menu_shell_append(GTK_MENU_SHELL(file_menu), canvas_menu_item);
+
+  gtk_menu_item_set_submenu(GTK_MENU_ITEM(precision_menu_item),
+                            precision_menu);
+  gtk_menu_shell_append(GTK_MENU_SHELL(menubar), precision_menu_item);
+
+  for (i = 0; i < PRECISION_COUNT; i++)
+  {
+    precision_item = gtk_radio_menu_item_new_with_label(precision_group,
+                                                        precision_names[i]);
+    precision_group = gtk_radio_menu_item_get_group(
+                        GTK_RADIO_MENU_ITEM(precision_item));
+    gtk_check_menu_item_set_active(GTK_CHECK_MENU_ITEM(precision_item),
+                                   i == render_precision);
+    g_signal_connect(G_OBJECT(precision_item), "toggled",
+                     G_CALLBACK(precision_toggled), GINT_TO_POINTER(i));
+    gtk_menu_shell_append(GTK_MENU_SHELL(precision_menu), precision_item);
+  }
+
+  antialias_item = gtk_check_menu_item_new_with_label("Antialiasing");
+  gtk_check_menu_item_set_active(GTK_CHECK_MENU_ITEM(antialias_item),
+                                 render_antialias);
+  g_signal_connect(G_OBJECT(antialias_item), "toggled",
+                   G_CALLBACK(antialias_toggled), NULL);
+
+  show_samples_item = gtk_check_menu_item_new_with_label("Show samples");
+  gtk_check_menu_item_set_active(GTK_CHECK_MENU_ITEM(show_samples_item),
+                                 render_show_samples);
+  g_signal_connect(G_OBJECT(show_samples_item), "toggled",
+                   G_CALLBACK(show_samples_toggled), NULL);
+
+  distance_item = gtk_check_menu_item_new_with_label("Distance estimation");
+  gtk_check_menu_item_set_active(GTK_CHECK_MENU_ITEM(distance_item),
+                                 render_distance);
+  g_signal_connect(G_OBJECT(distance_item), "toggled",
+                   G_CALLBACK(distance_toggled), NULL);
+
+  inverse_item = gtk_check_menu_item_new_with_label("Inverse iteration");
+  gtk_check_menu_item_set_active(GTK_CHECK_MENU_ITEM(inverse_item),
+                                 render_inverse);
+  g_signal_connect(G_OBJECT(inverse_item), "toggled",
+                   G_CALLBACK(inverse_toggled), NULL);
+
+  julia_preview_item = gtk_check_menu_item_new_with_label("Julia preview");
+  gtk_check_menu_item_set_active(GTK_CHECK_MENU_ITEM(julia_preview_item),
+                                 render_julia_preview);
+  g_signal_connect(G_OBJECT(julia_preview_item), "toggled",
+                   G_CALLBACK(julia_preview_toggled), drawing_area);
+
+  more_iterations_item = gtk_menu_item_new_with_label("More iterations");
+  g_signal_connect(G_OBJECT(more_iterations_item), "activate",
+                   G_CALLBACK(more_iterations_activated), drawing_area);
+
+  auto_deepen_item = gtk_check_menu_item_new_with_label("Auto-deepen");
+  gtk_check_menu_item_set_active(GTK_CHECK_MENU_ITEM(auto_deepen_item),
+                                 render_auto_deepen);
+  g_signal_connect(G_OBJECT(auto_deepen_item), "toggled",
+                   G_CALLBACK(auto_deepen_toggled), drawing_area);
+
+  gtk_menu_shell_append(GTK_MENU_SHELL(precision_menu),
+                        gtk_separator_menu_item_new());
+  gtk_menu_shell_append(GTK_MENU_SHELL(precision_menu), antialias_item);
+  gtk_menu_shell_append(GTK_MENU_SHELL(precision_menu), show_samples_item);
+  gtk_menu_shell_append(GTK_MENU_SHELL(precision_menu), distance_item);
+  gtk_menu_shell_append(GTK_MENU_SHELL(precision_menu), inverse_item);
+  gtk_menu_shell_append(GTK_MENU_SHELL(precision_menu), julia_preview_item);
+  gtk_menu_shell_append(GTK_MENU_SHELL(precision_menu),
+                        gtk_separator_menu_item_new());
+  gtk_menu_shell_append(GTK_MENU_SHELL(precision_menu), more_iterations_item);
+  gtk_menu_shell_append(GTK_MENU_SHELL(precision_menu), auto_deepen_item);
 
   gtk_menu_item_set_submenu(GTK_MENU_ITEM(info_menu_item), info_menu);
   gtk_menu_shell_append(GTK_MENU_SHELL(menubar), info_menu_item);
@@ -1302,6 +10454,11 @@ static void activate (GtkApplication *app, gpointer user_data)
   gtk_box_pack_start (GTK_BOX (vbox_outer), vbox_top, FALSE, TRUE, 5);
   gtk_box_pack_start (GTK_BOX (vbox_outer), vbox_bottom, FALSE, TRUE, 5);
 
+  //Render statistics are shown in a status bar under the drawing area
+  statusbar = gtk_statusbar_new ();
+  gtk_box_pack_start (GTK_BOX (vbox_outer), statusbar, FALSE, TRUE, 0);
+  status_bar = statusbar;
+
   gtk_container_add (GTK_CONTAINER (window), vbox_outer);
 
   g_signal_connect (drawing_area,"configure-event",
@@ -1349,6 +10506,15 @@ static void activate (GtkApplication *app, gpointer user_data)
   g_signal_connect (drawing_area, "draw",
       G_CALLBACK(on_draw_event), NULL);
 
+  g_signal_connect (drawing_area, "button-press-event",
+      G_CALLBACK(button_press_event), NULL);
+
+  g_signal_connect (drawing_area, "motion-notify-event",
+      G_CALLBACK(motion_notify_event), NULL);
+
+  g_signal_connect (drawing_area, "leave-notify-event",
+      G_CALLBACK(leave_notify_event), NULL);
+
   g_signal_connect (window, "delete-event",
     	G_CALLBACK (delete_event), NULL);
 
@@ -1366,6 +10532,9 @@ static void activate (GtkApplication *app, gpointer user_data)
   g_signal_connect_swapped (lorenz_xz_menu_item, "activate",
     G_CALLBACK (lorenz_xzdraw), drawing_area);
 
+  g_signal_connect_swapped (lorenz_3d_menu_item, "activate",
+    G_CALLBACK (lorenz_3ddraw), drawing_area);
+
   g_signal_connect_swapped (julia_menu_item, "activate",
     G_CALLBACK (juliadraw), drawing_area);
 
@@ -1375,6 +10544,9 @@ static void activate (GtkApplication *app, gpointer user_data)
   g_signal_connect_swapped (mandel_menu_item, "activate",
     G_CALLBACK (mandeldraw), drawing_area);
 
+  g_signal_connect_swapped (formula_draw_menu_item, "activate",
+    G_CALLBACK (formuladraw), drawing_area);
+
   g_signal_connect_swapped (clear_menu_item, "activate",
     G_CALLBACK (clear_drawing_area), drawing_area);
 
@@ -1384,6 +10556,9 @@ static void activate (GtkApplication *app, gpointer user_data)
   g_signal_connect(G_OBJECT(quit_menu_item), "activate",
       G_CALLBACK(stop_function), NULL);
 
+  g_signal_connect(G_OBJECT(quit_menu_item), "activate",
+      G_CALLBACK(session_save), NULL);
+
   g_signal_connect_swapped(G_OBJECT(quit_menu_item), "activate",
       G_CALLBACK(gtk_widget_destroy), G_OBJECT(window));
 
@@ -1401,9 +10576,58 @@ static void activate (GtkApplication *app, gpointer user_data)
 
   g_signal_connect_swapped (save_menu_item, "activate",
       G_CALLBACK (save_function), drawing_area);
+  g_signal_connect_swapped (canvas_menu_item, "activate",
+      G_CALLBACK (canvas_open), drawing_area);
 
 
   gtk_widget_show_all (window);
+
+  if (ui_benchmark)
+    ui_benchmark_start (drawing_area);
+}
+
+//Handles the command line options; returns -1 to go on and start the GUI
+static gint handle_local_options(GApplication *app, GVariantDict *options,
+                                 gpointer user_data)
+{
+  gchar *directory;
+  gint bits;
+
+  if (g_variant_dict_lookup(options, "fixed-bits", "i", &bits))
+    fixed_bits = bits;
+
+  g_variant_dict_lookup(options, "baseline", "^ay", &check_baseline);
+  g_variant_dict_lookup(options, "max-slowdown", "i", &check_max_slowdown);
+
+  if (g_variant_dict_contains(options, "benchmark"))
+    return run_benchmark();
+
+  if (g_variant_dict_contains(options, "self-test"))
+    return run_self_test();
+
+  if (g_variant_dict_contains(options, "check"))
+    return run_check();
+
+  g_variant_dict_lookup(options, "zoom-depth", "d", &zoom_video_depth);
+  g_variant_dict_lookup(options, "zoom-frames", "i", &zoom_video_frames);
+  g_variant_dict_lookup(options, "zoom-center", "s", &zoom_video_center);
+  if (g_variant_dict_lookup(options, "zoom-video", "^ay", &directory))
+    return run_zoom_video(directory);
+
+  //Runs in the GUI, which activate() starts it in
+  if (g_variant_dict_contains(options, "ui-benchmark"))
+    ui_benchmark = g_new0(UiBenchmark, 1);
+  startup_benchmark = g_variant_dict_contains(options, "startup-benchmark");
+  if (g_variant_dict_lookup(options, "canvas-size", "i", &canvas_size))
+    canvas_size = CLAMP(canvas_size, DAWIDTH, CANVAS_MAX_SIZE);
+
+  //Opened here rather than in activate(), so that failing sets the exit
+  //status
+  g_variant_dict_lookup(options, "shm-output", "^ay", &shm_output_path);
+  if (shm_output_path && !shm_output_open(shm_output_path))
+    return 1;
+
+  return -1;
 }
 
 //Main - creates and runs application initialized by activate
@@ -1412,12 +10636,40 @@ int main (int argc, char **argv)
   GtkApplication *app;
   int status;
 
+  startup_time = g_get_monotonic_time ();
+  trace_init ();
+  render_init_simd ();
+
+  render_results = g_async_queue_new ();
+  render_pool = g_thread_pool_new (render_worker, NULL,
+                                   g_get_num_processors (), TRUE, NULL);
+  g_thread_pool_set_sort_function (render_pool, render_tile_compare, NULL);
+
   app = gtk_application_new ("io.github.foustja.testprogram_fractal7",
                              G_APPLICATION_FLAGS_NONE);
+  g_application_add_main_option_entries (G_APPLICATION (app),
+                                        command_line_options);
+  g_signal_connect (app, "handle-local-options",
+                    G_CALLBACK (handle_local_options), NULL);
+  g_signal_connect (app, "startup", G_CALLBACK (render_jobs_init), NULL);
   g_signal_connect (app, "activate", G_CALLBACK (activate), NULL);
   status = g_application_run (G_APPLICATION (app), argc, argv);
   g_object_unref (app);
 
+  if ((ui_benchmark && ui_benchmark->failed) || startup_failed)
+    status = 1;
+
+  //Retire the last render, let the render threads wind down, then drop
+  //whatever they queued on the way out
+  render_cancel ();
+  render_jobs_cancel_all ();
+  g_thread_pool_free (render_pool, TRUE, TRUE);
+  render_cancel ();
+  g_async_queue_unref (render_results);
+
+  shm_output_close ();
+  trace_write ();
+
   return status;
 }
 